@@ -22,9 +22,12 @@ Atom::Atom(std::complex<double> complexNumber) {
 }
 
 Atom::Atom(const Token & token): Atom() {
-  // is token a number?
+  // is token a number? the stream is reused, constructing one per token
+  // dominates parsing and contends on the shared locale across threads
+  static thread_local std::istringstream iss;
+  iss.clear();
+  iss.str(token.asString());
   double temp;
-  std::istringstream iss(token.asString());
   if(iss >> temp){
     // check for trailing characters if >> succeeds
     if(iss.rdbuf()->in_avail() == 0){
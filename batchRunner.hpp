@@ -0,0 +1,139 @@
+#ifndef BATCHRUNNER_HPP
+#define BATCHRUNNER_HPP
+
+#include <string>
+#include <sstream>
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <vector>
+#include <map>
+#include <set>
+#include <chrono>
+#include <cstdlib>
+#include "interpreter.hpp"
+#include "semantic_error.hpp"
+#include "workerPool.hpp"
+
+// the outcome of one script of a batch
+struct batchResult {
+    std::string file;
+    std::string output;
+    bool ok = false;
+    double seconds = 0;
+};
+
+// where the result of a script is written, next to it or in outDir
+std::string batchOutputPath(const std::string & file, const std::string & outDir) {
+    if(outDir.empty()) return file + ".out";
+    std::size_t slash = file.find_last_of("/\\");
+    std::string name = slash == std::string::npos ? file : file.substr(slash + 1);
+    std::size_t dot = name.find_last_of('.');
+    if(dot != std::string::npos && dot > 0) name.erase(dot);
+    return outDir + "/" + name + ".out";
+}
+
+// the output file of every script, scripts that would share one, such as
+// a/x.pls and b/x.pls in one outDir, get their index in the batch added
+std::vector<std::string> batchOutputPaths(const std::vector<std::string> & files, const std::string & outDir) {
+    std::vector<std::string> paths;
+    std::map<std::string, std::size_t> uses;
+    for(auto &file : files) {
+        paths.push_back(batchOutputPath(file, outDir));
+        ++uses[paths.back()];
+    }
+    std::set<std::string> taken(paths.begin(), paths.end());
+    for(std::size_t i = 0; i < paths.size(); ++i) {
+        if(uses[paths[i]] < 2) continue;
+        std::string stem = paths[i].substr(0, paths[i].size() - 4);
+        std::string path = stem + "." + std::to_string(i) + ".out";
+        while(taken.count(path)) path = stem + "." + std::to_string(i) + path.substr(stem.size());
+        taken.insert(path);
+        paths[i] = path;
+    }
+    return paths;
+}
+
+// the script paths of a manifest, one per line
+bool readManifest(const std::string & manifest, std::vector<std::string> & files) {
+    std::ifstream ifs(manifest);
+    if(!ifs) return false;
+    std::string line;
+    while(std::getline(ifs, line)) {
+        if(!line.empty() && line.back() == '\r') line.pop_back();
+        if(!line.empty()) files.push_back(line);
+    }
+    return true;
+}
+
+// evaluate one script in its own interpreter, as plotscript <file> would
+batchResult evaluateScript(const std::string & file, const Environment & startup, const EvalLimits & limits) {
+    auto start = std::chrono::steady_clock::now();
+    batchResult result;
+    result.file = file;
+    std::ifstream ifs(file);
+    Interpreter interp(startup);
+    interp.setLimits(limits);
+    if(!ifs) {
+        result.output = "Error: Could not open file for reading.";
+    } else if(!interp.parseStream(ifs)) {
+        result.output = "Error: Invalid Program. Could not parse.";
+    } else {
+        try {
+            std::ostringstream out;
+            out << interp.evaluate();
+            result.output = out.str();
+            result.ok = true;
+        } catch(const SemanticError & ex) {
+            result.output = ex.what();
+        }
+    }
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+// Evaluates many scripts on a pool of workers. Every script starts from a
+// copy of the startup environment, freeze it first so the copies share its
+// definitions. Each result is written to its output file as it finishes.
+std::vector<batchResult> runBatch(const std::vector<std::string> & files, const Environment & startup,
+                                  unsigned workers, const EvalLimits & limits, const std::string & outDir) {
+    std::vector<batchResult> results(files.size());
+    // settled before any task runs, so no two tasks write the same file
+    std::vector<std::string> outputs = batchOutputPaths(files, outDir);
+    {
+        workerPool pool(workers);
+        for(std::size_t i = 0; i < files.size(); ++i) {
+            // every task owns its slot of results
+            pool.submit([&files, &startup, &limits, &outputs, &results, i]() {
+                results[i] = evaluateScript(files[i], startup, limits);
+                std::ofstream out(outputs[i]);
+                out << results[i].output << std::endl;
+                if(!out) {
+                    results[i].ok = false;
+                    results[i].output = "Error: Could not write output.";
+                }
+            });
+        }
+    }
+    return results;
+}
+
+// one line per script with its status and time, then the totals
+void printBatchSummary(std::ostream & out, const std::vector<batchResult> & results, double wallSeconds) {
+    std::size_t failed = 0;
+    double total = 0;
+    out << std::fixed << std::setprecision(3);
+    for(auto &r : results) {
+        out << (r.ok ? "ok    " : "FAIL  ") << std::setw(9) << r.seconds * 1000 << " ms  " << r.file;
+        if(!r.ok) out << "  " << r.output;
+        out << std::endl;
+        if(!r.ok) ++failed;
+        total += r.seconds;
+    }
+    out << results.size() << " scripts, " << failed << " failed, "
+        << total << " s evaluating, " << wallSeconds << " s elapsed" << std::endl;
+    out.unsetf(std::ios::floatfield);
+    out << std::setprecision(6);
+}
+
+#endif
@@ -0,0 +1,23 @@
+#include "cancellation.hpp"
+
+#include <algorithm>
+
+void RequestCancellation::begin(std::uint64_t request) noexcept {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_running = request;
+  // an interrupt sent while the request waited still stops it
+  if(request > m_interrupted) m_token.reset();
+  else m_token.cancel();
+}
+
+void RequestCancellation::interrupt(std::uint64_t through) noexcept {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_interrupted = std::max(m_interrupted, through);
+  if(m_running <= through) m_token.cancel();
+}
+
+void RequestCancellation::interrupt() noexcept {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_interrupted = std::max(m_interrupted, m_running);
+  m_token.cancel();
+}
@@ -0,0 +1,69 @@
+/*! \file cancellation.hpp
+Defines cooperative cancellation of a running evaluation.
+
+Evaluation polls the cancellation token of its EvalContext at safepoints
+(see eval_context.hpp). Another thread cancels the token and the
+evaluation unwinds with an InterruptError at the next safepoint, leaving
+the thread and environment usable.
+ */
+#ifndef CANCELLATION_HPP
+#define CANCELLATION_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+
+/*! \class CancellationToken
+\brief A flag one thread sets to stop an evaluation running on another.
+ */
+class CancellationToken {
+public:
+
+  /// request that the evaluation polling this token stops
+  void cancel() noexcept {m_cancelled.store(true, std::memory_order_relaxed);}
+
+  /// withdraw any pending request
+  void reset() noexcept {m_cancelled.store(false, std::memory_order_relaxed);}
+
+  /// true if a stop has been requested
+  bool cancelled() const noexcept {return m_cancelled.load(std::memory_order_relaxed);}
+
+private:
+  std::atomic_bool m_cancelled{false};
+};
+
+/*! \class RequestCancellation
+\brief The token of a series of numbered requests evaluated one at a time.
+
+Requests are numbered before they are queued. An interrupt names the last
+request it stops, so one sent while a request is still queued or parsed
+stops it as soon as it starts, and later requests are not affected.
+ */
+class RequestCancellation {
+public:
+
+  /// number the next request, from any thread
+  std::uint64_t queue() noexcept {return ++m_queued;}
+
+  /// start polling the token for request, cancelled if it was interrupted
+  void begin(std::uint64_t request) noexcept;
+
+  /// stop every request numbered up to through
+  void interrupt(std::uint64_t through) noexcept;
+
+  /// stop the request started last
+  void interrupt() noexcept;
+
+  /// the token polled by the request started last
+  const CancellationToken & token() const noexcept {return m_token;}
+
+private:
+  CancellationToken m_token;
+  std::atomic<std::uint64_t> m_queued{0};
+  // orders a request starting against an interrupt from another thread
+  std::mutex m_mutex;
+  std::uint64_t m_running = 0;
+  std::uint64_t m_interrupted = 0;
+};
+
+#endif
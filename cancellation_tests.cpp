@@ -0,0 +1,103 @@
+#include "catch.hpp"
+
+#include <string>
+#include <sstream>
+#include <thread>
+#include <chrono>
+
+#include "cancellation.hpp"
+#include "interpreter.hpp"
+#include "semantic_error.hpp"
+
+Expression evalCancellable(Interpreter & interp, const std::string & program){
+  std::istringstream iss(program);
+  REQUIRE(interp.parseStream(iss));
+  return interp.evaluate();
+}
+
+TEST_CASE( "Test request cancellation", "[cancellation]" ) {
+
+  RequestCancellation requests;
+  std::uint64_t first = requests.queue();
+  std::uint64_t second = requests.queue();
+  REQUIRE(second > first);
+
+  requests.begin(first);
+  REQUIRE(!requests.token().cancelled());
+  requests.interrupt(first);
+  REQUIRE(requests.token().cancelled());
+
+  INFO("the next request starts with a fresh token")
+  requests.begin(second);
+  REQUIRE(!requests.token().cancelled());
+
+  INFO("an interrupt stops the running request and is kept for those queued behind it")
+  std::uint64_t third = requests.queue();
+  requests.interrupt(third);
+  REQUIRE(requests.token().cancelled());
+  requests.begin(third);
+  REQUIRE(requests.token().cancelled());
+
+  INFO("interrupting without a request stops the one started last")
+  requests.begin(requests.queue());
+  requests.interrupt();
+  REQUIRE(requests.token().cancelled());
+}
+
+TEST_CASE( "Test interrupting a running evaluation", "[cancellation]" ) {
+
+  Interpreter interp;
+  evalCancellable(interp, "(define a 1)");
+
+  INFO("an interrupt with nothing running does not affect the next evaluation")
+  interp.interrupt();
+  REQUIRE(evalCancellable(interp, "(+ a 1)") == Expression(2.));
+
+  // long enough that it is still running when interrupted
+  std::istringstream slow("(begin (define f (lambda (x) (+ x 1))) (map f (range 0 100000000 1)))");
+  REQUIRE(interp.parseStream(slow));
+  bool interrupted = false;
+  std::thread kernel([&interp, &interrupted]() {
+    try {
+      interp.evaluate();
+    } catch(const InterruptError &) {
+      interrupted = true;
+    }
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  interp.interrupt();
+  kernel.join();
+  REQUIRE(interrupted);
+
+  INFO("the environment survives the interrupt")
+  REQUIRE(evalCancellable(interp, "(+ a 2)") == Expression(3.));
+}
+
+TEST_CASE( "Test interrupting a queued request", "[cancellation]" ) {
+
+  Interpreter interp;
+  evalCancellable(interp, "(define a 1)");
+
+  INFO("an interrupt sent while a request waits or is parsed is not lost")
+  std::uint64_t queued = interp.queueRequest();
+  std::uint64_t behind = interp.queueRequest();
+  interp.interrupt(queued);
+  std::istringstream first("(+ a 1)");
+  REQUIRE(interp.parseStream(first));
+  REQUIRE_THROWS_AS(interp.evaluate(queued), InterruptError);
+
+  INFO("requests numbered after it are not stopped")
+  std::istringstream second("(+ a 2)");
+  REQUIRE(interp.parseStream(second));
+  REQUIRE(interp.evaluate(behind) == Expression(3.));
+
+  INFO("an interrupt covers every request numbered up to it")
+  queued = interp.queueRequest();
+  behind = interp.queueRequest();
+  interp.interrupt(behind);
+  std::istringstream third("(+ a 3)");
+  REQUIRE(interp.parseStream(third));
+  REQUIRE_THROWS_AS(interp.evaluate(queued), InterruptError);
+  REQUIRE_THROWS_AS(interp.evaluate(behind), InterruptError);
+  REQUIRE(evalCancellable(interp, "(+ a 4)") == Expression(5.));
+}
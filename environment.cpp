@@ -4,8 +4,13 @@
 #include <cmath>
 #include <iostream>
 
+#include "eval_context.hpp"
 #include "environment.hpp"
+#include "lazy_range.hpp"
+#include "reduce.hpp"
 #include "semantic_error.hpp"
+#include "stats.hpp"
+#include "typed_procedure.hpp"
 
 /*********************************************************************** 
 Helper Functions
@@ -28,16 +33,11 @@ Expression default_proc(const std::vector<Expression> & args){
 };
 
 Expression join(const std::vector<Expression> & args) {
-    std::list<Expression> list;
     if(nargs_equal(args, 2)) {
         if(args[0].isHeadList()) {
             if(args[1].isHeadList()) {
-                for(auto e = args[0].listConstBegin(); e != args[0].listConstEnd(); ++e) {
-                    list.push_back(*e);
-                }
-                for(auto e = args[1].listConstBegin(); e != args[1].listConstEnd(); ++e) {
-                    list.push_back(*e);
-                }
+                // both lists are shared, only the seam between them is new
+                return Expression(args[0].list().join(args[1].list()));
             } else {
                 throw SemanticError("Error: Second argument in join not a list.");
             }
@@ -47,19 +47,16 @@ Expression join(const std::vector<Expression> & args) {
     } else {
         throw SemanticError("Error: Wrong number of arguments to append.");
     }
-    Expression result(list);
-    return result;
 }
 
 Expression range(const std::vector<Expression> & args) {
-    std::list<Expression> list;
     if(nargs_equal(args, 3)) {
         if(args[0].head().asNumber() < args[1].head().asNumber()) {
             if(args[2].head().asNumber() > 0) {
-                for(double i = args[0].head().asNumber(); i <= args[1].head().asNumber(); i = i + args[2].head().asNumber()) {
-                    Atom a(i);
-                    list.push_back(Expression(a));
-                }
+                // the numbers are made when a consumer asks for them
+                double begin = args[0].head().asNumber(), step = args[2].head().asNumber();
+                std::size_t size = LazyRange::count(begin, args[1].head().asNumber(), step);
+                return Expression(LazyRange(begin, step, size));
             } else {
                 throw SemanticError("Error: negative or zero increment in range.");
             }
@@ -69,25 +66,21 @@ Expression range(const std::vector<Expression> & args) {
     } else {
         throw SemanticError("Error: Wrong number of arguments in call to range.");
     }
-    return Expression(list);
 }
 
 Expression append(const std::vector<Expression> & args) {
-    std::list<Expression> list;
     if(nargs_equal(args, 2)) {
         if(args[0].isHeadList()) {
-            for(auto e = args[0].listConstBegin(); e != args[0].listConstEnd(); ++e) {
-                list.push_back(*e);
-            }
+            PersistentList<Expression> list = args[0].list();
+            chargeList();
             list.push_back(args[1]);
+            return Expression(list);
         } else {
             throw SemanticError("Error: First argument is not a list.");
         }
     } else {
         throw SemanticError("Error: Not 2 arguments to append.");
     }
-    Expression result(list);
-    return result;
 }
 
 Expression length(const std::vector<Expression> & args) {
@@ -109,7 +102,8 @@ Expression first(const std::vector<Expression> & args) {
     if(nargs_equal(args, 1)) {
         if(args[0].isHeadList()) {
             if(!args[0].isListEmpty()) {
-                result = *args[0].listConstBegin();
+                const LazyRange * range = args[0].lazyRange();
+                result = range ? Expression(Atom(range->start())) : args[0].list().front();
             } else {
                 throw SemanticError("Error: Argument to first is an empty list.");
             }
@@ -123,13 +117,14 @@ Expression first(const std::vector<Expression> & args) {
 }
 
 Expression rest(const std::vector<Expression> & args) {
-    std::list<Expression> list;
     if(nargs_equal(args, 1)) {
         if(args[0].isHeadList()) {
             if(!args[0].isListEmpty()) {
-                for(auto e = std::next(args[0].listConstBegin()); e != args[0].listConstEnd(); ++e) {
-                    list.push_back(*e);
+                if(const LazyRange * range = args[0].lazyRange()) {
+                    return Expression(range->rest());
                 }
+                // a view of the same elements
+                return Expression(args[0].list().rest());
             } else {
                 throw SemanticError("Error: Argument to rest is an empty list.");;
             }
@@ -139,8 +134,6 @@ Expression rest(const std::vector<Expression> & args) {
     } else {
         throw SemanticError("Error: more than one argument in rest to first.");
     }
-    Expression result(list);
-    return result;
 }
 
 Expression real(const std::vector<Expression> & args) {
@@ -465,29 +458,122 @@ Expression tangent(const std::vector<Expression> & args) {
     return Expression(result);
 }
 
+/*********************************************************************** 
+Real number fast paths of the arithmetic procedures, registered with
+Typed so that any other call goes to the general procedure above. Each
+computes what the general procedure does for real arguments.
+**********************************************************************/
+
+typedef double (*RealUnary)(double);
+typedef double (*RealBinary)(double, double);
+
+// the general add and mul accumulate from 0 and 1
+double addReal(double a) {return 0.0 + a;}
+double addReals(double a, double b) {return (0.0 + a) + b;}
+double mulReal(double a) {return 1.0 * a;}
+double mulReals(double a, double b) {return a * b;}
+double negReal(double a) {return -a;}
+double subReals(double a, double b) {return a - b;}
+double recipReal(double a) {return 1.0 / a;}
+double divReals(double a, double b) {return a / b;}
+double powReals(double a, double b) {return pow(a, b);}
+double sinReal(double a) {return sin(a);}
+double cosReal(double a) {return cos(a);}
+double tanReal(double a) {return tan(a);}
+
+Expression sum(const std::vector<Expression> & args) {
+    if(!nargs_equal(args, 1))
+        throw SemanticError("Error: more than one argument in call to sum.");
+    if(!args[0].isHeadList())
+        throw SemanticError("Error: Argument to sum is not a list.");
+    return listSum(args[0]);
+}
+
+Expression product(const std::vector<Expression> & args) {
+    if(!nargs_equal(args, 1))
+        throw SemanticError("Error: more than one argument in call to product.");
+    if(!args[0].isHeadList())
+        throw SemanticError("Error: Argument to product is not a list.");
+    return listProduct(args[0]);
+}
+
+// min, max, argmin and argmax of a non-empty list of real numbers
+Expression extremum(const std::vector<Expression> & args, bool greatest, bool index, const std::string & name) {
+    if(!nargs_equal(args, 1))
+        throw SemanticError("Error: more than one argument in call to " + name + ".");
+    if(!args[0].isHeadList())
+        throw SemanticError("Error: Argument to " + name + " is not a list.");
+    if(args[0].isListEmpty())
+        throw SemanticError("Error: Argument to " + name + " is an empty list.");
+    return listExtremum(args[0], greatest, index, name);
+}
+
+Expression minimum(const std::vector<Expression> & args) {
+    return extremum(args, false, false, "min");
+}
+
+Expression maximum(const std::vector<Expression> & args) {
+    return extremum(args, true, false, "max");
+}
+
+Expression argmin(const std::vector<Expression> & args) {
+    return extremum(args, false, true, "argmin");
+}
+
+Expression argmax(const std::vector<Expression> & args) {
+    return extremum(args, true, true, "argmax");
+}
+
 Environment::Environment(){
   reset();
 }
 
+Environment::Environment(const Environment & env): envmap(env.envmap), base(env.base) {
+  countStat(EnvironmentCopies);
+}
+
+Environment & Environment::operator=(const Environment & env) {
+  countStat(EnvironmentCopies);
+  envmap = env.envmap;
+  base = env.base;
+  return *this;
+}
+
+const Environment::EnvResult * Environment::find(const std::string & name) const {
+  countStat(SymbolLookups);
+  auto result = envmap.find(name);
+  if(result != envmap.end()) return &result->second;
+  auto shared = base->find(name);
+  if(shared != base->end()) return &shared->second;
+  return nullptr;
+}
+
+std::map<std::string, const Environment::EnvResult *> Environment::entries() const {
+  std::map<std::string, const EnvResult *> result;
+  for(auto & entry : envmap) result.emplace(entry.first, &entry.second);
+  for(auto & entry : *base) result.emplace(entry.first, &entry.second);
+  return result;
+}
+
 bool Environment::is_known(const Atom & sym) const{
   if(!sym.isSymbol()) return false;
   
-  return envmap.find(sym.asSymbol()) != envmap.end();
+  return find(sym.asSymbol()) != nullptr;
 }
 
 bool Environment::is_exp(const Atom & sym) const{
   if(!sym.isSymbol()) return false;
   
-  auto result = envmap.find(sym.asSymbol());
-  return (result != envmap.end()) && (result->second.type == ExpressionType);
+  const EnvResult * result = find(sym.asSymbol());
+  return result && (result->type == ExpressionType);
 }
 
 Expression Environment::get_exp(const Atom & sym) const{
   Expression exp;
   if(sym.isSymbol()){
-    auto result = envmap.find(sym.asSymbol());
-    if((result != envmap.end()) && (result->second.type == ExpressionType)){
-      exp = result->second.exp;
+    const EnvResult * result = find(sym.asSymbol());
+    if(result && (result->type == ExpressionType)){
+      exp = result->exp;
     }
   }
   return exp;
@@ -497,53 +583,90 @@ void Environment::add_exp(const Atom & sym, const Expression & exp) {
   if(!sym.isSymbol()) {
     throw SemanticError("Attempt to add non-symbol to environment");
   }
-    if(envmap.find(sym.asSymbol()) != envmap.end()){
-        auto result = envmap.find(sym.asSymbol());
+    auto result = envmap.find(sym.asSymbol());
+    if(result != envmap.end()){
         result->second.exp = exp;
         return;
     }
+    // shadow a base entry with a local copy, the base is never modified
+    auto shared = base->find(sym.asSymbol());
+    if(shared != base->end()) {
+        EnvResult copy = shared->second;
+        copy.exp = exp;
+        envmap.emplace(sym.asSymbol(), copy);
+        return;
+    }
     envmap.emplace(sym.asSymbol(), EnvResult(ExpressionType, exp));
 }
 
 bool Environment::is_proc(const Atom & sym) const{
   if(!sym.isSymbol()) return false;
   
-  auto result = envmap.find(sym.asSymbol());
-  return (result != envmap.end()) && (result->second.type == ProcedureType);
+  const EnvResult * result = find(sym.asSymbol());
+  return result && (result->type == ProcedureType);
 }
 
 Procedure Environment::get_proc(const Atom & sym) const{
   //Procedure proc = default_proc;
   if(sym.isSymbol()) {
-    auto result = envmap.find(sym.asSymbol());
-    if((result != envmap.end()) && (result->second.type == ProcedureType)){
-      return result->second.proc;
+    const EnvResult * result = find(sym.asSymbol());
+    if(result && (result->type == ProcedureType)){
+      return result->proc;
     }
   }
   return default_proc;
 }
 
+UnaryProcedure Environment::get_unary(const Atom & sym) const{
+  if(sym.isSymbol()) {
+    const EnvResult * result = find(sym.asSymbol());
+    if(result && (result->type == ProcedureType)){
+      return result->unary;
+    }
+  }
+  return nullptr;
+}
+
+BinaryProcedure Environment::get_binary(const Atom & sym) const{
+  if(sym.isSymbol()) {
+    const EnvResult * result = find(sym.asSymbol());
+    if(result && (result->type == ProcedureType)){
+      return result->binary;
+    }
+  }
+  return nullptr;
+}
+
 /*
-Reset the environment to the default state. First remove all entries and
-then re-add the default ones.
+Build the table of built-in procedures and values, it is built once and
+shared by every environment.
  */
-void Environment::reset(){
-    envmap.clear();
+std::shared_ptr<const Environment::EnvMap> Environment::makeBuiltins(){
+    std::shared_ptr<EnvMap> table = std::make_shared<EnvMap>();
+    EnvMap & envmap = *table;
   
     // Built-In value of pi
     envmap.emplace("pi", EnvResult(ExpressionType, Expression(PI)));
 
     // Procedure: add;
-    envmap.emplace("+", EnvResult(ProcedureType, add));
+    envmap.emplace("+", EnvResult(ProcedureType, add,
+                                  Typed<RealUnary, addReal, add>::fixed,
+                                  Typed<RealBinary, addReals, add>::fixed));
 
     // Procedure: subneg;
-    envmap.emplace("-", EnvResult(ProcedureType, subneg));
+    envmap.emplace("-", EnvResult(ProcedureType, subneg,
+                                  Typed<RealUnary, negReal, subneg>::fixed,
+                                  Typed<RealBinary, subReals, subneg>::fixed));
 
     // Procedure: mul;
-    envmap.emplace("*", EnvResult(ProcedureType, mul));
+    envmap.emplace("*", EnvResult(ProcedureType, mul,
+                                  Typed<RealUnary, mulReal, mul>::fixed,
+                                  Typed<RealBinary, mulReals, mul>::fixed));
 
     // Procedure: div;
-    envmap.emplace("/", EnvResult(ProcedureType, div));
+    envmap.emplace("/", EnvResult(ProcedureType, div,
+                                  Typed<RealUnary, recipReal, div>::fixed,
+                                  Typed<RealBinary, divReals, div>::fixed));
   
     // Milestone 0
     // Built-In value of e
@@ -551,15 +674,19 @@ void Environment::reset(){
     // Procedure: sqrt
     envmap.emplace("sqrt", EnvResult(ProcedureType, sqrt));
     //Procedure: pow
-    envmap.emplace("^", EnvResult(ProcedureType, power));
+    envmap.emplace("^", EnvResult(ProcedureType, Typed<RealBinary, powReals, power>::call,
+                                  nullptr, Typed<RealBinary, powReals, power>::fixed));
     //Procedure: ln
     envmap.emplace("ln", EnvResult(ProcedureType, ln));
     //Procedure: Sine
-    envmap.emplace("sin", EnvResult(ProcedureType, sine));
+    envmap.emplace("sin", EnvResult(ProcedureType, Typed<RealUnary, sinReal, sine>::call,
+                                    Typed<RealUnary, sinReal, sine>::fixed, nullptr));
     //Procedure: Cosine
-    envmap.emplace("cos", EnvResult(ProcedureType, cosine));
+    envmap.emplace("cos", EnvResult(ProcedureType, Typed<RealUnary, cosReal, cosine>::call,
+                                    Typed<RealUnary, cosReal, cosine>::fixed, nullptr));
     //Procedure: Tangent
-    envmap.emplace("tan", EnvResult(ProcedureType, tangent));
+    envmap.emplace("tan", EnvResult(ProcedureType, Typed<RealUnary, tanReal, tangent>::call,
+                                    Typed<RealUnary, tanReal, tangent>::fixed, nullptr));
     //Built-In Value of I
     envmap.emplace("I", EnvResult(ExpressionType, Expression(I)));
     //Procedure: real
@@ -580,4 +707,73 @@ void Environment::reset(){
     envmap.emplace("append", EnvResult(ProcedureType, append));
     envmap.emplace("range", EnvResult(ProcedureType, range));
     envmap.emplace("join", EnvResult(ProcedureType, join));
+
+    //reductions
+    envmap.emplace("sum", EnvResult(ProcedureType, sum));
+    envmap.emplace("product", EnvResult(ProcedureType, product));
+    envmap.emplace("min", EnvResult(ProcedureType, minimum));
+    envmap.emplace("max", EnvResult(ProcedureType, maximum));
+    envmap.emplace("argmin", EnvResult(ProcedureType, argmin));
+    envmap.emplace("argmax", EnvResult(ProcedureType, argmax));
+    return table;
+}
+
+const std::shared_ptr<const Environment::EnvMap> & Environment::builtins(){
+    static const std::shared_ptr<const EnvMap> table = makeBuiltins();
+    return table;
+}
+
+/*
+Reset the environment to the default state. First remove all entries and
+then share the built-in table again.
+ */
+void Environment::reset(){
+    envmap.clear();
+    base = builtins();
+}
+
+void Environment::freeze(){
+    if(envmap.empty()) return;
+    std::shared_ptr<EnvMap> layer = std::make_shared<EnvMap>(*base);
+    for(auto & entry : envmap) (*layer)[entry.first] = entry.second;
+    envmap.clear();
+    base = layer;
+}
+
+
+void Environment::serialize(ImageWriter & out) const {
+    std::map<std::string, const EnvResult *> all = entries();
+    out.u64(all.size());
+    for(auto & entry : all) {
+        out.u8(entry.second->type);
+        out.str(entry.first);
+        if(entry.second->type == ExpressionType) {
+            entry.second->exp.serialize(out);
+        }
+    }
+}
+
+bool Environment::deserialize(ImageReader & in) {
+    // build into a fresh default environment so a bad image changes nothing
+    Environment loaded;
+    std::uint64_t count;
+    if(!in.u64(count)) return false;
+    for(std::uint64_t i = 0; i < count; ++i) {
+        std::uint8_t type;
+        std::string name;
+        if(!in.u8(type) || !in.str(name)) return false;
+        if(type == ProcedureType) {
+            // procedures cannot be stored, only checked against the built-ins
+            if(!loaded.is_proc(Atom(name))) return false;
+        } else if(type == ExpressionType) {
+            Expression exp;
+            if(!exp.deserialize(in)) return false;
+            loaded.envmap[name] = EnvResult(ExpressionType, exp);
+        } else {
+            return false;
+        }
+    }
+    envmap.swap(loaded.envmap);
+    base = loaded.base;
+    return true;
 }
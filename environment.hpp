@@ -12,10 +12,12 @@ needed.
 
 // system includes
 #include <map>
+#include <memory>
 
 // module includes
 #include "atom.hpp"
 #include "expression.hpp"
+#include "image.hpp"
 
 /*! \typedef Procedure
 \brief A Procedure is a C++ function pointer taking a vector of 
@@ -23,6 +25,18 @@ needed.
 */
 typedef Expression (*Procedure)(const std::vector<Expression> & args);
 
+/*! \typedef UnaryProcedure
+\brief An entry point of a Procedure for calls with one argument, which
+       takes it without an argument vector.
+*/
+typedef Expression (*UnaryProcedure)(const Expression & arg);
+
+/*! \typedef BinaryProcedure
+\brief An entry point of a Procedure for calls with two arguments, which
+       takes them without an argument vector.
+*/
+typedef Expression (*BinaryProcedure)(const Expression & first, const Expression & second);
+
 /*! \class Environment
 \brief A class representing the interpreter environment.
 
@@ -36,6 +50,11 @@ return you can obtain
 the mapped-to value using get_exp or get_proc.
 
 To add an symbol to expression mapping use the add_exp member function.
+
+Entries live in two layers: a local map owned by this environment and a
+shared, immutable base layer holding the built-ins. Copying an environment
+copies only the local layer. freeze() moves the local definitions into a
+new base layer, so many environments can share one startup environment.
  */
 class Environment {
 public:
@@ -43,6 +62,15 @@ public:
    * definitions. */
   Environment();
 
+  /// copy the local definitions, sharing the base layer
+  Environment(const Environment & env);
+
+  /// copy the local definitions, sharing the base layer
+  Environment & operator=(const Environment & env);
+
+  Environment(Environment &&) = default;
+  Environment & operator=(Environment &&) = default;
+
   /*! Determine if a symbol is known to the environment.
     \param sym the sumbol to lookup
     \return true if the symbol has been defined in the environment
@@ -83,9 +111,41 @@ public:
   */
   Procedure get_proc(const Atom &sym) const;
 
+  /*! Get the entry point for one argument of the procedure sym maps to
+    \param sym the symbol to lookup
+    \return the entry point, or nullptr if sym is not a procedure with one
+  */
+  UnaryProcedure get_unary(const Atom &sym) const;
+
+  /*! Get the entry point for two arguments of the procedure sym maps to
+    \param sym the symbol to lookup
+    \return the entry point, or nullptr if sym is not a procedure with one
+  */
+  BinaryProcedure get_binary(const Atom &sym) const;
+
   /*! Reset the environment to its default state. */
   void reset();
 
+  /*! Move every local definition into a new shared base layer.
+    Copies made afterwards share the definitions instead of copying them.
+   */
+  void freeze();
+
+  /*! Write every entry of the environment in image encoding.
+    \param out the image writer to append to
+
+    Procedures are recorded by name only, they are re-bound to the
+    built-in table when the image is read back.
+   */
+  void serialize(ImageWriter & out) const;
+
+  /*! Replace the environment with the entries read from an image.
+    \param in the image reader positioned at the environment
+    \return false if the image is malformed or names an unknown procedure,
+    in which case the environment is left unchanged
+   */
+  bool deserialize(ImageReader & in);
+
 private:
   
   // Environment is a mapping from symbols to expressions or procedures
@@ -95,15 +155,35 @@ private:
     EnvResultType type;
     Expression exp; // used when type is ExpressionType
     Procedure proc; // used when type is ProcedureType
+    // optional entry points of proc for one and two arguments
+    UnaryProcedure unary = nullptr;
+    BinaryProcedure binary = nullptr;
 
     // constructors for use in container emplace
     EnvResult(){};
     EnvResult(EnvResultType t, Expression e) : type(t), exp(e){};
     EnvResult(EnvResultType t, Procedure p) : type(t), proc(p){};
+    EnvResult(EnvResultType t, Procedure p, UnaryProcedure u, BinaryProcedure b) :
+      type(t), proc(p), unary(u), binary(b){};
   };
 
-  // the environment map
-  std::map<std::string, EnvResult> envmap;
+  typedef std::map<std::string, EnvResult> EnvMap;
+
+  // the shared table of built-in procedures and values
+  static const std::shared_ptr<const EnvMap> & builtins();
+  static std::shared_ptr<const EnvMap> makeBuiltins();
+
+  // the entry for name in either layer, or nullptr
+  const EnvResult * find(const std::string & name) const;
+
+  // every entry of both layers, local entries hiding base ones
+  std::map<std::string, const EnvResult *> entries() const;
+
+  // the environment map, definitions made in this environment
+  EnvMap envmap;
+
+  // the immutable layer under envmap
+  std::shared_ptr<const EnvMap> base;
 };
 
 #endif
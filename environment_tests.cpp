@@ -82,6 +82,27 @@ TEST_CASE( "Test reset", "[environment]" ) {
   REQUIRE(env.get_exp(Atom("hi")) == Expression());
 }
 
+TEST_CASE( "Test shared base layers", "[environment]" ) {
+  Environment startup;
+  startup.add_exp(Atom("one"), Expression(1.0));
+  startup.freeze();
+  REQUIRE(startup.is_exp(Atom("one")));
+  REQUIRE(startup.is_proc(Atom("+")));
+
+  // two sessions sharing the frozen startup definitions
+  Environment first(startup), second(startup);
+  first.add_exp(Atom("one"), Expression(2.0));
+  first.add_exp(Atom("two"), Expression(2.0));
+  REQUIRE(first.get_exp(Atom("one")) == Expression(2.0));
+  REQUIRE(second.get_exp(Atom("one")) == Expression(1.0));
+  REQUIRE(startup.get_exp(Atom("one")) == Expression(1.0));
+  REQUIRE(!second.is_known(Atom("two")));
+
+  first.reset();
+  REQUIRE(!first.is_known(Atom("one")));
+  REQUIRE(first.is_proc(Atom("+")));
+}
+
 TEST_CASE( "Test semeantic errors", "[environment]" ) {
 
   Environment env;
@@ -0,0 +1,94 @@
+#include "eval_context.hpp"
+
+#include <algorithm>
+#include <sstream>
+
+#include "expression.hpp"
+
+thread_local EvalContext * EvalContext::s_active = nullptr;
+
+// an Expression in a list chunk plus its share of the tree above the chunk
+const std::size_t EvalContext::ELEMENT_BYTES = sizeof(Expression) + 2 * sizeof(void *);
+
+EvalContext::EvalContext(const CancellationToken & token, const EvalLimits & limits, FutureGroup * futures):
+  m_token(token), m_limits(limits), m_futures(futures), m_hasDeadline(limits.seconds > 0), m_previous(s_active) {
+  if(m_hasDeadline) {
+    auto budget = std::chrono::duration<double>(limits.seconds);
+    m_deadline = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(budget);
+  }
+  s_active = this;
+}
+
+EvalContext::EvalContext(const EvalContext & parent, const EvalLimits & left):
+  m_token(parent.m_token), m_limits(left), m_futures(parent.m_futures), m_hasDeadline(parent.m_hasDeadline),
+  m_deadline(parent.m_deadline), m_previous(s_active) {
+  s_active = this;
+}
+
+EvalContext::~EvalContext() {
+  s_active = m_previous;
+}
+
+EvalLimits EvalContext::left() const noexcept {
+  EvalLimits left = m_limits;
+  // a spent budget still allows one step, absorbing it then fails
+  if(m_limits.steps) left.steps = std::max<std::uint64_t>(1, m_limits.steps - std::min(m_limits.steps, m_steps));
+  if(m_limits.bytes) left.bytes = std::max<std::uint64_t>(1, m_limits.bytes - std::min(m_limits.bytes, m_bytes));
+  return left;
+}
+
+void EvalContext::absorb(std::uint64_t steps, std::uint64_t bytes) {
+  m_steps += steps;
+  m_bytes += bytes;
+  if(m_steps > m_limits.steps && m_limits.steps) stepLimit();
+  if(m_bytes > m_limits.bytes && m_limits.bytes) memoryLimit();
+}
+
+void EvalContext::checkDeadline() {
+  if(std::chrono::steady_clock::now() > m_deadline)
+    throw LimitError("Error: evaluation exceeded the time limit");
+}
+
+void EvalContext::stepLimit() {
+  throw LimitError("Error: evaluation exceeded the step limit");
+}
+
+void EvalContext::memoryLimit() {
+  throw LimitError("Error: evaluation exceeded the memory limit");
+}
+
+bool parseLimit(const std::string & option, const std::string & value, EvalLimits & limits) {
+  std::istringstream iss(value);
+  if(option == "--time-limit") {
+    double seconds;
+    if(!(iss >> seconds) || !iss.eof() || seconds < 0) return false;
+    limits.seconds = seconds;
+    return true;
+  }
+  if(option == "--parallel") {
+    unsigned threads;
+    if(!(iss >> threads) || !iss.eof()) return false;
+    limits.parallel = threads;
+    return true;
+  }
+  double count;
+  if(!(iss >> count) || count < 0) return false;
+  if(option == "--step-limit") {
+    if(!iss.eof()) return false;
+    limits.steps = static_cast<std::uint64_t>(count);
+    return true;
+  }
+  if(option == "--memory-limit") {
+    char suffix;
+    if(iss >> suffix) {
+      if(suffix == 'K' || suffix == 'k') count *= 1024.;
+      else if(suffix == 'M' || suffix == 'm') count *= 1024. * 1024.;
+      else if(suffix == 'G' || suffix == 'g') count *= 1024. * 1024. * 1024.;
+      else return false;
+      if(iss >> suffix) return false;
+    }
+    limits.bytes = static_cast<std::uint64_t>(count);
+    return true;
+  }
+  return false;
+}
@@ -0,0 +1,164 @@
+/*! \file eval_context.hpp
+Defines the per-evaluation context polled at safepoints.
+
+Each top-level evaluation runs inside an EvalContext that holds its
+cancellation token and its budget. Evaluation polls the context of its
+thread at safepoints: every Expression::eval counts a step, the loops of
+the special forms and plots poll for cancellation and the deadline, and
+the code that grows lists charges the memory budget. A cancelled token
+unwinds the evaluation with an InterruptError, an exhausted budget with a
+LimitError.
+ */
+#ifndef EVAL_CONTEXT_HPP
+#define EVAL_CONTEXT_HPP
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "cancellation.hpp"
+#include "semantic_error.hpp"
+#include "stats.hpp"
+
+class FutureGroup;
+
+/*! \struct EvalLimits
+\brief Budget of one top-level evaluation, a zero field is unlimited,
+and how many threads it may use.
+ */
+struct EvalLimits {
+  /// wall clock seconds
+  double seconds = 0;
+
+  /// number of Expression::eval calls
+  std::uint64_t steps = 0;
+
+  /// bytes of list storage allocated
+  std::uint64_t bytes = 0;
+
+  /// threads evaluating independent arguments at once, below 2 in order
+  unsigned parallel = 0;
+};
+
+/*! Set one field of limits from a command line option.
+  \param option one of --time-limit, --step-limit, --memory-limit or --parallel
+  \param value seconds, a step count, bytes with an optional K, M or G suffix,
+  or a thread count
+  \param limits the limits to update
+  \return false if option is not a limit or value is not valid for it
+ */
+bool parseLimit(const std::string & option, const std::string & value, EvalLimits & limits);
+
+/*! \class EvalContext
+\brief Makes a token and budget the ones polled by safepoints on this
+thread for the lifetime of the context.
+ */
+class EvalContext {
+public:
+  /*! Start polling token and charging limits.
+    \param token the token polled
+    \param limits the budget of the evaluation
+    \param futures where futures the evaluation starts run, or nullptr for
+    the pool shared by the process
+   */
+  EvalContext(const CancellationToken & token, const EvalLimits & limits = EvalLimits(),
+              FutureGroup * futures = nullptr);
+
+  /*! Poll the token and deadline of parent on this thread, with part of
+    its budget. The parent must outlive the context and absorb its counts.
+    \param parent the context of the evaluation this one is part of
+    \param left the budget left to the parent when the context was made
+   */
+  EvalContext(const EvalContext & parent, const EvalLimits & left);
+
+  /// restore the context that was polled before
+  ~EvalContext();
+
+  /// the token polled by the evaluation
+  const CancellationToken & token() const noexcept {return m_token;}
+
+  /// the limits of the evaluation
+  const EvalLimits & limits() const noexcept {return m_limits;}
+
+  /// where futures started by the evaluation run, nullptr for the shared pool
+  FutureGroup * futures() const noexcept {return m_futures;}
+
+  /// the step and memory budget not yet used, for a context on another thread
+  EvalLimits left() const noexcept;
+
+  /// charge the steps and bytes counted by a context on another thread
+  void absorb(std::uint64_t steps, std::uint64_t bytes);
+
+  /// the context of this thread, nullptr outside any evaluation
+  static EvalContext * active() noexcept {return s_active;}
+
+  /// throws if cancelled or past the deadline
+  void poll() {
+    if(m_token.cancelled()) throw InterruptError();
+    // reading the clock on every poll would dominate small steps
+    if(m_hasDeadline && ((++m_polls & 0xff) == 0)) checkDeadline();
+  }
+
+  /// count evaluation steps
+  void step(std::uint64_t count = 1) {
+    m_steps += count;
+    if(m_steps > m_limits.steps && m_limits.steps) stepLimit();
+    poll();
+  }
+
+  /// charge count new list elements
+  void charge(std::size_t count) {
+    m_bytes += count * ELEMENT_BYTES;
+    if(m_bytes > m_limits.bytes && m_limits.bytes) memoryLimit();
+    poll();
+  }
+
+  /// steps counted so far
+  std::uint64_t steps() const noexcept {return m_steps;}
+
+  /// bytes charged so far
+  std::uint64_t bytes() const noexcept {return m_bytes;}
+
+  /// approximate bytes taken by one element of a list
+  static const std::size_t ELEMENT_BYTES;
+
+private:
+  EvalContext(const EvalContext &) = delete;
+  EvalContext & operator=(const EvalContext &) = delete;
+
+  void checkDeadline();
+  [[noreturn]] void stepLimit();
+  [[noreturn]] void memoryLimit();
+
+  static thread_local EvalContext * s_active;
+
+  const CancellationToken & m_token;
+  EvalLimits m_limits;
+  FutureGroup * m_futures;
+  bool m_hasDeadline;
+  std::chrono::steady_clock::time_point m_deadline;
+  std::uint64_t m_polls = 0;
+  std::uint64_t m_steps = 0;
+  std::uint64_t m_bytes = 0;
+  EvalContext * m_previous;
+};
+
+/// A safepoint, polls the context of this thread if there is one.
+inline void safepoint() {
+  if(EvalContext * context = EvalContext::active()) context->poll();
+}
+
+/// Evaluation steps, counted against the context of this thread.
+inline void evalStep(std::uint64_t count = 1) {
+  countStat(EvalSteps, count);
+  if(EvalContext * context = EvalContext::active()) context->step(count);
+}
+
+/// Charge count new list elements to the context of this thread.
+inline void chargeList(std::size_t count = 1) {
+  countStat(ListElements, count);
+  if(EvalContext * context = EvalContext::active()) context->charge(count);
+}
+
+#endif
@@ -0,0 +1,89 @@
+#include "catch.hpp"
+
+#include <string>
+#include <sstream>
+#include <thread>
+#include <chrono>
+
+#include "eval_context.hpp"
+#include "interpreter.hpp"
+#include "semantic_error.hpp"
+
+Expression evalLimited(Interpreter & interp, const std::string & program){
+  std::istringstream iss(program);
+  REQUIRE(interp.parseStream(iss));
+  return interp.evaluate();
+}
+
+TEST_CASE( "Test cancellation tokens and contexts", "[eval_context]" ) {
+
+  REQUIRE(EvalContext::active() == nullptr);
+  REQUIRE_NOTHROW(safepoint());
+
+  CancellationToken outer, inner;
+  {
+    EvalContext outerContext(outer);
+    REQUIRE(EvalContext::active() == &outerContext);
+    REQUIRE_NOTHROW(safepoint());
+    outer.cancel();
+    REQUIRE_THROWS_AS(safepoint(), InterruptError);
+    {
+      INFO("a nested context polls its own token")
+      EvalContext innerContext(inner);
+      REQUIRE_NOTHROW(safepoint());
+    }
+    REQUIRE_THROWS_AS(safepoint(), InterruptError);
+    outer.reset();
+    REQUIRE_NOTHROW(safepoint());
+  }
+  REQUIRE(EvalContext::active() == nullptr);
+  outer.cancel();
+  REQUIRE_NOTHROW(safepoint());
+}
+
+TEST_CASE( "Test evaluation budgets", "[eval_context]" ) {
+
+  CancellationToken token;
+  EvalLimits limits;
+  limits.steps = 3;
+  limits.bytes = 2 * EvalContext::ELEMENT_BYTES;
+  {
+    EvalContext context(token, limits);
+    REQUIRE_NOTHROW(evalStep());
+    REQUIRE_NOTHROW(evalStep());
+    REQUIRE_NOTHROW(evalStep());
+    REQUIRE_THROWS_AS(evalStep(), LimitError);
+    REQUIRE_NOTHROW(chargeList(2));
+    REQUIRE(context.bytes() == limits.bytes);
+    REQUIRE_THROWS_AS(chargeList(), LimitError);
+  }
+
+  Interpreter interp;
+  evalLimited(interp, "(define a 1)");
+
+  INFO("step limit")
+  EvalLimits steps;
+  steps.steps = 1000;
+  interp.setLimits(steps);
+  REQUIRE(evalLimited(interp, "(+ a 1)") == Expression(2.));
+  REQUIRE_THROWS_AS(evalLimited(interp, "(begin (define f (lambda (x) (+ x 1))) (map f (range 0 10000 1)))"), LimitError);
+
+  INFO("memory limit")
+  EvalLimits memory;
+  memory.bytes = 1000 * EvalContext::ELEMENT_BYTES;
+  interp.setLimits(memory);
+  REQUIRE(evalLimited(interp, "(length (range 0 100 1))") == Expression(101.));
+  REQUIRE_THROWS_AS(evalLimited(interp, "(append (range 0 1000000 1) 0)"), LimitError);
+  INFO("a range is only charged once its elements are built")
+  REQUIRE(evalLimited(interp, "(length (rest (range 0 1000000 1)))") == Expression(1000000.));
+
+  INFO("time limit")
+  EvalLimits time;
+  time.seconds = 0.05;
+  interp.setLimits(time);
+  REQUIRE_THROWS_AS(evalLimited(interp, "(begin (define g (lambda (x) (+ x 1))) (map g (range 0 100000000 1)))"), LimitError);
+
+  INFO("the budget is per evaluation and the environment survives")
+  interp.setLimits(EvalLimits());
+  REQUIRE(evalLimited(interp, "(+ a 2)") == Expression(3.));
+}
@@ -6,9 +6,19 @@
 #include <unordered_map>
 #include <iomanip>
 #include <cmath>
+#include <functional>
+#include <utility>
 
+#include "eval_context.hpp"
 #include "environment.hpp"
+#include "future.hpp"
+#include "image.hpp"
+#include "lazy_range.hpp"
+#include "numeric_lambda.hpp"
+#include "parallel_eval.hpp"
+#include "plot_buffer.hpp"
 #include "semantic_error.hpp"
+#include "stats.hpp"
 
 Expression::Expression(){}
 
@@ -16,17 +26,31 @@ Expression::Expression(const Atom & a){
   m_head = a;
 }
 
-Expression::Expression(const std::list<Expression> & list) {
+Expression::Expression(LazyRange && range): m_range(std::make_shared<const LazyRange>(std::move(range))) {
+    Atom a("list");
+    m_head = a;
+    m_head.tagAtom();
+}
+
+Expression::Expression(PlotBuffer && plot): m_plot(std::make_shared<const PlotBuffer>(std::move(plot))) {
+    m_head = Atom("plot");
+}
+
+Expression::Expression(const std::list<Expression> & list): m_list(list) {
+    Atom a("list");
+    m_head = a;
+    m_head.tagAtom();
+}
+
+Expression::Expression(const PersistentList<Expression> & list): m_list(list) {
     Atom a("list");
     m_head = a;
     m_head.tagAtom();
-    m_list.clear();
-    for(auto e = list.begin(); e != list.end(); ++e)
-        m_list.push_back(*e);
 }
 
 // recursive copy
 Expression::Expression(const Expression & a){
+  countStat(ExpressionCopies);
   m_head = a.m_head;
   for(auto e : a.m_tail){
     m_tail.push_back(e);
@@ -41,18 +65,26 @@ Expression::Expression(const Expression & a){
     } else {
         m_head.deMarkLambda();
     }
-  m_list.clear();
-  for(auto e = a.m_list.begin(); e != a.m_list.end(); ++e)
-      m_list.push_back(*e);
-  properties.clear();
-    for(auto e = a.properties.begin(); e != a.properties.end(); e++) {
-        properties.emplace(e->first, e->second);
-    }
+  m_list = a.m_list;
+  m_range = a.m_range;
+  m_shape = a.m_shape;
+  m_props = a.m_props;
+  m_plot = a.m_plot;
+  m_future = a.m_future;
+}
+
+Expression::Expression(Expression && a) noexcept:
+  m_head(a.m_head), m_tail(std::move(a.m_tail)), m_list(std::move(a.m_list)),
+  m_range(std::move(a.m_range)), m_shape(a.m_shape), m_props(std::move(a.m_props)),
+  m_plot(std::move(a.m_plot)), m_future(std::move(a.m_future)){
+    if(a.m_head.isTagged()) m_head.tagAtom();
+    if(a.m_head.isLambda()) m_head.markLambda();
 }
 
 Expression & Expression::operator=(const Expression & a){
   // prevent self-assignment
   if(this != &a){
+    countStat(ExpressionCopies);
     m_head = a.m_head;
     m_tail.clear();
     for(auto e : a.m_tail){
@@ -68,17 +100,41 @@ Expression & Expression::operator=(const Expression & a){
       } else {
           m_head.deMarkLambda();
       }
-    m_list.clear();
-    for(auto e = a.m_list.begin(); e != a.m_list.end(); ++e)
-        m_list.push_back(*e);
-    properties.clear();
-      for(auto e = a.properties.begin(); e != a.properties.end(); e++) {
-          properties.emplace(e->first, e->second);
-      }
+    m_list = a.m_list;
+    m_range = a.m_range;
+    m_shape = a.m_shape;
+    m_props = a.m_props;
+    m_plot = a.m_plot;
+    m_future = a.m_future;
   }
   return *this;
 }
 
+Expression & Expression::operator=(Expression && a) noexcept{
+  if(this != &a){
+    // a may be part of this expression, so take it over first
+    Expression moved(std::move(a));
+    m_head = moved.m_head;
+    if(moved.m_head.isTagged()) {
+        m_head.tagAtom();
+    } else {
+        m_head.deTag();
+    }
+    if(moved.m_head.isLambda()) {
+        m_head.markLambda();
+    } else {
+        m_head.deMarkLambda();
+    }
+    m_tail = std::move(moved.m_tail);
+    m_list = std::move(moved.m_list);
+    m_range = std::move(moved.m_range);
+    m_shape = moved.m_shape;
+    m_props = std::move(moved.m_props);
+    m_plot = std::move(moved.m_plot);
+    m_future = std::move(moved.m_future);
+  }
+  return *this;
+}
 
 Atom & Expression::head(){
   return m_head;
@@ -88,6 +144,14 @@ const Atom & Expression::head() const{
   return m_head;
 }
 
+const PersistentList<Expression> & Expression::list() const {
+  return m_range ? m_range->elements() : m_list;
+}
+
+std::size_t Expression::listLength() const noexcept {
+  return m_range ? m_range->size() : m_list.size();
+}
+
 bool Expression::isHeadNumber() const noexcept{
   return m_head.isNumber();
 }
@@ -108,6 +172,10 @@ void Expression::append(const Atom & a){
   m_tail.emplace_back(a);
 }
 
+void Expression::append(Expression && exp){
+  m_tail.push_back(std::move(exp));
+}
+
 Expression * Expression::tail(){
   Expression * ptr = nullptr;
   if(m_tail.size() > 0){
@@ -140,6 +208,23 @@ Expression apply(const Atom & op, const std::vector<Expression> & args, const En
   return proc(args);
 }
 
+// plots are handed to list procedures as their list of primitives
+Expression expandPlot(const Expression & exp) {
+  return exp.isHeadPlot() ? exp.plot()->toExpression() : exp;
+}
+
+// the elements of a list as procedure arguments, a range is generated rather than built
+std::vector<Expression> listArguments(const Expression & lst) {
+  std::vector<Expression> args;
+  args.reserve(lst.listSize());
+  if(const LazyRange * range = lst.lazyRange()) {
+    range->forEach([&args](double x) { args.emplace_back(Atom(x)); });
+  } else {
+    args.assign(lst.listConstBegin(), lst.listConstEnd());
+  }
+  return args;
+}
+
 Expression Expression::handle_lookup(const Atom & head, const Environment & env){
     if(head.isSymbol()){ // if symbol is in env return value
       if(env.is_exp(head)){
@@ -216,10 +301,17 @@ Expression Expression::handle_define(Environment & env){
 Expression Expression::handle_list(Environment &env) {
     Expression result(m_head);
     result.m_head.tagAtom();
-    for(auto e = m_tail.begin(); e != m_tail.end(); ++e) {
-        Expression evaled = e->eval(env);
-        result.m_list.push_back(evaled);
+    std::vector<Expression> items;
+    if(evalParallel(m_tail, env, items)) {
+        chargeList(items.size());
+    } else {
+        for(auto e = m_tail.begin(); e != m_tail.end(); ++e) {
+            Expression evaled = e->eval(env);
+            chargeList();
+            items.push_back(evaled);
+        }
     }
+    result.m_list = PersistentList<Expression>(std::move(items));
     return result;
 }
 
@@ -229,16 +321,19 @@ Expression Expression::handle_lambda() {
     Expression result(m_head);
     result.m_head.markLambda();
     //add each parameter to vector of expressions, which is a needed for a procedure.
-    result.m_list.push_back(m_tail[0].head());
+    std::vector<Expression> params;
+    params.push_back(m_tail[0].head());
     for(auto e = m_tail[0].tailConstBegin(); e != m_tail[0].tailConstEnd(); ++e) {
-        result.m_list.push_back(*e);
+        params.push_back(*e);
     }
+    result.m_list = PersistentList<Expression>(std::move(params));
     //add the expression to m_tail
     result.m_tail.push_back(m_tail[1]);
     return result;
 }
 
 Expression Expression::eval_lambda(const Atom & op, const std::vector<Expression> & args, const Environment & env) {
+    countStat(LambdaCalls);
     Environment pocketenv = env;
     Expression lfunc = pocketenv.get_exp(op);
     if(args.size() != lfunc.listSize())
@@ -250,9 +345,12 @@ Expression Expression::eval_lambda(const Atom & op, const std::vector<Expression
         argCnt++;
     }
     Expression result = lfunc.m_tail[0].eval(pocketenv);
-    //need to copy properties here
-    for(auto e = lfunc.properties.begin(); e != lfunc.properties.end(); ++e)
-        result.properties.emplace(e->first, e->second);
+    //need to copy properties here, without overwriting the result's own
+    for(std::size_t i = 0; i < lfunc.m_props.size(); ++i) {
+        PropertyKey key = lfunc.m_shape->keyAt(i);
+        if(!result.find_prop(key))
+            result.set_prop(key, lfunc.m_props[i]);
+    }
     //also need to copy list here
     return result;
 }
@@ -267,17 +365,17 @@ Expression Expression::handle_apply(Environment &env) {
     if(!env.is_proc(pdr.head()) && !(env.get_exp(pdr.head()).isHeadLambda()))
         throw SemanticError("Error: first argument to apply is not a procedure.");
     //make sure m_tail[1] is a list
-    Expression lst = m_tail[1].eval(env);
+    Expression lst = expandPlot(m_tail[1].eval(env));
     if(!lst.isHeadList())
         throw SemanticError("Error: second argument to apply is not a list");
     //copy the list of values into a vector of arguments for easier translation
-    std::vector<Expression> args;
-    for(auto e = lst.listConstBegin(); e != lst.listConstEnd(); ++e)
-        args.push_back(*e);
+    std::vector<Expression> args = listArguments(lst);
     //now evaluate as a procedure if possible
     Expression result;
     if(env.is_proc(pdr.head())) {
         Procedure proc = env.get_proc(pdr.head());
+        for(auto & e : args)
+            if(e.isHeadPlot()) e = expandPlot(e);
         result = proc(args);
     }
     //now evaluate as a lambda if possible
@@ -287,43 +385,152 @@ Expression Expression::handle_apply(Environment &env) {
     return result;
 }
 
+// call visit with each element of a list, a range is generated rather than built
+template<typename Visitor>
+void forEachElement(const Expression & lst, Visitor visit) {
+  if(const LazyRange * range = lst.lazyRange()) {
+    range->forEach([&visit](double x) { visit(Expression(Atom(x))); });
+  } else {
+    for(auto e = lst.listConstBegin(); e != lst.listConstEnd(); ++e)
+      visit(*e);
+  }
+}
+
+std::function<Expression(const std::vector<Expression> &)> Expression::procedureCall(const Expression & pdr, Environment & env, const std::string & form) {
+    //make sure pdr is a procedure/lambda
+    if(pdr.m_tail.size() != 0)
+        throw SemanticError("Error: first argument to " + form + " is not a procedure.");
+    if(env.is_proc(pdr.head())) {
+        Procedure proc = env.get_proc(pdr.head());
+        return [proc](const std::vector<Expression> & args) {
+            std::vector<Expression> procargs;
+            for(auto & e : args)
+                procargs.push_back(expandPlot(e));
+            return proc(procargs);
+        };
+    }
+    if(!(env.get_exp(pdr.head()).isHeadLambda()))
+        throw SemanticError("Error: first argument to " + form + " is not a procedure.");
+    Atom op = pdr.head();
+    return [op, &env](const std::vector<Expression> & args) {
+        return eval_lambda(op, args, env);
+    };
+}
+
+// the numbers handed to a compiled lambda at once by map
+const std::size_t MAP_BATCH = 4096;
+
 Expression Expression::handle_map(Environment &env) {
     if(m_tail.size() != 2)
         throw SemanticError("Error: invalid number of arguments to map");
-    //evaluate the first and second arguments of apply, make sure m_tail[0] is procedure/lambda
-    Expression pdr = m_tail[0];
-    if(pdr.m_tail.size() != 0)
-        throw SemanticError("Error: first argument to map is not a procedure.");
-    if(!env.is_proc(pdr.head()) && !(env.get_exp(pdr.head()).isHeadLambda()))
-        throw SemanticError("Error: first argument to map is not a procedure.");
+    auto call = procedureCall(m_tail[0], env, "map");
     //make sure m_tail[1] is a list
-    Expression lst = m_tail[1].eval(env);
+    Expression lst = expandPlot(m_tail[1].eval(env));
     if(!lst.isHeadList())
         throw SemanticError("Error: second argument to map is not a list");
-    //copy the list of values into a vector of arguments for easier translation
-    std::vector<Expression> args;
-    for(auto e = lst.listConstBegin(); e != lst.listConstEnd(); ++e)
-        args.push_back(*e);
-    std::list<Expression> results;
-    //now evaluate as a procedure if possible
-    if(env.is_proc(pdr.head())) {
-        Procedure proc = env.get_proc(pdr.head());
-        for(auto e = args.begin(); e != args.end(); e++) {
-            std::vector<Expression> procargs;
-            procargs.push_back(*e);
-            results.push_back(proc(procargs));
+    //each element goes straight from the list, or the range generating it,
+    //to the call, so only the results are stored
+    std::vector<Expression> results;
+    results.reserve(lst.listSize());
+    std::vector<Expression> args(1);
+    //a numeric lambda runs over batches of numbers, anything it cannot
+    //evaluate goes through the call
+    std::shared_ptr<const NumericLambda> compiled;
+    if(!env.is_proc(m_tail[0].head()))
+        compiled = NumericLambda::compile(env.get_exp(m_tail[0].head()), env);
+    if(compiled && compiled->arity() != 1)
+        compiled.reset();
+    std::vector<double> xs, ys;
+    auto flush = [&]() {
+        if(xs.empty()) return;
+        safepoint();
+        ys.resize(xs.size());
+        const double * inputs = xs.data();
+        if(compiled->evaluate(&inputs, xs.size(), ys.data())) {
+            evalStep(compiled->steps() * xs.size());
+            for(auto y : ys) results.emplace_back(Atom(y));
+        } else {
+            for(auto x : xs) {
+                args[0] = Expression(Atom(x));
+                results.push_back(call(args));
+            }
         }
-    }
-    //now evaluate as a lambda if possible
-    if(env.get_exp(pdr.head()).isHeadLambda()) {
-        for(auto e = args.begin(); e != args.end(); e++) {
-            std::vector<Expression> procargs;
-            procargs.push_back(*e);
-            results.push_back(eval_lambda(pdr.head(), procargs, env));
+        xs.clear();
+    };
+    forEachElement(lst, [&](const Expression & e) {
+        chargeList();
+        if(compiled && e.isHeadNumber() && e.propSize() == 0) {
+            xs.push_back(e.head().asNumber());
+            if(xs.size() == MAP_BATCH) flush();
+            return;
         }
-    }
+        flush();
+        args[0] = e;
+        results.push_back(call(args));
+    });
+    flush();
     //base case return blank expression
-    return Expression(results);
+    return Expression(PersistentList<Expression>(std::move(results)));
+}
+
+Expression Expression::handle_fold(Environment &env) {
+    if(m_tail.size() != 3)
+        throw SemanticError("Error: invalid number of arguments to fold");
+    auto call = procedureCall(m_tail[0], env, "fold");
+    Expression init = m_tail[1].eval(env);
+    Expression lst = expandPlot(m_tail[2].eval(env));
+    if(!lst.isHeadList())
+        throw SemanticError("Error: third argument to fold is not a list");
+    //the accumulator and the element are the two arguments of each call
+    std::vector<Expression> args(2);
+    args[0] = init;
+    forEachElement(lst, [&call, &args](const Expression & e) {
+        safepoint();
+        args[1] = e;
+        args[0] = call(args);
+    });
+    return args[0];
+}
+
+Expression Expression::handle_reduce(Environment &env) {
+    if(m_tail.size() != 2)
+        throw SemanticError("Error: invalid number of arguments to reduce");
+    auto call = procedureCall(m_tail[0], env, "reduce");
+    Expression lst = expandPlot(m_tail[1].eval(env));
+    if(!lst.isHeadList())
+        throw SemanticError("Error: second argument to reduce is not a list");
+    if(lst.listSize() == 0)
+        throw SemanticError("Error: second argument to reduce is an empty list");
+    //the first element starts the accumulator
+    std::vector<Expression> args;
+    forEachElement(lst, [&call, &args](const Expression & e) {
+        safepoint();
+        if(args.empty()) {
+            args.push_back(e);
+            args.emplace_back();
+            return;
+        }
+        args[1] = e;
+        args[0] = call(args);
+    });
+    return args[0];
+}
+
+Expression Expression::handle_future(Environment &env) {
+    if(m_tail.size() != 1)
+        throw SemanticError("Error: invalid number of arguments to future");
+    Expression result(Atom("future"));
+    result.m_future = Future::start(m_tail[0], env);
+    return result;
+}
+
+Expression Expression::handle_force(Environment &env) {
+    if(m_tail.size() != 1)
+        throw SemanticError("Error: invalid number of arguments to force");
+    Expression value = m_tail[0].eval(env);
+    // anything else is already a value
+    if(!value.m_future) return value;
+    return value.m_future->force();
 }
 
 Expression Expression::property_set(Environment & env) {
@@ -356,37 +563,182 @@ Expression Expression::property_get(Environment & env) {
 void Expression::set_prop(const Expression & key, const Expression & value) {
     if(!key.isHeadString())
         throw SemanticError("Error: key is not an expression of type String.");
-    if(properties.find(key.head().asString()) != properties.end()) {
-        auto result = properties.find(key.head().asString());
-        result->second = value;
-    } else {
-        properties.emplace(key.head().asString(), value);
-    }
+    set_prop(internKey(key.head().asString()), value);
 }
 
 Expression Expression::get_prop(const Expression & key, const Expression & value) {
     Expression result;
-    if(key.isHeadString()) {
-        auto result = value.properties.find(key.head().asString());
-        if((result != value.properties.end()))
-            return result->second;
+    PropertyKey pkey;
+    // a name that was never interned cannot be set on anything
+    if(key.isHeadString() && findKey(key.head().asString(), pkey)) {
+        const Expression * found = value.find_prop(pkey);
+        if(found)
+            return *found;
     }
     return result;
 }
 
-void Expression::populatePoints(std::list<Expression> &list, const Expression & exp) {
-    for(auto e = exp.m_list.begin(); e != exp.m_list.end(); ++e) {
-        Expression a(*e);
-        list.push_back(a);
+void Expression::set_prop(PropertyKey key, const Expression & value) {
+    int index = m_shape ? m_shape->indexOf(key) : -1;
+    if(index >= 0) {
+        m_props[index] = value;
+    } else {
+        m_shape = (m_shape ? m_shape : PropertyShape::empty())->with(key);
+        m_props.push_back(value);
+    }
+}
+
+const Expression * Expression::find_prop(PropertyKey key) const noexcept {
+    int index = m_shape ? m_shape->indexOf(key) : -1;
+    return (index >= 0) ? &m_props[index] : nullptr;
+}
+
+// image encoding of the head atom type and the expression flags
+enum ImageHeadType {ImageNone, ImageNumber, ImageSymbol, ImageComplex, ImageString};
+const std::uint8_t IMAGE_LIST_FLAG = 1;
+const std::uint8_t IMAGE_LAMBDA_FLAG = 2;
+const std::uint8_t IMAGE_PACKED_FLAG = 4;
+
+// a plain number with nothing attached, these are stored packed in lists
+bool isPlainNumber(const Expression & exp) {
+    return exp.isHeadNumber() && !exp.isHeadList() && !exp.isHeadLambda() && exp.tailConstBegin() == exp.tailConstEnd() && exp.isListEmpty();
+}
+
+void Expression::serialize(ImageWriter & out) const {
+    if(m_future) {
+        // images store the value, nothing here could interrupt a wait for it
+        if(!m_future->finished()) throw SemanticError("Error: cannot save a future that has not finished");
+        m_future->force().serialize(out);
+        return;
+    }
+    if(m_plot) {
+        // images store the plain list form of a plot
+        m_plot->toExpression().serialize(out);
+        return;
+    }
+    const PersistentList<Expression> & items = list();
+    bool packed = !items.empty();
+    for(auto e = items.begin(); packed && e != items.end(); ++e)
+        packed = isPlainNumber(*e) && e->m_props.empty();
+    std::uint8_t flags = 0;
+    if(m_head.isTagged()) flags |= IMAGE_LIST_FLAG;
+    if(m_head.isLambda()) flags |= IMAGE_LAMBDA_FLAG;
+    if(packed) flags |= IMAGE_PACKED_FLAG;
+    if(m_head.isNumber()) {
+        out.u8(ImageNumber);
+        out.u8(flags);
+        out.f64(m_head.asNumber());
+    } else if(m_head.isSymbol()) {
+        out.u8(ImageSymbol);
+        out.u8(flags);
+        out.str(m_head.asSymbol());
+    } else if(m_head.isComplex()) {
+        out.u8(ImageComplex);
+        out.u8(flags);
+        out.f64(m_head.getComReal());
+        out.f64(m_head.getComImag());
+    } else if(m_head.isString()) {
+        out.u8(ImageString);
+        out.u8(flags);
+        out.str(m_head.asString());
+    } else {
+        out.u8(ImageNone);
+        out.u8(flags);
+    }
+    out.u64(m_tail.size());
+    for(auto & e : m_tail)
+        e.serialize(out);
+    out.u64(items.size());
+    if(packed) {
+        // written a block at a time, the list is not contiguous
+        double block[256];
+        std::size_t filled = 0;
+        for(auto & e : items) {
+            block[filled++] = e.m_head.asNumber();
+            if(filled == 256) {
+                out.f64s(block, filled);
+                filled = 0;
+            }
+        }
+        out.f64s(block, filled);
+    } else {
+        for(auto & e : items)
+            e.serialize(out);
+    }
+    out.u64(m_props.size());
+    for(std::size_t i = 0; i < m_props.size(); ++i) {
+        out.str(keyName(m_shape->keyAt(i)));
+        m_props[i].serialize(out);
+    }
+}
+
+bool Expression::deserialize(ImageReader & in, unsigned depth) {
+    // images may be untrusted, nesting must not exhaust the stack
+    if(depth >= IMAGE_MAX_DEPTH) return false;
+    std::uint8_t type, flags;
+    if(!in.u8(type) || !in.u8(flags)) return false;
+    Atom head;
+    if(type == ImageNumber) {
+        double value;
+        if(!in.f64(value)) return false;
+        head = Atom(value);
+    } else if(type == ImageSymbol) {
+        std::string value;
+        if(!in.str(value) || value.empty() || value.back() == '"') return false;
+        head = Atom(value);
+    } else if(type == ImageComplex) {
+        double re, im;
+        if(!in.f64(re) || !in.f64(im)) return false;
+        head = Atom(re, im);
+    } else if(type == ImageString) {
+        std::string value;
+        if(!in.str(value)) return false;
+        head = Atom(value + '"');
+    } else if(type != ImageNone) {
+        return false;
+    }
+    *this = Expression(head);
+    if(flags & IMAGE_LIST_FLAG) m_head.tagAtom();
+    if(flags & IMAGE_LAMBDA_FLAG) m_head.markLambda();
+    std::uint64_t count;
+    if(!in.u64(count)) return false;
+    for(std::uint64_t i = 0; i < count; ++i) {
+        m_tail.emplace_back();
+        if(!m_tail.back().deserialize(in, depth + 1)) return false;
+    }
+    if(!in.u64(count)) return false;
+    std::vector<Expression> items;
+    if(flags & IMAGE_PACKED_FLAG) {
+        if(!in.f64s(count, [&items](double value){ items.emplace_back(Atom(value)); })) return false;
+    } else {
+        for(std::uint64_t i = 0; i < count; ++i) {
+            items.emplace_back();
+            if(!items.back().deserialize(in, depth + 1)) return false;
+        }
+    }
+    m_list = PersistentList<Expression>(std::move(items));
+    if(!in.u64(count)) return false;
+    for(std::uint64_t i = 0; i < count; ++i) {
+        std::string key;
+        Expression value;
+        if(!in.str(key) || !value.deserialize(in, depth + 1)) return false;
+        set_prop(internKey(key), value);
     }
+    return true;
 }
 
-void Expression::findMaxMinPoints(double &AL, double &AU, double &OL, double &OU, const std::list<Expression> points) {
+void Expression::populatePoints(std::vector<double> &xs, std::vector<double> &ys, const Expression & exp) {
+    for(auto e = exp.listConstBegin(); e != exp.listConstEnd(); ++e) {
+        xs.push_back(e->listConstBegin()->head().asNumber());
+        ys.push_back(std::next(e->listConstBegin())->head().asNumber());
+    }
+}
+
+void Expression::findMaxMinPoints(double &AL, double &AU, double &OL, double &OU, const std::vector<double> &xs, const std::vector<double> &ys) {
     //x min and max values
-    for(auto e = points.begin(); e !=  points.end(); ++e) {
-        Expression pt = *e;
-        double x = pt.listConstBegin()->head().asNumber();
-        double y = std::next(pt.listConstBegin())->head().asNumber();
+    for(std::size_t i = 0; i < xs.size(); ++i) {
+        double x = xs[i];
+        double y = ys[i];
         if(x < AL) AL = x;
         if(x > AU) AU = x;
         if(y < OL) OL = y;
@@ -394,166 +746,77 @@ void Expression::findMaxMinPoints(double &AL, double &AU, double &OL, double &OU
     }
 }
 
-Expression Expression::makePExpression(const double x, const double y) {
-    Atom ax(x);
-    Atom ay(y);
-    Expression xp(ax);
-    Expression yp(ay);
-    std::list<Expression> pointform;
-    pointform.push_back(xp);
-    pointform.push_back(yp);
-    Expression result(pointform);
-    result.set_prop(Expression(Atom("object-name\"")), Expression(Atom("point\"")));
-    return result;
-}
-
-Expression Expression::makeLine(const double x1, const double y1, const double x2, const double y2) {
-    Expression point1 = makePExpression(x1, y1);
-    Expression point2 = makePExpression(x2, y2);
-    std::list<Expression> l1;
-    l1.push_back(point1);
-    l1.push_back(point2);
-    Expression line(l1);
-    line.set_prop(Expression(Atom("object-name\"")), Expression(Atom("line\"")));
-    line.set_prop(Expression(Atom("thickness\"")), Expression(Atom(0)));
-    return line;
-}
-
-std::list<Expression> Expression::makeGrid(const double xscale, const double yscale, const double AL, const double AU, const double OL, const double OU) {
-    std::list<Expression> lines;
+void Expression::makeGrid(PlotBuffer &plot, const double xscale, const double yscale, const double AL, const double AU, const double OL, const double OU) {
     bool x = true;
     bool y = true;
     if(OU < 0 || OL > 0) x = false;
     if(AU < 0 || AL > 0) y = false;
-    Expression bottom = makeLine(AL * xscale, -(OL*yscale), (AL * xscale) + N, -(OL*yscale));
-    Expression top = makeLine(AL * xscale, -(OU*yscale), (AL * xscale) + N, -(OU*yscale));
-    Expression right = makeLine((AU * xscale), -(OL*yscale), (AU * xscale), -(OU*yscale));
-    Expression left = makeLine((AL * xscale), -(OL*yscale), (AL * xscale), -(OU*yscale));
     if(x) {
-        Expression abscissa = makeLine(-(AL * xscale), 0, -(AL * xscale) - N, 0);
-        lines.push_back(abscissa);
+        plot.addLine(-(AL * xscale), 0, -(AL * xscale) - N, 0, 0);
     }
     if(y) {
-        Expression ordinate = makeLine(0, -(OL * yscale), 0, -(OL * yscale) - N);
-        lines.push_back(ordinate);
-    }
-    lines.push_back(bottom);
-    lines.push_back(top);
-    lines.push_back(left);
-    lines.push_back(right);
-    return lines;
-}
-
-std::list<Expression> Expression::scalePoints(const std::list<Expression> points, const double xscale, const double yscale, const double OL, const double OU) {
-    std::list<Expression> spoints;
-    for(auto e = points.begin(); e != points.end(); ++e) {
-        Expression pt = *e;
-        double xpt = (((pt.listConstBegin()->head().asNumber()) * xscale));
-        double ypt = -(((std::next(pt.listConstBegin()))->head().asNumber() * yscale));
-        Expression newPt = makePExpression(xpt, ypt);
-        Expression lolliLine;
-        if(OU < 0 || OL > 0) {
-            lolliLine = makeLine(xpt, ypt, xpt, -(OL*yscale));
-        } else {
-            lolliLine = makeLine(xpt, ypt, xpt, 0);
-        }
-        newPt.set_prop(Expression(Atom("object-name\"")), Expression(Atom("point\"")));
-        newPt.set_prop(Expression(Atom("size\"")), Expression(Atom(dP)));
-        spoints.push_back(newPt);
-        spoints.push_back(lolliLine);
+        plot.addLine(0, -(OL * yscale), 0, -(OL * yscale) - N, 0);
     }
-    return spoints;
+    //bottom, top, left, right
+    plot.addLine(AL * xscale, -(OL*yscale), (AL * xscale) + N, -(OL*yscale), 0);
+    plot.addLine(AL * xscale, -(OU*yscale), (AL * xscale) + N, -(OU*yscale), 0);
+    plot.addLine((AL * xscale), -(OL*yscale), (AL * xscale), -(OU*yscale), 0);
+    plot.addLine((AU * xscale), -(OL*yscale), (AU * xscale), -(OU*yscale), 0);
 }
 
-std::list<Expression> Expression::combineLists(const std::list<Expression> list1, const std::list<Expression> list2) {
-    std::list<Expression> result;
-    for(auto e = list1.begin(); e != list1.end(); ++e) {
-        result.push_back(*e);
-    }
-    for(auto e = list2.begin(); e != list2.end(); ++e) {
-        result.push_back(*e);
+void Expression::scalePoints(PlotBuffer &plot, const std::vector<double> &xs, const std::vector<double> &ys, const double xscale, const double yscale, const double OL, const double OU) {
+    for(std::size_t i = 0; i < xs.size(); ++i) {
+        double xpt = xs[i] * xscale;
+        double ypt = -(ys[i] * yscale);
+        plot.addPoint(xpt, ypt, dP);
+        //lollipop line down to the abscissa, or the bottom of the plot
+        if(OU < 0 || OL > 0) {
+            plot.addLine(xpt, ypt, xpt, -(OL*yscale), 0);
+        } else {
+            plot.addLine(xpt, ypt, xpt, 0, 0);
+        }
     }
-    return result;
 }
 
-Expression Expression::dbltoString(const double num) {
+std::string Expression::dbltoString(const double num) {
     std::stringstream ss;
     ss << std::setprecision(2) << num;
-    std::string string = ss.str();
-    string += '"';
-    return Expression(Atom(string));
+    return ss.str();
 }
 
-std::list<Expression> Expression::sigpointlabels(const double AL, const double AU, const double OL, const double OU) {
-    std::list<Expression> result;
+void Expression::sigpointlabels(PlotBuffer &plot, const double AL, const double AU, const double OL, const double OU) {
     double xscale = (N / ((AU) - (AL)));
     double yscale = (N / ((OU) - (OL)));
-    Expression eAL = dbltoString(AL);
-    eAL.set_prop(Expression(Atom("object-name\"")), Expression(Atom("text\"")));
-    eAL.set_prop(Expression(Atom("position\"")), makePExpression((AL * xscale), -(OL*yscale) + dC));
-    Expression eAU = dbltoString(AU);
-    eAU.set_prop(Expression(Atom("object-name\"")), Expression(Atom("text\"")));
-    eAU.set_prop(Expression(Atom("position\"")), makePExpression((AL * xscale) + N, -(OL*yscale) + dC));
-    Expression eOL = dbltoString(OL);
-    eOL.set_prop(Expression(Atom("object-name\"")), Expression(Atom("text\"")));
-    eOL.set_prop(Expression(Atom("position\"")), makePExpression((AL * xscale) - dD, -(OL*yscale)));
-    Expression eOU = dbltoString(OU);
-    eOU.set_prop(Expression(Atom("object-name\"")), Expression(Atom("text\"")));
-    eOU.set_prop(Expression(Atom("position\"")), makePExpression((AL * xscale) - dD, -(OL*yscale) - N));
-    result.push_back(eAL);
-    result.push_back(eAU);
-    result.push_back(eOL);
-    result.push_back(eOU);
-    return result;
+    plot.addText(dbltoString(AL), (AL * xscale), -(OL*yscale) + dC, 1, 0);
+    plot.addText(dbltoString(AU), (AL * xscale) + N, -(OL*yscale) + dC, 1, 0);
+    plot.addText(dbltoString(OL), (AL * xscale) - dD, -(OL*yscale), 1, 0);
+    plot.addText(dbltoString(OU), (AL * xscale) - dD, -(OL*yscale) - N, 1, 0);
 }
 
-Expression makeText(const std::string text) {
-    std::string temp = text + '"';
-    return Expression(Atom(temp));
-}
-
-std::list<Expression> Expression::handleOptions(const Expression options, const double AL, const double AU, const double OL, const double OU) {
-    std::list<Expression> yes;
+void Expression::handleOptions(PlotBuffer &plot, const Expression options, const double AL, const double AU, const double OL, const double OU) {
     double scale = 1;
     double xscale = (N / ((AU) - (AL)));
     double yscale = (N / ((OU) - (OL)));
+    std::size_t first = plot.textCount();
     for(auto e = options.listConstBegin(); e != options.listConstEnd(); ++e) {
-        Expression label = *e;
-        std::string id = label.listConstBegin()->head().asString();
-        std::string data;
-        Expression result;
+        std::string id = e->listConstBegin()->head().asString();
         if(id == "title") {
-            data = std::next(label.listConstBegin())->head().asString();
-            result = makeText(data);
-            result.set_prop(Expression(Atom("object-name\"")), Expression(Atom("text\"")));
-            result.set_prop(Expression(Atom("rotation\"")), Expression(Atom(0)));
-            result.set_prop(Expression(Atom("position\"")), makePExpression(((AL + AU) / 2) * xscale, -(OU * yscale) - dA));
-            yes.push_back(result);
+            std::string data = std::next(e->listConstBegin())->head().asString();
+            plot.addText(data, ((AL + AU) / 2) * xscale, -(OU * yscale) - dA, 1, 0);
         } else if(id == "abscissa-label") {
-            data = std::next(label.listConstBegin())->head().asString();
-            result = makeText(data);
-            result.set_prop(Expression(Atom("object-name\"")), Expression(Atom("text\"")));
-            result.set_prop(Expression(Atom("rotation\"")), Expression(Atom(0)));
-            result.set_prop(Expression(Atom("position\"")), makePExpression(((AL + AU) / 2) * xscale, -(OL * yscale) + dA));
-            yes.push_back(result);
+            std::string data = std::next(e->listConstBegin())->head().asString();
+            plot.addText(data, ((AL + AU) / 2) * xscale, -(OL * yscale) + dA, 1, 0);
         } else if(id == "ordinate-label") {
-            data = std::next(label.listConstBegin())->head().asString();
-            result = makeText(data);
-            result.set_prop(Expression(Atom("object-name\"")), Expression(Atom("text\"")));
-            result.set_prop(Expression(Atom("rotation\"")), Expression(Atom(-(M_PI/2))));
-            result.set_prop(Expression(Atom("position\"")), makePExpression((AL * xscale) - dB, -((OL + OU) / 2) * yscale));
-            yes.push_back(result);
+            std::string data = std::next(e->listConstBegin())->head().asString();
+            plot.addText(data, (AL * xscale) - dB, -((OL + OU) / 2) * yscale, 1, -(M_PI/2));
         } else if(id == "text-scale") {
-            scale = std::next(label.listConstBegin())->head().asNumber();
+            scale = std::next(e->listConstBegin())->head().asNumber();
         }
     }
-    std::list<Expression> result;
-    for(auto e = yes.begin(); e != yes.end(); ++e) {
-        Expression label = *e;
-        label.set_prop(Expression(Atom("scale\"")), Expression(Atom(scale)));
-        result.push_back(label);
+    //the text scale applies to every label, wherever it appears in the options
+    for(std::size_t i = first; i < plot.textCount(); ++i) {
+        plot.textScale[i] = scale;
     }
-    return result;
 }
 
 Expression Expression::discrete_plot(Environment & env) {
@@ -561,52 +824,63 @@ Expression Expression::discrete_plot(Environment & env) {
         throw SemanticError("Error: wrong number of arguments to discrete plot");
     double AL = 999999, AU = -999999, OL = 999999, OU = -999999;
     Expression DATA = m_tail[0].eval(env);
-    Expression OPTIONS = m_tail[1].eval(env);
-    std::list<Expression> points;
-    populatePoints(points, DATA);
-    findMaxMinPoints(AL, AU, OL, OU, points);
+    Expression OPTIONS;
+    if(m_tail.size() > 1)
+        OPTIONS = m_tail[1].eval(env);
+    std::vector<double> xs, ys;
+    populatePoints(xs, ys, DATA);
+    findMaxMinPoints(AL, AU, OL, OU, xs, ys);
     double xscale = (N / ((AU) - (AL)));
     double yscale = (N / ((OU) - (OL)));
-    std::list<Expression> gridlines = makeGrid(xscale, yscale, AL, AU, OL, OU);
-    std::list<Expression> scaledPoints = scalePoints(points, xscale, yscale, OL, OU);
-    std::list<Expression> plotdata = combineLists(gridlines, scaledPoints);
-    std::list<Expression> numLabels = sigpointlabels(AL, AU, OL, OU);
-    plotdata = combineLists(plotdata, numLabels);
-    std::list<Expression> labels = handleOptions(OPTIONS, AL, AU, OL, OU);
-    plotdata = combineLists(plotdata, labels);
-    Expression result(plotdata);
-    return result;
+    PlotBuffer plot;
+    makeGrid(plot, xscale, yscale, AL, AU, OL, OU);
+    scalePoints(plot, xs, ys, xscale, yscale, OL, OU);
+    sigpointlabels(plot, AL, AU, OL, OU);
+    handleOptions(plot, OPTIONS, AL, AU, OL, OU);
+    return Expression(std::move(plot));
 }
 
-std::vector<Expression> Expression::fillBounds(const Expression BOUNDS) {
+std::vector<double> Expression::fillBounds(const Expression BOUNDS) {
     double low = BOUNDS.listConstBegin()->head().asNumber();
     double high = std::next(BOUNDS.listConstBegin())->head().asNumber();
     double samplesize = ((high - low) / (cM + 0));
-    std::vector<Expression> result;
+    std::vector<double> result;
     for(auto i = low; i <= (high + samplesize); i += samplesize) {
-        result.push_back(Expression(Atom(i)));
+        result.push_back(i);
     }
     return result;
 }
 
-void Expression::continuousPoints(std::list<Expression> &points, const Expression FUNC, const Expression BOUNDS, Environment & env) {
-    std::vector<Expression> args = fillBounds(BOUNDS);
-    for(auto e : args) {
-        std::vector<Expression> singlearg;
-        singlearg.push_back(e);
-        Expression yval = eval_lambda(FUNC.head(), singlearg, env);
-        Expression pt = makePExpression(e.head().asNumber(), yval.head().asNumber());
-        points.push_back(pt);
+double Expression::getLambdaYValue(const double x, const Expression FUNC, Environment & env, const NumericLambda * compiled) {
+    double y;
+    const double * inputs = &x;
+    if(compiled && compiled->evaluate(&inputs, 1, &y)) {
+        evalStep(compiled->steps());
+        return y;
+    }
+    std::vector<Expression> args;
+    args.push_back(Expression(Atom(x)));
+    return eval_lambda(FUNC.head(), args, env).head().asNumber();
+}
+
+void Expression::continuousPoints(std::vector<double> &xs, std::vector<double> &ys, const Expression FUNC, const Expression BOUNDS, Environment & env, const NumericLambda * compiled) {
+    xs = fillBounds(BOUNDS);
+    //all the samples at once when the function compiles
+    ys.resize(xs.size());
+    const double * inputs = xs.data();
+    if(compiled && compiled->evaluate(&inputs, xs.size(), ys.data())) {
+        evalStep(compiled->steps() * xs.size());
+        return;
+    }
+    ys.clear();
+    for(auto x : xs) {
+        safepoint();
+        ys.push_back(getLambdaYValue(x, FUNC, env, nullptr));
     }
 }
 
-bool checksplit(const Expression p1, const Expression p2, const Expression p3) {
-    double x2 = p1.listConstBegin()->head().asNumber();
-    double y2 = std::next(p1.listConstBegin())->head().asNumber();
-    double x1 = p2.listConstBegin()->head().asNumber();
-    double y1 = std::next(p2.listConstBegin())->head().asNumber();
-    double x3 = p3.listConstBegin()->head().asNumber();
-    double y3 = std::next(p3.listConstBegin())->head().asNumber();
+// true if the angle at the middle point is sharp enough to need more samples
+bool checksplit(const double x2, const double y2, const double x1, const double y1, const double x3, const double y3) {
     double dx21 = x2-x1;
     double dx31 = x3-x1;
     double dy21 = y2-y1;
@@ -621,75 +895,39 @@ bool checksplit(const Expression p1, const Expression p2, const Expression p3) {
     return false;
 }
 
-Expression Expression::getLambdaYValue(const Expression x, const Expression FUNC, Environment & env) {
-    std::vector<Expression> args;
-    args.push_back(x);
-    Expression yval = eval_lambda(FUNC.head(), args, env);
-    Expression pt = makePExpression(x.head().asNumber(), (yval.head().asNumber()));
-    return pt;
-}
-
-std::list<Expression> Expression::makeSplitLine(const Expression p1, const Expression p2, const Expression p3, const Expression FUNC, Environment & env) {
-    std::list<Expression> newPoints;
-    double x1 = p1.listConstBegin()->head().asNumber();
-    double x2 = p2.listConstBegin()->head().asNumber();
-    double x3 = p3.listConstBegin()->head().asNumber();
-    Expression split1half = getLambdaYValue(Expression(Atom(((x1+x2)/2))), FUNC, env);
-    Expression split2half = getLambdaYValue(Expression(Atom(((x2+x3)/2))), FUNC, env);
-    newPoints.push_back(p1);
-    newPoints.push_back(split1half);
-    newPoints.push_back(p2);
-    newPoints.push_back(split2half);
-    newPoints.push_back(p3);
-    return newPoints;
-}
-
-std::list<Expression> Expression::convP2Lines(const std::list<Expression> points, const double xscale, const double yscale) {
-    std::list<Expression> lines;
-    for(auto e = points.begin(); e != std::prev(points.end()); ++e) {
-        Expression p1 = *e;
-        Expression p2 = *(std::next(e));
-        Expression line = makeLine((p1.listConstBegin()->head().asNumber()) * xscale, -(std::next(p1.listConstBegin())->head().asNumber()) * yscale, (p2.listConstBegin()->head().asNumber()) * xscale, -(std::next(p2.listConstBegin())->head().asNumber())* yscale);
-        lines.push_back(line);
-    }
-    return lines;
-}
-
-std::list<Expression> Expression::smoothedLines(const std::list<Expression> points, const Expression FUNC, Environment & env) {
-    std::list<Expression> smoothies;
-    for(auto e = points.begin(); e != std::prev(std::prev(points.end())); ++e) {
-        Expression p1 = *e;
-        Expression p2 = *(std::next(e));
-        Expression p3 = *(std::next(std::next(e)));
-        if(checksplit(p1, p2, p3)) {
-            std::list<Expression> additionalPoints = makeSplitLine(p1, p2, p3, FUNC, env);
-            for(auto i : additionalPoints)
-                smoothies.push_back(i);
-            e = (std::next(e));
+void Expression::smoothedLines(std::vector<double> &sx, std::vector<double> &sy, const std::vector<double> &xs, const std::vector<double> &ys, const Expression FUNC, Environment & env, const NumericLambda * compiled) {
+    std::size_t n = xs.size();
+    for(std::size_t i = 0; i + 2 < n; ++i) {
+        safepoint();
+        if(checksplit(xs[i], ys[i], xs[i+1], ys[i+1], xs[i+2], ys[i+2])) {
+            //sample half way between each pair of the three points
+            double x12 = (xs[i] + xs[i+1]) / 2;
+            double x23 = (xs[i+1] + xs[i+2]) / 2;
+            double y12 = getLambdaYValue(x12, FUNC, env, compiled);
+            double y23 = getLambdaYValue(x23, FUNC, env, compiled);
+            sx.insert(sx.end(), {xs[i], x12, xs[i+1], x23, xs[i+2]});
+            sy.insert(sy.end(), {ys[i], y12, ys[i+1], y23, ys[i+2]});
+            ++i;
         } else {
-            smoothies.push_back(p1);
-            if(e == std::prev(std::prev(std::prev(points.end())))) {
-                smoothies.push_back(p2);
-                smoothies.push_back(p3);
+            sx.push_back(xs[i]);
+            sy.push_back(ys[i]);
+            if(i + 3 == n) {
+                sx.insert(sx.end(), {xs[i+1], xs[i+2]});
+                sy.insert(sy.end(), {ys[i+1], ys[i+2]});
             }
         }
     }
-    return smoothies;
 }
 
-std::list<Expression> removePointLines(const std::list<Expression> lines) {
-    std::list<Expression> result;
-    for(auto e = lines.begin(); e != lines.end(); ++e) {
-        Expression l = *e;
-        Expression p1 = *l.listConstBegin();
-        double x1 = p1.listConstBegin()->head().asNumber();
-        Expression p2 = *std::next(l.listConstBegin());
-        double x2 = p2.listConstBegin()->head().asNumber();
+void Expression::convP2Lines(PlotBuffer &plot, const std::vector<double> &xs, const std::vector<double> &ys, const double xscale, const double yscale) {
+    for(std::size_t i = 0; i + 1 < xs.size(); ++i) {
+        double x1 = xs[i] * xscale;
+        double x2 = xs[i+1] * xscale;
+        //repeated samples would give zero length lines
         if(x1 != x2) {
-            result.push_back(l);
+            plot.addLine(x1, -ys[i] * yscale, x2, -ys[i+1] * yscale, 0);
         }
     }
-    return result;
 }
 
 Expression Expression::continuous_plot(Environment & env) {
@@ -699,28 +937,29 @@ Expression Expression::continuous_plot(Environment & env) {
     Expression OPTIONS;
     if(m_tail.size() == 3)
         OPTIONS = m_tail[2].eval(env);
-    std::list<Expression> points;
-    continuousPoints(points, FUNC, BOUNDS, env);
-    std::list<Expression> smoothed = smoothedLines(points, FUNC, env);
-    findMaxMinPoints(AL, AU, OL, OU, smoothed);
+    std::shared_ptr<const NumericLambda> compiled = NumericLambda::compile(env.get_exp(FUNC.head()), env);
+    if(compiled && compiled->arity() != 1)
+        compiled.reset();
+    std::vector<double> xs, ys;
+    continuousPoints(xs, ys, FUNC, BOUNDS, env, compiled.get());
+    std::vector<double> sx, sy;
+    smoothedLines(sx, sy, xs, ys, FUNC, env, compiled.get());
+    findMaxMinPoints(AL, AU, OL, OU, sx, sy);
     double xscale = (N / ((AU) - (AL)));
     double yscale = (N / ((OU) - (OL)));
-    std::list<Expression> gridlines = makeGrid(xscale, yscale, AL, AU, OL, OU);
-    std::list<Expression> functionLines = convP2Lines(smoothed, xscale, yscale);
-    std::list<Expression> rest = removePointLines(functionLines);
-    std::list<Expression> plotdata = combineLists(gridlines, rest);
-    std::list<Expression> numLabels = sigpointlabels(AL, AU, OL, OU);
-    plotdata = combineLists(plotdata, numLabels);
-    std::list<Expression> labels = handleOptions(OPTIONS, AL, AU, OL, OU);
-    plotdata = combineLists(plotdata, labels);
-    Expression result(plotdata);
-    return result;
+    PlotBuffer plot;
+    makeGrid(plot, xscale, yscale, AL, AU, OL, OU);
+    convP2Lines(plot, sx, sy, xscale, yscale);
+    sigpointlabels(plot, AL, AU, OL, OU);
+    handleOptions(plot, OPTIONS, AL, AU, OL, OU);
+    return Expression(std::move(plot));
 }
 
 // this is a simple recursive version. the iterative version is more
 // difficult with the ast data structure used (no parent pointer).
 // this limits the practical depth of our AST
 Expression Expression::eval(Environment & env){
+  evalStep();
   if(m_tail.empty()){
     return handle_lookup(m_head, env);
   }
@@ -745,6 +984,18 @@ Expression Expression::eval(Environment & env){
   else if(m_head.isSymbol() && m_head.asSymbol() == "map") {
       return handle_map(env);
   }
+  else if(m_head.isSymbol() && m_head.asSymbol() == "fold") {
+      return handle_fold(env);
+  }
+  else if(m_head.isSymbol() && m_head.asSymbol() == "reduce") {
+      return handle_reduce(env);
+  }
+  else if(m_head.isSymbol() && m_head.asSymbol() == "future") {
+      return handle_future(env);
+  }
+  else if(m_head.isSymbol() && m_head.asSymbol() == "force") {
+      return handle_force(env);
+  }
   else if(m_head.isSymbol() && m_head.asSymbol() == "set-property") {
       return property_set(env);
   }
@@ -761,19 +1012,49 @@ Expression Expression::eval(Environment & env){
   // else attempt to treat as procedure
   else{ 
     std::vector<Expression> results;
+    // with --parallel, independent costly arguments are evaluated at once
+    if(evalParallel(m_tail, env, results)) return invoke(m_head, results, env);
+    // built-ins with a fixed-arity entry take one or two arguments directly
+    if(m_tail.size() == 1) {
+      if(UnaryProcedure unary = env.get_unary(m_head)) {
+        Expression arg = m_tail[0].eval(env);
+        if(!arg.isHeadPlot()) return unary(arg);
+        results.push_back(std::move(arg));
+        return invoke(m_head, results, env);
+      }
+    }
+    else if(m_tail.size() == 2) {
+      if(BinaryProcedure binary = env.get_binary(m_head)) {
+        Expression first = m_tail[0].eval(env);
+        Expression second = m_tail[1].eval(env);
+        if(!first.isHeadPlot() && !second.isHeadPlot()) return binary(first, second);
+        results.push_back(std::move(first));
+        results.push_back(std::move(second));
+        return invoke(m_head, results, env);
+      }
+    }
     for(Expression::IteratorType it = m_tail.begin(); it != m_tail.end(); ++it)
       results.push_back(it->eval(env));
-    if(env.get_exp(m_head).head().isLambda()) {
-        Expression result = eval_lambda(m_head, results, env);
-        return result;
-    } else return apply(m_head, results, env);
+    return invoke(m_head, results, env);
   }
   return Expression();
 }
 
+Expression Expression::invoke(const Atom & op, std::vector<Expression> & args, Environment & env){
+  if(env.get_exp(op).head().isLambda()) {
+      Expression result = eval_lambda(op, args, env);
+      return result;
+  }
+  for(auto & e : args)
+    if(e.isHeadPlot()) e = expandPlot(e);
+  return apply(op, args, env);
+}
+
 std::ostream & operator<<(std::ostream & out, const Expression & exp){
     //special cases for convenience
     if(exp.isHeadNone()) { out << exp.head(); return out;}
+    if(exp.isHeadPlot()) {out << exp.plot()->toExpression(); return out;}
+    if(exp.isHeadFuture()) {out << "(future)"; return out;}
     if(exp.isHeadString()) {out << "(\"" << exp.head() << "\")"; return out;}
     //normal output
     out << "(";
@@ -809,6 +1090,10 @@ std::ostream & operator<<(std::ostream & out, const Expression & exp){
 }
 
 bool Expression::operator==(const Expression & exp) const noexcept{
+  if(m_plot || exp.m_plot)
+    return m_plot && exp.m_plot && (*m_plot == *exp.m_plot);
+  if(m_future || exp.m_future)
+    return m_future == exp.m_future;
   bool result = (m_head == exp.m_head);
   result = result && (m_tail.size() == exp.m_tail.size());
   if(result){
@@ -8,13 +8,33 @@ Defines the Expression type and assiciated functions.
 #include <vector>
 #include <list>
 #include <map>
+#include <memory>
+#include <functional>
 
 #include "token.hpp"
 #include "atom.hpp"
+#include "persistent_list.hpp"
+#include "property.hpp"
 
 // forward declare Environment
 class Environment;
 
+// forward declare the plot primitive storage
+class PlotBuffer;
+
+// forward declare the unmaterialized range
+class LazyRange;
+
+// forward declare the compiled numeric lambdas
+class NumericLambda;
+
+// forward declare the values of future
+class Future;
+
+// forward declare the image encoders
+class ImageWriter;
+class ImageReader;
+
 /*! \class Expression
 \brief An expression is a tree of Atoms.
 
@@ -25,7 +45,7 @@ class Expression {
 public:
 
   typedef std::vector<Expression>::const_iterator ConstIteratorType;
-  typedef std::list<Expression>::const_iterator ConstListIteratorType;
+  typedef PersistentList<Expression>::const_iterator ConstListIteratorType;
 
   /// Default construct and Expression, whose type in NoneType
   Expression();
@@ -37,12 +57,27 @@ public:
     
   /// deep-copy construct an expression (recursive)
   Expression(const Expression & a);
+
+  /// move construct an expression, taking over the tail of a
+  Expression(Expression && a) noexcept;
     
   Expression(const std::list<Expression> & list);
 
+  /// Construct a list Expression sharing the elements of list
+  explicit Expression(const PersistentList<Expression> & list);
+
+  /// Construct a list Expression standing for the elements of a range
+  Expression(LazyRange && range);
+
+  /// Construct an Expression taking over the primitives of a plot
+  Expression(PlotBuffer && plot);
+
   /// deep-copy assign an expression  (recursive)
   Expression & operator=(const Expression & a);
 
+  /// move assign an expression, taking over the tail of a
+  Expression & operator=(Expression && a) noexcept;
+
   /// return a reference to the head Atom
   Atom & head();
 
@@ -52,6 +87,9 @@ public:
   /// append Atom to tail of the expression
   void append(const Atom & a);
 
+  /// append an expression to the tail, taking it over
+  void append(Expression && exp);
+
   /// return a pointer to the last expression in the tail, or nullptr
   Expression * tail();
 
@@ -61,11 +99,17 @@ public:
   /// return a const-iterator to the tail end
   ConstIteratorType tailConstEnd() const noexcept;
     
+  /// the elements of a list, or the parameters of a lambda, a range is built here
+  const PersistentList<Expression> & list() const;
+
+  /// the range a list stands for, or nullptr if its elements are stored
+  const LazyRange * lazyRange() const noexcept {return m_range.get();}
+
   /// return a const-iterator to the list beginning
-  ConstListIteratorType listConstBegin() const noexcept {return m_list.cbegin();}
+  ConstListIteratorType listConstBegin() const {return list().cbegin();}
     
   /// return a const-iterator to the list end
-  ConstListIteratorType listConstEnd() const noexcept {return m_list.cend();}
+  ConstListIteratorType listConstEnd() const {return list().cend();}
     
   /// convienience member to determine if head atom is of type none
   bool isHeadNone() const noexcept {return m_head.isNone();}
@@ -88,21 +132,60 @@ public:
   /// conveience member to determine if hte head atom is a string literal
   bool isHeadString() const noexcept {return m_head.isString();}
   
+  /// convienience member to determine if the expression holds a plot
+  bool isHeadPlot() const noexcept {return m_plot != nullptr;}
+
+  /// the primitives of a plot, or nullptr if the expression is not a plot
+  const PlotBuffer * plot() const noexcept {return m_plot.get();}
+
+  /// convienience member to determine if the expression holds a future
+  bool isHeadFuture() const noexcept {return m_future != nullptr;}
+
+  /// the future the expression stands for, or nullptr
+  Future * future() const noexcept {return m_future.get();}
+
   /// convienience member to determine if the list is empty
-  bool isListEmpty() const noexcept {return m_list.size() == 0;}
+  bool isListEmpty() const noexcept {return listLength() == 0;}
     
   /// conveinience member to return the size of a list
-  double listSize() const noexcept {return m_list.size();}
+  double listSize() const noexcept {return listLength();}
 
   /// Evaluate expression using a post-order traversal (recursive)
   Expression eval(Environment & env);
 
+  /*! Call the lambda or procedure named op with evaluated arguments, as
+    eval does for a procedure call.
+    \param op the name of the lambda or procedure
+    \param args the arguments, plots are expanded to their primitives for procedures
+    \param env the environment of the call
+   */
+  static Expression invoke(const Atom & op, std::vector<Expression> & args, Environment & env);
+
   /// equality comparison for two expressions (recursive)
   bool operator==(const Expression & exp) const noexcept;
     
   //Property list setters and getters
   void set_prop(const Expression & key, const Expression & value);
   Expression get_prop(const Expression & key, const Expression & value);
+
+  /// set the property with interned key to value
+  void set_prop(PropertyKey key, const Expression & value);
+
+  /// return a pointer to the property with interned key, or nullptr
+  const Expression * find_prop(PropertyKey key) const noexcept;
+
+  /// number of properties set on the expression
+  std::size_t propSize() const noexcept {return m_props.size();}
+
+  /// write the expression (recursively) in image encoding
+  void serialize(ImageWriter & out) const;
+
+  /*! Replace this expression with one read from an image.
+    \param in the image reader positioned at the expression
+    \param depth how deeply nested the expression is, at most IMAGE_MAX_DEPTH
+    \return false if malformed or nested too deeply
+   */
+  bool deserialize(ImageReader & in, unsigned depth = 0);
   
 private:
 
@@ -113,11 +196,25 @@ private:
   // and cache coherence, at the cost of wasted memory.
   std::vector<Expression> m_tail;
     
-  // list data type to store values from list
-  std::list<Expression> m_list;
+  // the elements of a list, shared between copies
+  PersistentList<Expression> m_list;
+
+  // the range a list stands for, shared between copies
+  std::shared_ptr<const LazyRange> m_range;
+
+  // the number of list elements, stored or not
+  std::size_t listLength() const noexcept;
     
-  //property list
-  std::map<std::string, Expression> properties;
+  // property list, the keys live in the (shared) shape and only the
+  // values, in shape order, are stored per expression
+  const PropertyShape * m_shape = nullptr;
+  std::vector<Expression> m_props;
+
+  // geometry of a plot, shared between copies
+  std::shared_ptr<const PlotBuffer> m_plot;
+
+  // a value being evaluated in the background, shared between copies
+  std::shared_ptr<Future> m_future;
 
   // convenience typedef
   typedef std::vector<Expression>::iterator IteratorType;
@@ -130,28 +227,28 @@ private:
   Expression handle_lambda();
   Expression handle_apply(Environment & env);
   Expression handle_map(Environment & env);
+  Expression handle_fold(Environment & env);
+  Expression handle_reduce(Environment & env);
+  Expression handle_future(Environment & env);
+  Expression handle_force(Environment & env);
+  std::function<Expression(const std::vector<Expression> &)> procedureCall(const Expression & pdr, Environment & env, const std::string & form);
   Expression property_get(Environment & env);
   Expression property_set(Environment & env);
   Expression discrete_plot(Environment & env);
   Expression continuous_plot(Environment & env);
-  Expression eval_lambda(const Atom & op, const std::vector<Expression> & args, const Environment & env);
-  void populatePoints(std::list<Expression> &list, const Expression & exp);
-  void findMaxMinPoints(double &AL, double &AU, double &OL, double &OU, const std::list<Expression> points);
-  Expression makePExpression(const double x, const double y);
-  std::list<Expression> makeGrid(const double xscale, const double yscale, const double AL, const double AU, const double OL, const double OU);
-  Expression makeLine(const double x1, const double y1, const double x2, const double y2);
-  std::list<Expression> scalePoints(const std::list<Expression> points, const double xscale, const double yscale, const double OL, const double OU);
-  std::list<Expression> combineLists(const std::list<Expression> list1, const std::list<Expression> list2);
-  std::list<Expression> sigpointlabels(const double AL, const double AU, const double OL, const double OU);
-  Expression dbltoString(const double num);
-  std::list<Expression> handleOptions(const Expression options, const double AL, const double AU, const double OL, const double OU);
-  std::vector<Expression> fillBounds(const Expression BOUNDS);
-  void continuousPoints(std::list<Expression> &points, const Expression FUNC, const Expression BOUNDS, Environment & env);
-  std::list<Expression> scaleCPoints(const std::list<Expression> points, const double xscale, const double yscale);
-  std::list<Expression> convP2Lines(const std::list<Expression> points, const double xscale, const double yscale);
-  std::list<Expression> makeSplitLine(const Expression p1, const Expression p2, const Expression p3, const Expression FUNC, Environment & env);
-  Expression getLambdaYValue(const Expression x, const Expression FUNC, Environment & env);
-  std::list<Expression> smoothedLines(const std::list<Expression> points, const Expression FUNC, Environment & env);
+  static Expression eval_lambda(const Atom & op, const std::vector<Expression> & args, const Environment & env);
+  void populatePoints(std::vector<double> &xs, std::vector<double> &ys, const Expression & exp);
+  void findMaxMinPoints(double &AL, double &AU, double &OL, double &OU, const std::vector<double> &xs, const std::vector<double> &ys);
+  void makeGrid(PlotBuffer &plot, const double xscale, const double yscale, const double AL, const double AU, const double OL, const double OU);
+  void scalePoints(PlotBuffer &plot, const std::vector<double> &xs, const std::vector<double> &ys, const double xscale, const double yscale, const double OL, const double OU);
+  void sigpointlabels(PlotBuffer &plot, const double AL, const double AU, const double OL, const double OU);
+  std::string dbltoString(const double num);
+  void handleOptions(PlotBuffer &plot, const Expression options, const double AL, const double AU, const double OL, const double OU);
+  std::vector<double> fillBounds(const Expression BOUNDS);
+  void continuousPoints(std::vector<double> &xs, std::vector<double> &ys, const Expression FUNC, const Expression BOUNDS, Environment & env, const NumericLambda * compiled);
+  void convP2Lines(PlotBuffer &plot, const std::vector<double> &xs, const std::vector<double> &ys, const double xscale, const double yscale);
+  double getLambdaYValue(const double x, const Expression FUNC, Environment & env, const NumericLambda * compiled);
+  void smoothedLines(std::vector<double> &sx, std::vector<double> &sy, const std::vector<double> &xs, const std::vector<double> &ys, const Expression FUNC, Environment & env, const NumericLambda * compiled);
   //graphics scales
   double dP = 0.5;
   double dD = 2;
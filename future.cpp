@@ -0,0 +1,151 @@
+#include "future.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <thread>
+
+#include "cancellation.hpp"
+
+// how long a waiting force sleeps between polls of its context
+const std::chrono::milliseconds FORCE_POLL(10);
+
+struct Future::Job {
+  Job(const Expression & exp, const Environment & env, const EvalLimits & limits):
+    exp(exp), env(env), limits(limits) {}
+
+  enum State {Pending, Running, Done};
+
+  // move from Pending to Running, false if another thread did
+  bool claim() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if(state != Pending) return false;
+    state = Running;
+    return true;
+  }
+
+  // evaluate once claimed, polling token, starting futures in group
+  void run(const CancellationToken & token, FutureGroup * group) {
+    Expression result;
+    std::exception_ptr failure;
+    try {
+      // cancelled before it started, as when forced after its group was
+      if(this->token.cancelled()) throw InterruptError();
+      EvalContext context(token, limits, group);
+      result = exp.eval(env);
+    } catch(...) {
+      failure = std::current_exception();
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      value = std::move(result);
+      error = failure;
+      state = Done;
+    }
+    finished.notify_all();
+  }
+
+  Expression exp;
+  Environment env;
+  EvalLimits limits;
+  CancellationToken token;
+
+  std::mutex mutex;
+  std::condition_variable finished;
+  State state = Pending;
+  Expression value;
+  std::exception_ptr error;
+};
+
+FutureGroup & sharedFutures() {
+  // never destroyed, exiting does not wait for futures nobody forced
+  static FutureGroup * group = new FutureGroup;
+  return *group;
+}
+
+std::shared_ptr<Future> Future::start(const Expression & exp, const Environment & env) {
+  EvalLimits limits;
+  FutureGroup * group = nullptr;
+  if(EvalContext * context = EvalContext::active()) {
+    limits = context->limits();
+    group = context->futures();
+  }
+  std::shared_ptr<Job> job(new Job(exp, env, limits));
+  (group ? *group : sharedFutures()).submit(job);
+  return std::shared_ptr<Future>(new Future(job));
+}
+
+Future::~Future() {
+  m_job->token.cancel();
+}
+
+Expression Future::force() {
+  Job & job = *m_job;
+  if(job.claim()) {
+    // not started yet, so evaluate it here, stopped by what stops the caller
+    EvalContext * context = EvalContext::active();
+    job.run(context ? context->token() : job.token, context ? context->futures() : nullptr);
+  }
+  std::unique_lock<std::mutex> lock(job.mutex);
+  while(job.state != Job::Done) {
+    job.finished.wait_for(lock, FORCE_POLL);
+    try {
+      safepoint();
+    } catch(...) {
+      job.token.cancel();
+      throw;
+    }
+  }
+  if(job.error) std::rethrow_exception(job.error);
+  return job.value;
+}
+
+bool Future::finished() const {
+  std::lock_guard<std::mutex> lock(m_job->mutex);
+  return m_job->state == Job::Done;
+}
+
+FutureGroup::~FutureGroup() {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_closing = true;
+  }
+  cancel();
+  // the pool finishes what is queued, cancelled jobs stop at once
+  m_pool.reset();
+}
+
+void FutureGroup::cancel() {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  for(auto & weak : m_jobs) {
+    if(std::shared_ptr<Future::Job> job = weak.lock()) job->token.cancel();
+  }
+  m_jobs.clear();
+  m_kept = 0;
+}
+
+void FutureGroup::submit(const std::shared_ptr<Future::Job> & job) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if(m_closing) {
+    // started by a future being cancelled, so it is cancelled too
+    job->token.cancel();
+    return;
+  }
+  if(!m_pool) m_pool.reset(new workerPool(std::max(1u, std::thread::hardware_concurrency())));
+  // drop finished futures once the list doubles, so it stays proportional
+  // to the futures still referred to
+  if(m_jobs.size() >= 2 * std::max<std::size_t>(m_kept, 16)) {
+    m_jobs.erase(std::remove_if(m_jobs.begin(), m_jobs.end(),
+                                [](const std::weak_ptr<Future::Job> & weak) { return weak.expired(); }),
+                 m_jobs.end());
+    m_kept = m_jobs.size();
+  }
+  m_jobs.push_back(job);
+  std::weak_ptr<Future::Job> weak = job;
+  FutureGroup * group = this;
+  m_pool->submit([weak, group]() {
+    std::shared_ptr<Future::Job> started = weak.lock();
+    if(started && !started->token.cancelled() && started->claim()) started->run(started->token, group);
+  });
+}
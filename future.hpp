@@ -0,0 +1,104 @@
+/*! \file future.hpp
+Defines the Future type, the value of the future special form, and the
+FutureGroup an interpreter runs its futures in.
+ */
+#ifndef FUTURE_HPP
+#define FUTURE_HPP
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "environment.hpp"
+#include "eval_context.hpp"
+#include "expression.hpp"
+#include "workerPool.hpp"
+
+/*! \class Future
+\brief An expression evaluated in the background, whose value is waited for
+when it is forced.
+
+(future exp) starts evaluating exp on the worker pool of the interpreter
+evaluating the form and evaluates to a Future at once. (force f) waits for
+the value, or rethrows the error evaluating exp raised. The expression is
+evaluated in a copy of the environment of the future form, so like the
+body of a lambda, its definitions are not seen outside of it. It has a
+budget of its own, the limits of the evaluation that started it.
+
+A future no worker has started yet is evaluated by the thread forcing it,
+so futures forcing other futures never wait on a queue the pool cannot
+get to. A future nothing refers to any more is cancelled: it is never
+started, or stops at its next safepoint.
+ */
+class Future {
+public:
+
+  /*! Start evaluating exp on the worker pool of the FutureGroup of this
+    thread's EvalContext, or on a pool shared by the process without one.
+    \param exp the expression to evaluate
+    \param env the environment to evaluate it in, which is copied
+    \return the future, shared by the expressions holding it
+   */
+  static std::shared_ptr<Future> start(const Expression & exp, const Environment & env);
+
+  /// cancel the evaluation, nothing can force it any more
+  ~Future();
+
+  /*! The value of the expression, waiting for it if needed. Waiting polls
+    the context of this thread, and an interrupt while waiting stops the
+    future too.
+    \return the value
+    \throws the SemanticError the evaluation raised
+   */
+  Expression force();
+
+  /// true once the value or error is known, so force() will not wait
+  bool finished() const;
+
+  /// the evaluation, shared with the worker running it
+  struct Job;
+
+private:
+  explicit Future(const std::shared_ptr<Job> & job): m_job(job) {}
+  Future(const Future &) = delete;
+  Future & operator=(const Future &) = delete;
+
+  std::shared_ptr<Job> m_job;
+};
+
+/*! \class FutureGroup
+\brief The worker pool futures run on, and the futures started on it, so
+they can be cancelled together.
+
+Every Interpreter has a group. Interrupting or resetting the interpreter
+cancels its futures, and destroying it cancels them and waits for its
+workers. The workers are only started with the first future.
+ */
+class FutureGroup {
+public:
+
+  FutureGroup() = default;
+
+  /// cancel every future and wait for the workers
+  ~FutureGroup();
+
+  /// cancel every future started so far, forcing them throws an InterruptError
+  void cancel();
+
+  /// queue job on the workers
+  void submit(const std::shared_ptr<Future::Job> & job);
+
+private:
+  FutureGroup(const FutureGroup &) = delete;
+  FutureGroup & operator=(const FutureGroup &) = delete;
+
+  std::mutex m_mutex;
+  std::vector<std::weak_ptr<Future::Job>> m_jobs;
+  // jobs in m_jobs when expired ones were last dropped
+  std::size_t m_kept = 0;
+  // set once destruction starts, later jobs are not queued
+  bool m_closing = false;
+  std::unique_ptr<workerPool> m_pool;
+};
+
+#endif
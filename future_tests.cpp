@@ -0,0 +1,91 @@
+#include "catch.hpp"
+
+#include <chrono>
+#include <string>
+#include <sstream>
+#include <thread>
+
+#include "future.hpp"
+#include "interpreter.hpp"
+#include "semantic_error.hpp"
+
+Expression runFutures(Interpreter & interp, const std::string & program){
+  std::istringstream iss(program);
+  REQUIRE(interp.parseStream(iss));
+  return interp.evaluate();
+}
+
+TEST_CASE( "Test forcing futures", "[future]" ) {
+
+  Interpreter interp;
+  runFutures(interp, "(define a 2)");
+
+  Expression f = runFutures(interp, "(future (* a 3))");
+  REQUIRE(f.isHeadFuture());
+  REQUIRE(f == f);
+  REQUIRE(f != runFutures(interp, "(future (* a 3))"));
+  REQUIRE(f.future()->force() == Expression(6.));
+
+  INFO("a forced future is an ordinary value")
+  REQUIRE(runFutures(interp, "(+ 1 (force (future (* a 3))))") == Expression(7.));
+  REQUIRE(runFutures(interp, "(begin (define g (future (map sin (list 0 0)))) (first (force g)))") == Expression(0.));
+  REQUIRE(runFutures(interp, "(force g)") == runFutures(interp, "(list 0 0)"));
+  REQUIRE(runFutures(interp, "(force a)") == Expression(2.));
+
+  INFO("futures forcing futures")
+  REQUIRE(runFutures(interp,
+    "(begin (define h (lambda (x) (future (+ x 1)))) (force (future (+ (force (h 1)) (force (h 2))))))") == Expression(5.));
+
+  INFO("definitions in a future stay in the future")
+  REQUIRE(runFutures(interp, "(force (future (begin (define b 5) b)))") == Expression(5.));
+  REQUIRE_THROWS_AS(runFutures(interp, "(begin b)"), SemanticError);
+}
+
+TEST_CASE( "Test errors of futures", "[future]" ) {
+
+  Interpreter interp;
+
+  INFO("the error is raised when forcing, every time")
+  Expression f = runFutures(interp, "(future (first (list)))");
+  REQUIRE(f.isHeadFuture());
+  REQUIRE_THROWS_AS(f.future()->force(), SemanticError);
+  REQUIRE_THROWS_AS(f.future()->force(), SemanticError);
+
+  REQUIRE_THROWS_AS(runFutures(interp, "(future)"), SemanticError);
+  REQUIRE_THROWS_AS(runFutures(interp, "(force 1 2)"), SemanticError);
+
+  INFO("a future has the limits of the evaluation starting it")
+  EvalLimits limits;
+  limits.steps = 1000;
+  interp.setLimits(limits);
+  REQUIRE_THROWS_AS(runFutures(interp, "(begin (define f (lambda (x) (+ x 1))) (force (future (map f (range 0 10000 1)))))"), LimitError);
+}
+
+TEST_CASE( "Test cancelling futures", "[future]" ) {
+
+  Interpreter interp;
+  runFutures(interp, "(define f (lambda (x) (+ x 1)))");
+
+  INFO("interrupting the interpreter cancels its futures")
+  Expression slow = runFutures(interp, "(future (map f (range 0 10000000 1)))");
+  interp.interrupt();
+  REQUIRE_THROWS_AS(slow.future()->force(), InterruptError);
+
+  INFO("so does resetting it")
+  runFutures(interp, "(define f (lambda (x) (+ x 1)))");
+  slow = runFutures(interp, "(future (map f (range 0 10000000 1)))");
+  interp.reset();
+  REQUIRE_THROWS_AS(slow.future()->force(), InterruptError);
+
+  INFO("futures started later run as before")
+  REQUIRE(runFutures(interp, "(force (future (+ 1 2)))") == Expression(3.));
+
+  INFO("dropping the last reference to a future stops it")
+  runFutures(interp, "(define f (lambda (x) (+ x 1)))");
+  runFutures(interp, "(begin (future (map f (range 0 10000000 1))) 1)");
+  // give a worker time to see the cancellation, then nothing evaluates
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  std::uint64_t steps = Interpreter::stats()[EvalSteps];
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  REQUIRE(Interpreter::stats()[EvalSteps] == steps);
+}
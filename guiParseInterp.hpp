@@ -6,18 +6,48 @@
 #include <fstream>
 #include <atomic>
 #include <thread>
+#include <future>
+#include <functional>
+#include <memory>
+#include <cstdint>
 #include "interpreter.hpp"
-#include "tsQueue.hpp"
+#include "scene_data.hpp"
+#include "spscQueue.hpp"
+#include "trace.hpp"
 
-typedef tsQueue<QString> parseQueue;
-typedef tsQueue<Expression> resultQueue;
-typedef tsQueue<std::string> messageQueue;
+// the outcome of a request, the scene to show or the error message
+struct guiResult {
+    std::shared_ptr<SceneData> scene;
+    std::string error;
+    // when the kernel finished it, for tracing
+    TraceClock::time_point finished;
+};
+
+// a program for the kernel, completed through its promise
+struct guiRequest {
+    std::uint64_t id;
+    QString line;
+    std::shared_ptr<std::promise<guiResult>> done;
+    // when it was queued, for tracing
+    TraceClock::time_point queued;
+};
+
+typedef spscQueue<guiRequest> parseQueue;
+
+// called on the kernel thread after the request with the given id completes
+typedef std::function<void(std::uint64_t)> completionHandler;
 
 class guiParseInterp {
 public:
     guiParseInterp() {}
-    void startThread(messageQueue *mQ, parseQueue *pQ, resultQueue *rQ, std::atomic_bool *solved, Interpreter * interp) {
-        pool.emplace_back(std::thread(&guiParseInterp::gpI, this, mQ, pQ, rQ, solved, interp));
+    void startThread(parseQueue *pQ, Interpreter * interp, completionHandler completed) {
+        pool.emplace_back(std::thread(&guiParseInterp::gpI, this, pQ, interp, completed));
+    }
+    void stopThread(parseQueue *pQ) {
+        if(pool.size() > 0) {
+            pQ->push(guiRequest{0, QString("%%%%%"), nullptr, TraceClock::time_point()});
+            joinAll();
+        }
     }
     int size() {
         return pool.size();
@@ -31,29 +61,31 @@ public:
     }
 private:
     std::vector<std::thread> pool;
-    void gpI(messageQueue *mQ, parseQueue *pQ, resultQueue *rQ, std::atomic_bool *solved, Interpreter * interp) {
+    void gpI(parseQueue *pQ, Interpreter * interp, completionHandler completed) {
+        traceThreadName("kernel");
         while(1) {
-            QString line;
-            pQ->wait_and_pop(line);
-            std::istringstream expression(line.toStdString());
-            if(line.toStdString() == "%%%%%") return;
+            guiRequest request;
+            pQ->wait_and_pop(request);
+            if(!request.done) return;
+            traceSpan(QueueWait, request.queued, TraceClock::now(), request.id);
+            guiResult result;
+            std::istringstream expression(request.line.toStdString());
             if(!interp->parseStream(expression)){
-                mQ->push("Error: Could not parse.");
-                solved->store(false);
+                result.error = "Error: Could not parse.";
             }
             else{
                 try{
-                    Expression exp = interp->evaluate();
-                    rQ->push(exp);
-                    solved->store(true);
-                    exp = Expression();
+                    Expression exp = interp->evaluate(request.id);
+                    //build the scene here so the GUI thread only swaps it in
+                    result.scene = std::make_shared<SceneData>(exp);
                 }
                 catch(const SemanticError & ex){
-                    std::string error = ex.what();
-                    mQ->push(error);
-                    solved->store(false);
+                    result.error = ex.what();
                 }
             }
+            result.finished = TraceClock::now();
+            request.done->set_value(result);
+            if(completed) completed(request.id);
         }
     }
 };
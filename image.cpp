@@ -0,0 +1,141 @@
+#include "image.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+#if defined(__APPLE__) || defined(__linux) || defined(__unix) || defined(__posix)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define IMAGE_USE_MMAP 1
+#endif
+
+/***********************************************************************
+ImageWriter
+**********************************************************************/
+
+void ImageWriter::u8(std::uint8_t value) {
+  m_out.put(static_cast<char>(value));
+}
+
+void ImageWriter::u32(std::uint32_t value) {
+  m_out.write(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+void ImageWriter::u64(std::uint64_t value) {
+  m_out.write(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+void ImageWriter::f64(double value) {
+  m_out.write(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+void ImageWriter::f64s(const double * values, std::size_t count) {
+  m_out.write(reinterpret_cast<const char *>(values), count * sizeof(double));
+}
+
+void ImageWriter::str(const std::string & value) {
+  u64(value.size());
+  m_out.write(value.data(), value.size());
+}
+
+/***********************************************************************
+ImageReader
+**********************************************************************/
+
+const char * ImageReader::take(std::size_t n) {
+  if(!m_good || (m_size - m_pos) < n) {
+    m_good = false;
+    return nullptr;
+  }
+  const char * ptr = m_data + m_pos;
+  m_pos += n;
+  return ptr;
+}
+
+bool ImageReader::u8(std::uint8_t & value) {
+  const char * ptr = take(sizeof(value));
+  if(ptr) value = static_cast<std::uint8_t>(*ptr);
+  return ptr != nullptr;
+}
+
+bool ImageReader::u32(std::uint32_t & value) {
+  const char * ptr = take(sizeof(value));
+  if(ptr) std::memcpy(&value, ptr, sizeof(value));
+  return ptr != nullptr;
+}
+
+bool ImageReader::u64(std::uint64_t & value) {
+  const char * ptr = take(sizeof(value));
+  if(ptr) std::memcpy(&value, ptr, sizeof(value));
+  return ptr != nullptr;
+}
+
+bool ImageReader::f64(double & value) {
+  const char * ptr = take(sizeof(value));
+  if(ptr) std::memcpy(&value, ptr, sizeof(value));
+  return ptr != nullptr;
+}
+
+bool ImageReader::str(std::string & value) {
+  std::uint64_t length;
+  if(!u64(length)) return false;
+  const char * ptr = take(length);
+  if(ptr) value.assign(ptr, length);
+  return ptr != nullptr;
+}
+
+/***********************************************************************
+MappedFile
+**********************************************************************/
+
+MappedFile::MappedFile(const std::string & filename) {
+#ifdef IMAGE_USE_MMAP
+  int fd = open(filename.c_str(), O_RDONLY);
+  if(fd < 0) return;
+  struct stat st;
+  if(fstat(fd, &st) == 0 && st.st_size > 0) {
+    void * addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if(addr != MAP_FAILED) {
+      m_data = static_cast<const char *>(addr);
+      m_size = st.st_size;
+      m_mapped = true;
+    }
+  }
+  close(fd);
+#else
+  std::ifstream ifs(filename, std::ios::binary);
+  if(!ifs) return;
+  std::string contents((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+  if(contents.empty()) return;
+  char * buffer = new char[contents.size()];
+  std::memcpy(buffer, contents.data(), contents.size());
+  m_data = buffer;
+  m_size = contents.size();
+#endif
+}
+
+MappedFile::~MappedFile() {
+  if(!m_data) return;
+#ifdef IMAGE_USE_MMAP
+  if(m_mapped) {
+    munmap(const_cast<char *>(m_data), m_size);
+    return;
+  }
+#endif
+  delete [] m_data;
+}
+
+std::uint64_t imageDigest(std::istream & source) {
+  std::uint64_t hash = 14695981039346656037ULL;
+  char buffer[4096];
+  while(source.read(buffer, sizeof(buffer)) || source.gcount() > 0) {
+    for(std::streamsize i = 0; i < source.gcount(); ++i) {
+      hash ^= static_cast<unsigned char>(buffer[i]);
+      hash *= 1099511628211ULL;
+    }
+  }
+  return hash;
+}
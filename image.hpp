@@ -0,0 +1,142 @@
+/*! \file image.hpp
+Defines the binary encoding used to write an Environment to an image file
+and to restore it again.
+
+An image is a flat, position independent byte sequence: a fixed header
+followed by the environment entries. All values are stored in host byte
+order (the header records which) so an image is decoded straight out of a
+memory mapping without any per-value conversion. Decoding still builds
+every Expression of the environment, so restoring takes time and memory
+in proportion to the size of the environment, without evaluating it.
+ */
+#ifndef IMAGE_HPP
+#define IMAGE_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <istream>
+#include <ostream>
+#include <string>
+
+/*! \class ImageWriter
+\brief Appends primitive values to an output stream in image encoding.
+ */
+class ImageWriter {
+public:
+
+  /// Construct a writer that appends to out
+  ImageWriter(std::ostream & out): m_out(out) {}
+
+  /// write a single byte
+  void u8(std::uint8_t value);
+
+  /// write an unsigned 32 bit integer
+  void u32(std::uint32_t value);
+
+  /// write an unsigned 64 bit integer
+  void u64(std::uint64_t value);
+
+  /// write a double
+  void f64(double value);
+
+  /// write a contiguous array of doubles
+  void f64s(const double * values, std::size_t count);
+
+  /// write a length-prefixed string
+  void str(const std::string & value);
+
+  /// true if every write so far has succeeded
+  bool good() const {return m_out.good();}
+
+private:
+  std::ostream & m_out;
+};
+
+/*! \class ImageReader
+\brief Reads primitive values back out of an in-memory image.
+
+Every read is bounds checked; once a read fails the reader stays failed
+and all further reads return false.
+ */
+class ImageReader {
+public:
+
+  /// Construct a reader over size bytes starting at data
+  ImageReader(const char * data, std::size_t size): m_data(data), m_size(size) {}
+
+  bool u8(std::uint8_t & value);
+  bool u32(std::uint32_t & value);
+  bool u64(std::uint64_t & value);
+  bool f64(double & value);
+  bool str(std::string & value);
+
+  /// read count doubles, appending them to out via out(double)
+  template<typename Sink>
+  bool f64s(std::uint64_t count, Sink out);
+
+  /// true if no read has failed
+  bool good() const {return m_good;}
+
+  /// true if every byte of the image has been consumed
+  bool atEnd() const {return m_pos == m_size;}
+
+private:
+  const char * m_data;
+  std::size_t m_size;
+  std::size_t m_pos = 0;
+  bool m_good = true;
+
+  // claim n bytes, returning a pointer to them or nullptr when out of range
+  const char * take(std::size_t n);
+};
+
+template<typename Sink>
+bool ImageReader::f64s(std::uint64_t count, Sink out) {
+  for(std::uint64_t i = 0; i < count; ++i) {
+    double value;
+    if(!f64(value)) return false;
+    out(value);
+  }
+  return true;
+}
+
+/*! \class MappedFile
+\brief Read-only view of a whole file.
+
+On POSIX systems the file is memory mapped, elsewhere it is read into a
+buffer. Either way data() is valid for the lifetime of the object.
+ */
+class MappedFile {
+public:
+
+  /// Open and map filename, check isOpen() for success
+  MappedFile(const std::string & filename);
+
+  ~MappedFile();
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile & operator=(const MappedFile &) = delete;
+
+  bool isOpen() const {return m_data != nullptr;}
+  const char * data() const {return m_data;}
+  std::size_t size() const {return m_size;}
+
+private:
+  const char * m_data = nullptr;
+  std::size_t m_size = 0;
+  bool m_mapped = false;
+};
+
+/// magic bytes at the start of every image
+const char IMAGE_MAGIC[8] = {'P','L','S','I','M','G','\0','\1'};
+
+/// the deepest nesting of expressions an image may hold
+const unsigned IMAGE_MAX_DEPTH = 1000;
+
+/// current image format version, bump when the encoding changes
+const std::uint32_t IMAGE_VERSION = 1;
+
+/// FNV-1a digest of a stream's contents, used to tie an image to its source
+std::uint64_t imageDigest(std::istream & source);
+
+#endif
@@ -0,0 +1,157 @@
+#include "catch.hpp"
+
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <cstdio>
+
+#include "image.hpp"
+#include "interpreter.hpp"
+#include "semantic_error.hpp"
+
+Expression evalIn(Interpreter & interp, const std::string & program){
+  std::istringstream iss(program);
+  REQUIRE(interp.parseStream(iss));
+  return interp.evaluate();
+}
+
+TEST_CASE( "Test image primitive encoding", "[image]" ) {
+
+  std::ostringstream oss;
+  ImageWriter out(oss);
+  out.u8(7);
+  out.u32(123456);
+  out.u64(1234567890123ULL);
+  out.f64(-2.5);
+  out.str("hello");
+  REQUIRE(out.good());
+
+  std::string data = oss.str();
+  ImageReader in(data.data(), data.size());
+  std::uint8_t a; std::uint32_t b; std::uint64_t c; double d; std::string e;
+  REQUIRE(in.u8(a));
+  REQUIRE(in.u32(b));
+  REQUIRE(in.u64(c));
+  REQUIRE(in.f64(d));
+  REQUIRE(in.str(e));
+  REQUIRE(a == 7);
+  REQUIRE(b == 123456);
+  REQUIRE(c == 1234567890123ULL);
+  REQUIRE(d == -2.5);
+  REQUIRE(e == "hello");
+  REQUIRE(in.atEnd());
+
+  // reading past the end fails and stays failed
+  REQUIRE(!in.u8(a));
+  REQUIRE(!in.good());
+}
+
+TEST_CASE( "Test environment image round trip", "[image]" ) {
+
+  const std::string filename = "image_tests_roundtrip.img";
+  {
+    Interpreter interp;
+    evalIn(interp, "(define nums (range 0 1000 1))");
+    evalIn(interp, "(define mixed (list 1 (+ 1 I) \"str\" (list 2 3)))");
+    evalIn(interp, "(define sq (set-property \"name\" \"square\" (lambda (x) (* x x))))");
+    REQUIRE(interp.saveImage(filename, 42));
+  }
+
+  Interpreter restored;
+  REQUIRE(restored.loadImage(filename));
+  REQUIRE(evalIn(restored, "(length nums)") == Expression(1001.));
+  REQUIRE(evalIn(restored, "(first (rest nums))") == Expression(1.));
+  REQUIRE(evalIn(restored, "(sq 12)") == Expression(144.));
+  REQUIRE(evalIn(restored, "(get-property \"name\" sq)").head().asString() == "square");
+  REQUIRE(evalIn(restored, "(imag (first (rest mixed)))") == Expression(1.));
+  REQUIRE(evalIn(restored, "(first (rest (rest mixed)))").head().asString() == "str");
+  REQUIRE(evalIn(restored, "(length (first (rest (rest (rest mixed)))))") == Expression(2.));
+  REQUIRE(evalIn(restored, "(+ pi 0)") == Expression(std::atan2(0, -1)));
+
+  std::remove(filename.c_str());
+}
+
+TEST_CASE( "Test rejected images", "[image]" ) {
+
+  Interpreter interp;
+  evalIn(interp, "(define a 1)");
+
+  INFO("missing file")
+  REQUIRE(!interp.loadImage("image_tests_does_not_exist.img"));
+
+  INFO("not an image")
+  const std::string bogus = "image_tests_bogus.img";
+  {
+    std::ofstream ofs(bogus);
+    ofs << "(begin (define a 2))";
+  }
+  REQUIRE(!interp.loadImage(bogus));
+
+  INFO("stale image")
+  const std::string source = "image_tests_source.pls";
+  const std::string stale = "image_tests_stale.img";
+  {
+    std::ofstream ofs(source);
+    ofs << "(define b 2)";
+  }
+  REQUIRE(interp.saveImage(stale, 0));
+  REQUIRE(!interp.loadImage(stale, source));
+
+  INFO("a failed load leaves the environment untouched")
+  REQUIRE(evalIn(interp, "(a)") == Expression(1.));
+
+  std::remove(bogus.c_str());
+  std::remove(source.c_str());
+  std::remove(stale.c_str());
+}
+
+// the image of a call with no head nested depth deep
+std::string nestedImage(unsigned depth){
+  std::ostringstream oss;
+  ImageWriter out(oss);
+  for(unsigned i = 0; i < depth; ++i) {
+    out.u8(0); out.u8(0); out.u64(1);
+  }
+  out.u8(0); out.u8(0); out.u64(0); out.u64(0); out.u64(0);
+  for(unsigned i = 0; i < depth; ++i) {
+    out.u64(0); out.u64(0);
+  }
+  return oss.str();
+}
+
+TEST_CASE( "Test deeply nested images", "[image]" ) {
+
+  std::string image = nestedImage(10);
+  ImageReader shallow(image.data(), image.size());
+  Expression exp;
+  REQUIRE(exp.deserialize(shallow));
+  REQUIRE(shallow.atEnd());
+
+  INFO("nesting past the limit is rejected rather than exhausting the stack")
+  image = nestedImage(1000000);
+  ImageReader deep(image.data(), image.size());
+  REQUIRE(!exp.deserialize(deep));
+}
+
+TEST_CASE( "Test saving futures", "[image]" ) {
+
+  const std::string filename = "image_tests_future.img";
+  Interpreter interp;
+  evalIn(interp, "(define f (lambda (x) (+ x 1)))");
+  evalIn(interp, "(define quick (future (+ 1 2)))");
+  evalIn(interp, "(force quick)");
+
+  INFO("saving never waits for a future that is still running")
+  evalIn(interp, "(define slow (future (map f (range 0 100000000 1))))");
+  REQUIRE(!interp.saveImage(filename));
+  interp.interrupt();
+
+  INFO("a finished future is saved as its value")
+  evalIn(interp, "(define slow 0)");
+  REQUIRE(interp.saveImage(filename));
+  Interpreter restored;
+  REQUIRE(restored.loadImage(filename));
+  REQUIRE(evalIn(restored, "(+ quick 0)") == Expression(3.));
+
+  std::remove(filename.c_str());
+}
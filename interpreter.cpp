@@ -1,19 +1,36 @@
 #include "interpreter.hpp"
 
 // system includes
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <fstream>
 #include <stdexcept>
+#include <thread>
 
 // module includes
 #include "token.hpp"
 #include "parse.hpp"
 #include "expression.hpp"
 #include "environment.hpp"
+#include "image.hpp"
 #include "semantic_error.hpp"
+#include "spscQueue.hpp"
+#include "trace.hpp"
+
+// marks the byte order an image was written in
+const std::uint32_t IMAGE_BYTE_ORDER = 0x01020304;
 
 bool Interpreter::parseStream(std::istream & expression) noexcept{
 
-  TokenSequenceType tokens = tokenize(expression);
+  TokenSequenceType tokens;
+  {
+    TraceSpan span(Tokenize);
+    tokens = tokenize(expression);
+  }
 
+  TraceSpan span(Parse);
   ast = parse(tokens);
 
   return (ast != Expression());
@@ -21,10 +38,161 @@ bool Interpreter::parseStream(std::istream & expression) noexcept{
 				     
 
 Expression Interpreter::evaluate(){
+  return evaluate(queueRequest());
+}
 
+Expression Interpreter::evaluate(std::uint64_t request){
+  m_cancel.begin(request);
+  EvalContext context(m_cancel.token(), m_limits, &m_futures);
+  TraceSpan span(Evaluate);
   return ast.eval(env);
 }
 
+// a form handed from the parsing thread to the evaluating one
+struct ParsedForm {
+  bool end = false;
+  Expression exp;
+};
+
+// shared with the parsing thread, which may outlive evaluateStream
+struct StreamParser {
+  explicit StreamParser(std::size_t ahead): forms(ahead), stop(false) {}
+  spscQueue<ParsedForm> forms;
+  std::atomic_bool stop;
+};
+
+// how long a failed evaluateStream waits for its parser to stop before
+// leaving it blocked on input
+const std::chrono::milliseconds STREAM_STOP_GRACE(100);
+
+bool Interpreter::evaluateStream(std::shared_ptr<std::istream> stream, const std::function<void(const Expression &)> & result){
+  std::shared_ptr<StreamParser> state(new StreamParser(STREAM_AHEAD));
+  // the parser shares the stream, it may still be reading once this returns
+  std::thread parser([stream, state]() {
+    FormReader reader(*stream, &state->stop);
+    TokenSequenceType tokens;
+    while(!state->stop) {
+      {
+        TraceSpan span(Tokenize);
+        if(!reader.next(tokens)) break;
+      }
+      ParsedForm form;
+      {
+        TraceSpan span(Parse);
+        form.exp = parse(tokens);
+      }
+      if(state->stop) break;
+      bool failed = (form.exp == Expression());
+      state->forms.push(std::move(form));
+      // nothing after a malformed form can be trusted
+      if(failed) break;
+    }
+    ParsedForm end;
+    end.end = true;
+    // once stopped nobody may drain the queue, so never wait on it
+    if(state->stop) state->forms.try_push(std::move(end));
+    else state->forms.push(std::move(end));
+  });
+
+  bool ended = false;
+  // stop the parser and drain the queue so a blocked push can finish; a
+  // parser still waiting on input after the grace period is left to end
+  // on its own, it reads no further once it sees stop
+  auto finish = [&]() {
+    state->stop = true;
+    auto deadline = std::chrono::steady_clock::now() + STREAM_STOP_GRACE;
+    ParsedForm form;
+    while(!ended) {
+      if(state->forms.wait_for_pop(form, std::chrono::milliseconds(10))) {
+        ended = form.end;
+      } else if(std::chrono::steady_clock::now() >= deadline) {
+        parser.detach();
+        return;
+      }
+    }
+    parser.join();
+  };
+
+  m_cancel.begin(queueRequest());
+  bool parsed = true;
+  try {
+    while(true) {
+      ParsedForm form;
+      state->forms.wait_and_pop(form);
+      if(form.end) {
+        ended = true;
+        break;
+      }
+      if(form.exp == Expression()) {
+        parsed = false;
+        break;
+      }
+      Expression value;
+      {
+        EvalContext context(m_cancel.token(), m_limits, &m_futures);
+        TraceSpan span(Evaluate);
+        value = form.exp.eval(env);
+      }
+      result(value);
+    }
+  } catch(...) {
+    finish();
+    throw;
+  }
+  if(ended) parser.join();
+  else finish();
+  return parsed;
+}
+
+void Interpreter::interrupt(std::uint64_t through) noexcept {
+  m_cancel.interrupt(through);
+  m_futures.cancel();
+}
+
+void Interpreter::interrupt() noexcept {
+  m_cancel.interrupt();
+  m_futures.cancel();
+}
+
 void Interpreter::reset() {
+    m_futures.cancel();
     env.reset();
 }
+
+bool Interpreter::saveImage(const std::string & filename, std::uint64_t digest) noexcept {
+  try {
+    std::ofstream ofs(filename, std::ios::binary | std::ios::trunc);
+    if(!ofs) return false;
+    ImageWriter out(ofs);
+    ofs.write(IMAGE_MAGIC, sizeof(IMAGE_MAGIC));
+    out.u32(IMAGE_VERSION);
+    out.u32(IMAGE_BYTE_ORDER);
+    out.u64(digest);
+    env.serialize(out);
+    ofs.flush();
+    return out.good();
+  } catch(...) {
+    return false;
+  }
+}
+
+bool Interpreter::loadImage(const std::string & filename, const std::string & source) noexcept {
+  MappedFile file(filename);
+  if(!file.isOpen() || file.size() < sizeof(IMAGE_MAGIC)) return false;
+  if(std::memcmp(file.data(), IMAGE_MAGIC, sizeof(IMAGE_MAGIC)) != 0) return false;
+  ImageReader in(file.data() + sizeof(IMAGE_MAGIC), file.size() - sizeof(IMAGE_MAGIC));
+  std::uint32_t version, order;
+  std::uint64_t digest;
+  if(!in.u32(version) || version != IMAGE_VERSION) return false;
+  if(!in.u32(order) || order != IMAGE_BYTE_ORDER) return false;
+  if(!in.u64(digest)) return false;
+  if(!source.empty()) {
+    std::ifstream ifs(source, std::ios::binary);
+    if(!ifs || imageDigest(ifs) != digest) return false;
+  }
+  try {
+    return env.deserialize(in);
+  } catch(...) {
+    return false;
+  }
+}
@@ -8,12 +8,19 @@ It maintains an environment during evaluation.
 #define INTERPRETER_HPP
 
 // system includes
+#include <cstdint>
+#include <functional>
 #include <istream>
+#include <memory>
 #include <string>
 
 // module includes
+#include "cancellation.hpp"
+#include "eval_context.hpp"
 #include "environment.hpp"
 #include "expression.hpp"
+#include "future.hpp"
+#include "stats.hpp"
 
 /*! \class Interpreter
 \brief Class to parse and evaluate an expression (program)
@@ -25,6 +32,17 @@ The eval method updates Environment and returns last result.
 class Interpreter {
 public:
 
+  /// Construct an interpreter with the default environment
+  Interpreter() = default;
+
+  /*! Construct an interpreter starting from a copy of an environment.
+    \param start the environment, freeze it first to share its definitions
+   */
+  explicit Interpreter(const Environment & start): env(start) {}
+
+  /// the current environment
+  const Environment & environment() const noexcept {return env;}
+
   /*! Parse into an internal Expression from a stream
     \param expression the raw text stream repreenting the candidate expression
     \return true on successful parsing 
@@ -32,13 +50,97 @@ public:
   bool parseStream(std::istream &expression) noexcept;
 
   /*! Evaluate the Expression by walking the tree, returning the result.
+    The evaluation is a request of its own.
     \return the Expression resulting from the evaluation in the current environment
     \throws SemanticError when a semantic error is encountered
+    \throws InterruptError when interrupt() is called during the evaluation
+    \throws LimitError when the evaluation exceeds the limits
    */
   Expression evaluate();
-    
+
+  /*! Evaluate the Expression as the request numbered by queueRequest.
+    \param request the id of the request
+    \return the Expression resulting from the evaluation in the current environment
+    \throws InterruptError if the request was interrupted at any time since
+    it was numbered, or the errors of evaluate()
+   */
+  Expression evaluate(std::uint64_t request);
+
+  /*! Parse and evaluate a stream one top-level form at a time.
+
+    A separate thread reads and parses the next forms while the current one
+    is evaluated. At most STREAM_AHEAD parsed forms are held, so the whole
+    stream is never in memory. Each form is a separate evaluation with its
+    own limits. The stream must not be used by anyone else until this returns.
+    When a form fails while the parser is waiting for more input, such as on
+    a terminal or an open pipe, the error is thrown without waiting for that
+    input. The parser then ends once its pending read returns, holding its
+    share of the stream until then.
+    \param stream the program text, any number of forms
+    \param result called with the value of each form, in order
+    \return false if a form could not be parsed, the forms before it are evaluated
+    \throws SemanticError, InterruptError or LimitError as evaluate(), no
+    further forms are evaluated. The whole stream is one request.
+   */
+  bool evaluateStream(std::shared_ptr<std::istream> stream, const std::function<void(const Expression &)> & result);
+
+  /// the most forms parsed ahead of evaluateStream's evaluation
+  static const std::size_t STREAM_AHEAD = 16;
+
+  /*! Number a request before it is handed to the thread evaluating it,
+    so it can be interrupted while it is queued, tokenized or parsed.
+    Any thread may call it.
+    \return the id, larger than that of every earlier request
+   */
+  std::uint64_t queueRequest() noexcept {return m_cancel.queue();}
+
+  /*! Stop the requests numbered up to through: the one running on another
+    thread at its next safepoint, and the ones not started yet as soon as
+    they start. Every future started so far is cancelled, forcing it throws
+    an InterruptError.
+    \param through the id of the last request to stop
+   */
+  void interrupt(std::uint64_t through) noexcept;
+
+  /*! Stop the evaluation running on another thread at its next safepoint.
+    An interrupt with no evaluation running is dropped when the next one
+    starts, use interrupt(request) to stop requests not started yet.
+    Every future started so far is cancelled, forcing it throws an InterruptError.
+   */
+  void interrupt() noexcept;
+
+  /*! Set the budget of each following evaluation.
+    \param limits the limits, zero fields are unlimited
+   */
+  void setLimits(const EvalLimits & limits) noexcept {m_limits = limits;}
+
+  /// the budget of each evaluation
+  const EvalLimits & limits() const noexcept {return m_limits;}
+
+  /*! The counters of interpreter activity, summed over every interpreter
+    and thread of the process since it started. They may be read from any
+    thread while evaluations are running.
+   */
+  static StatsSnapshot stats() {return readStats();}
+
+  /// return to the default environment, cancelling every future started so far
   void reset();
 
+  /*! Write the current environment to an image file.
+    \param filename the image file to (over)write
+    \param digest digest of the source the environment was built from, or 0
+    \return true if the whole image was written
+   */
+  bool saveImage(const std::string & filename, std::uint64_t digest = 0) noexcept;
+
+  /*! Replace the current environment with one restored from an image file.
+    \param filename the image file to read
+    \param source if not empty, the image is only accepted when it was saved
+    with the digest of this source file's current contents
+    \return true on success, on failure the environment is unchanged
+   */
+  bool loadImage(const std::string & filename, const std::string & source = "") noexcept;
+
 private:
 
   // the environment
@@ -46,6 +148,15 @@ private:
 
   // the AST
   Expression ast;
+
+  // cancels the running evaluation
+  RequestCancellation m_cancel;
+
+  // budget of each evaluation
+  EvalLimits m_limits;
+
+  // the futures started by evaluations, cancelled first on destruction
+  FutureGroup m_futures;
 };
 
 #endif
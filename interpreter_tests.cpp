@@ -5,13 +5,20 @@
 #include <fstream>
 #include <iostream>
 #include <cmath>
+#include <vector>
+#include <chrono>
+#include <streambuf>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <unistd.h>
 
 #include "semantic_error.hpp"
 #include "interpreter.hpp"
 #include "expression.hpp"
 #include "startup_config.hpp"
 
-void error(const std::string & err_str){
+static void error(const std::string & err_str){
     std::cerr << "Error: " << err_str << std::endl;
 }
 Expression run(const std::string & program){
@@ -1312,3 +1319,108 @@ TEST_CASE("Milestone 3 test cases", "[Milestone 3]") {
         Expression result = run(program);
     }
 }
+
+TEST_CASE("Test evaluating a stream form by form", "[interpreter]") {
+  Interpreter interp;
+  std::vector<Expression> results;
+  auto collect = [&results](const Expression & exp) { results.push_back(exp); };
+
+  {
+    auto program = std::make_shared<std::stringstream>();
+    *program << "(define total 0)\n";
+    for(int i = 1; i <= 1000; ++i) {
+      *program << "(define total (+ total " << i << "))\n";
+    }
+    *program << "(+ total)";
+    REQUIRE(interp.evaluateStream(program, collect));
+    REQUIRE(results.size() == 1002);
+    REQUIRE(results.back() == Expression(500500.));
+  }
+
+  {
+    INFO("forms before a malformed one are evaluated")
+    results.clear();
+    auto program = std::make_shared<std::istringstream>("(define b 1) (+ b 1) ) (define b 5)");
+    REQUIRE(!interp.evaluateStream(program, collect));
+    REQUIRE(results.size() == 2);
+    REQUIRE(results[1] == Expression(2.));
+  }
+
+  {
+    INFO("an error stops the stream, even with the parser blocked ahead")
+    results.clear();
+    auto program = std::make_shared<std::stringstream>();
+    *program << "(define c 1) (undefined-proc c)";
+    for(int i = 0; i < 100; ++i) {
+      *program << "(define c " << i << ")";
+    }
+    REQUIRE_THROWS_AS(interp.evaluateStream(program, collect), SemanticError);
+    REQUIRE(results.size() == 1);
+    REQUIRE(run("(+ 1 1)") == Expression(2.));
+  }
+
+  auto empty = std::make_shared<std::istringstream>("  ; nothing\n");
+  results.clear();
+  REQUIRE(interp.evaluateStream(empty, collect));
+  REQUIRE(results.empty());
+}
+
+// reads a file descriptor, so a stream can wait on a pipe kept open
+class PipeBuffer: public std::streambuf {
+public:
+  explicit PipeBuffer(int fd, std::atomic_bool & destroyed): fd(fd), destroyed(destroyed) {}
+  ~PipeBuffer() {
+    ::close(fd);
+    destroyed = true;
+  }
+protected:
+  int_type underflow() override {
+    ssize_t count = ::read(fd, buffer, sizeof(buffer));
+    if(count <= 0) return traits_type::eof();
+    setg(buffer, buffer, buffer + count);
+    return traits_type::to_int_type(buffer[0]);
+  }
+private:
+  int fd;
+  std::atomic_bool & destroyed;
+  char buffer[256];
+};
+
+// a stream that owns its PipeBuffer
+class PipeStream: public std::istream {
+public:
+  PipeStream(int fd, std::atomic_bool & destroyed): std::istream(nullptr), buffer(fd, destroyed) {
+    rdbuf(&buffer);
+  }
+private:
+  PipeBuffer buffer;
+};
+
+TEST_CASE("Test an error in a stream is thrown without waiting for more input", "[interpreter]") {
+  int fds[2];
+  REQUIRE(::pipe(fds) == 0);
+  std::string forms = "(+ 1 2)\n(/ 1 0 0)\n";
+  REQUIRE(::write(fds[1], forms.data(), forms.size()) == static_cast<ssize_t>(forms.size()));
+
+  static std::atomic_bool destroyed(false);
+  {
+    // the parser is left reading the stream, it keeps it alive until then
+    std::shared_ptr<std::istream> stream = std::make_shared<PipeStream>(fds[0], destroyed);
+    Interpreter interp;
+    std::vector<Expression> results;
+    auto start = std::chrono::steady_clock::now();
+    REQUIRE_THROWS_AS(interp.evaluateStream(stream, [&results](const Expression & exp) { results.push_back(exp); }),
+                      SemanticError);
+    REQUIRE(std::chrono::steady_clock::now() - start < std::chrono::seconds(2));
+    REQUIRE(results.size() == 1);
+    REQUIRE(results[0] == Expression(3.));
+  }
+
+  INFO("the parser ends once its read returns, reads no further and drops the stream")
+  ::close(fds[1]);
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+  while(!destroyed && std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  REQUIRE(destroyed);
+}
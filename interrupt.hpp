@@ -1,3 +1,6 @@
+#ifndef INTERRUPT_HPP
+#define INTERRUPT_HPP
+
 #include <csignal>
 #include <cstdlib>
 
@@ -57,3 +60,5 @@ inline void install_handler() {
     sigaction(SIGINT, &sigIntHandler, NULL);
 }
 #endif
+
+#endif
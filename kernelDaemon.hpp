@@ -0,0 +1,331 @@
+#ifndef KERNELDAEMON_HPP
+#define KERNELDAEMON_HPP
+
+#include <string>
+#include <sstream>
+#include <iostream>
+#include <map>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <vector>
+#include <cstring>
+#include "interpreter.hpp"
+#include "semantic_error.hpp"
+#include "parseInterp.hpp"
+#include "workerPool.hpp"
+#include "interrupt.hpp"
+
+#if defined(__APPLE__) || defined(__linux) || defined(__unix) || defined(__posix)
+#include <csignal>
+#include <cerrno>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// A client connection with its own interpreter. Lines are evaluated in
+// the order they arrive, by one worker at a time.
+struct daemonSession {
+    daemonSession(int socket, const Environment & startup): fd(socket), interp(startup) {}
+    ~daemonSession() {
+        close(fd);
+    }
+    int fd;
+    Interpreter interp;
+    // bytes read after the last complete line, only used by the poll loop
+    std::string partial;
+    std::mutex the_mutex;
+    // false once the client stopped sending
+    bool open = true;
+    std::deque<std::string> lines;
+    // a worker is draining the lines
+    bool busy = false;
+    // replies the client has not read yet, flushed by the poll loop
+    std::string unsent;
+    // false once the client stopped reading, later replies are dropped
+    bool writable = true;
+};
+
+// Serves plotscript over a Unix domain socket.
+//
+// Each connection is a session: one program per line in, one line out with
+// the printed result or the error. Every session starts from the same
+// frozen startup environment, so the built-ins and startup definitions are
+// shared rather than rebuilt. The poll loop reads all sockets and hands
+// sessions with pending lines to a fixed pool of workers.
+class kernelDaemon {
+public:
+    kernelDaemon(const std::string & path, unsigned workers, const EvalLimits & limits):
+        socketPath(path), workerCount(workers), sessionLimits(limits) {}
+
+    // the longest line a client may send, longer ones drop its session
+    static const std::size_t MAX_LINE = 1 << 20;
+
+    // the most reply bytes held for a client that is not reading, more
+    // drops its session
+    static const std::size_t MAX_BACKLOG = 1 << 22;
+
+    int run() {
+        // a client hanging up mid reply must not kill the daemon
+        signal(SIGPIPE, SIG_IGN);
+        Interpreter interp;
+        loadStartup(&interp);
+        startup = interp.environment();
+        startup.freeze();
+
+        int listener = listenOn(socketPath);
+        if(listener < 0) return EXIT_FAILURE;
+        std::map<int, std::shared_ptr<daemonSession>> sessions;
+        {
+            workerPool pool(workerCount);
+            while(global_status_flag == 0) {
+                std::vector<pollfd> fds;
+                fds.push_back(pollfd{listener, POLLIN, 0});
+                for(auto &s : sessions) {
+                    std::lock_guard<std::mutex> lock(s.second->the_mutex);
+                    short events = s.second->open ? POLLIN : 0;
+                    if(!s.second->unsent.empty()) events |= POLLOUT;
+                    if(events) fds.push_back(pollfd{s.first, events, 0});
+                }
+                // the timeout bounds how late cntrl-c is noticed
+                if(poll(fds.data(), fds.size(), 100) < 0 && errno != EINTR) {
+                    error("poll failed: " + std::string(std::strerror(errno)));
+                    break;
+                }
+                for(auto &p : fds) {
+                    if(p.revents == 0) continue;
+                    if(p.fd == listener) {
+                        int client = accept(listener, nullptr, nullptr);
+                        if(client >= 0) {
+                            std::shared_ptr<daemonSession> session(new daemonSession(client, startup));
+                            session->interp.setLimits(sessionLimits);
+                            sessions[client] = session;
+                        }
+                    } else {
+                        std::shared_ptr<daemonSession> session = sessions[p.fd];
+                        if(p.revents & ~POLLOUT) readFrom(session, pool);
+                        if(p.revents & ~POLLIN) {
+                            std::lock_guard<std::mutex> lock(session->the_mutex);
+                            flush(*session);
+                        }
+                    }
+                }
+                prune(sessions);
+            }
+            // drop what is queued and stop what is running, the pool
+            // then joins its workers on the way out of this scope
+            stopping = true;
+            while(interruptBusy(sessions)) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+        }
+        close(listener);
+        unlink(socketPath.c_str());
+        return EXIT_SUCCESS;
+    }
+
+private:
+    int listenOn(const std::string & path) {
+        sockaddr_un address;
+        std::memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        if(path.size() >= sizeof(address.sun_path)) {
+            error("Socket path too long.");
+            return -1;
+        }
+        std::strcpy(address.sun_path, path.c_str());
+        int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+        if(listener < 0) {
+            error("Could not create socket.");
+            return -1;
+        }
+        // only a socket left behind by an earlier daemon is removed, never
+        // another kind of file, nor a socket a live daemon still answers on
+        struct stat info;
+        if(lstat(path.c_str(), &info) == 0) {
+            if(!S_ISSOCK(info.st_mode)) {
+                error(path + " exists and is not a socket.");
+                close(listener);
+                return -1;
+            }
+            int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+            bool live = probe >= 0 &&
+                connect(probe, reinterpret_cast<sockaddr *>(&address), sizeof(address)) == 0;
+            if(probe >= 0) close(probe);
+            if(live) {
+                error("A daemon is already listening on " + path + ".");
+                close(listener);
+                return -1;
+            }
+            unlink(path.c_str());
+        }
+        if(bind(listener, reinterpret_cast<sockaddr *>(&address), sizeof(address)) < 0 ||
+           listen(listener, SOMAXCONN) < 0) {
+            error("Could not listen on " + path + ": " + std::strerror(errno));
+            close(listener);
+            return -1;
+        }
+        return listener;
+    }
+
+    void readFrom(std::shared_ptr<daemonSession> session, workerPool & pool) {
+        char buffer[4096];
+        ssize_t count = read(session->fd, buffer, sizeof(buffer));
+        if(count < 0 && (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK)) return;
+        if(count <= 0) {
+            // the client is done sending, queued lines are still answered
+            std::lock_guard<std::mutex> lock(session->the_mutex);
+            session->open = false;
+            if(!session->busy && session->unsent.empty()) shutdown(session->fd, SHUT_WR);
+            return;
+        }
+        session->partial.append(buffer, count);
+        std::vector<std::string> complete;
+        std::size_t start = 0, end;
+        while((end = session->partial.find('\n', start)) != std::string::npos) {
+            std::string line = session->partial.substr(start, end - start);
+            if(!line.empty() && line.back() == '\r') line.pop_back();
+            if(!line.empty()) complete.push_back(line);
+            start = end + 1;
+        }
+        session->partial.erase(0, start);
+        std::lock_guard<std::mutex> lock(session->the_mutex);
+        if(session->partial.size() > MAX_LINE) {
+            // a client that never ends its line is dropped, with what it queued
+            session->partial.clear();
+            drop(*session);
+            return;
+        }
+        if(complete.empty()) return;
+        for(auto &line : complete) session->lines.push_back(line);
+        if(!session->busy) {
+            session->busy = true;
+            pool.submit([this, session]() { drain(session); });
+        }
+    }
+
+    // runs on a worker, answers lines until the session has none left
+    void drain(std::shared_ptr<daemonSession> session) {
+        while(true) {
+            std::string line;
+            {
+                std::lock_guard<std::mutex> lock(session->the_mutex);
+                if(stopping) session->lines.clear();
+                if(session->lines.empty()) {
+                    session->busy = false;
+                    // everything is answered, let the client see the end
+                    if(!session->open && session->unsent.empty()) shutdown(session->fd, SHUT_WR);
+                    return;
+                }
+                line = session->lines.front();
+                session->lines.pop_front();
+            }
+            std::string reply = evaluate(session->interp, line) + "\n";
+            // never wait on the client here, what it has not read yet is
+            // left for the poll loop so a client that stops reading only
+            // holds its own replies
+            std::lock_guard<std::mutex> lock(session->the_mutex);
+            // the client is gone, keep evaluating so definitions stay in order
+            if(!session->writable) continue;
+            session->unsent += reply;
+            flush(*session);
+            if(session->unsent.size() > MAX_BACKLOG) drop(*session);
+        }
+    }
+
+    // send what the client will take without waiting, the session is locked
+    void flush(daemonSession & session) {
+        while(!session.unsent.empty() && session.writable) {
+            ssize_t count = send(session.fd, session.unsent.data(), session.unsent.size(), MSG_DONTWAIT);
+            if(count < 0 && errno == EINTR) continue;
+            if(count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+            if(count <= 0) {
+                session.writable = false;
+                session.unsent.clear();
+                break;
+            }
+            session.unsent.erase(0, count);
+        }
+        if(!session.open && !session.busy) shutdown(session.fd, SHUT_WR);
+    }
+
+    // stop serving a client, the session is locked and is pruned once its
+    // worker has stopped
+    void drop(daemonSession & session) {
+        session.lines.clear();
+        session.unsent.clear();
+        session.open = false;
+        session.writable = false;
+        if(session.busy) session.interp.interrupt();
+        shutdown(session.fd, SHUT_RDWR);
+    }
+
+    static std::string evaluate(Interpreter & interp, const std::string & line) {
+        std::istringstream expression(line);
+        if(!interp.parseStream(expression)) {
+            return "Error: Invalid Expression. Could not parse.";
+        }
+        try {
+            std::ostringstream out;
+            out << interp.evaluate();
+            return out.str();
+        } catch(const SemanticError & ex) {
+            return ex.what();
+        }
+    }
+
+    // forget sessions that stopped sending and have been answered
+    void prune(std::map<int, std::shared_ptr<daemonSession>> & sessions) {
+        for(auto it = sessions.begin(); it != sessions.end();) {
+            bool done;
+            {
+                std::lock_guard<std::mutex> lock(it->second->the_mutex);
+                done = !it->second->open && !it->second->busy && it->second->unsent.empty();
+            }
+            if(done) {
+                it = sessions.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    // interrupt every running evaluation, true while any is still running
+    bool interruptBusy(std::map<int, std::shared_ptr<daemonSession>> & sessions) {
+        bool any = false;
+        for(auto &s : sessions) {
+            std::lock_guard<std::mutex> lock(s.second->the_mutex);
+            if(s.second->busy) {
+                any = true;
+                s.second->interp.interrupt();
+            }
+        }
+        return any;
+    }
+
+    std::string socketPath;
+    unsigned workerCount;
+    EvalLimits sessionLimits;
+    Environment startup;
+    std::atomic_bool stopping{false};
+};
+
+#else
+
+class kernelDaemon {
+public:
+    kernelDaemon(const std::string &, unsigned, const EvalLimits &) {}
+    int run() {
+        error("The daemon needs Unix domain sockets.");
+        return EXIT_FAILURE;
+    }
+};
+
+#endif
+
+#endif
@@ -0,0 +1,33 @@
+#include "lazy_range.hpp"
+
+#include <vector>
+
+#include "eval_context.hpp"
+#include "expression.hpp"
+
+LazyRange::LazyRange(double start, double step, std::size_t size):
+  m_start(start), m_step(step), m_size(size), m_built(std::make_shared<Built>()) {}
+
+std::size_t LazyRange::count(double begin, double end, double step) {
+  // accumulate rather than divide so the last element is the one the
+  // elements themselves reach
+  std::size_t size = 0;
+  for(double i = begin; i <= end; i = i + step) {
+    if((size & 0xfff) == 0) safepoint();
+    ++size;
+  }
+  return size;
+}
+
+const PersistentList<Expression> & LazyRange::elements() const {
+  // a throw leaves the flag unset, so a later call tries again
+  Built & built = *m_built;
+  std::call_once(built.flag, [this, &built]() {
+    chargeList(m_size);
+    std::vector<Expression> items;
+    items.reserve(m_size);
+    forEach([&items](double x) { items.emplace_back(Atom(x)); });
+    built.elements = PersistentList<Expression>(std::move(items));
+  });
+  return built.elements;
+}
@@ -0,0 +1,79 @@
+/*! \file lazy_range.hpp
+Defines the LazyRange type, the unmaterialized result of range.
+ */
+#ifndef LAZY_RANGE_HPP
+#define LAZY_RANGE_HPP
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+
+#include "persistent_list.hpp"
+
+class Expression;
+
+/*! \class LazyRange
+\brief An arithmetic sequence whose elements are made when they are needed.
+
+range returns a LazyRange instead of a list of numbers. length, first and
+rest only look at the start, step and size, and map and apply generate the
+numbers one at a time, so (map f (range 0 1e7 1)) never holds the range.
+Anything else that needs the elements as a list gets them from elements(),
+which builds them once.
+
+Element i + 1 is element i plus the step, the same floating point
+accumulation that range always used, so a lazy range holds exactly the
+numbers of the list it stands for.
+ */
+class LazyRange {
+public:
+
+  /// Construct the sequence of size numbers from start in increments of step
+  LazyRange(double start, double step, std::size_t size);
+
+  /*! The number of elements of the range from begin to at most end.
+    \param begin the first element
+    \param end the bound of the last element
+    \param step the positive increment
+   */
+  static std::size_t count(double begin, double end, double step);
+
+  /// the first element
+  double start() const noexcept {return m_start;}
+
+  /// the increment between elements
+  double step() const noexcept {return m_step;}
+
+  /// the number of elements
+  std::size_t size() const noexcept {return m_size;}
+
+  /// the range without its first element, which it must have
+  LazyRange rest() const {return LazyRange(m_start + m_step, m_step, m_size - 1);}
+
+  /// call visit with each element, in order
+  template<typename Visitor>
+  void forEach(Visitor visit) const {
+    double x = m_start;
+    for(std::size_t i = 0; i < m_size; ++i) {
+      visit(x);
+      x = x + m_step;
+    }
+  }
+
+  /// the elements as a list, built on first use and charged to the evaluation
+  const PersistentList<Expression> & elements() const;
+
+private:
+  double m_start;
+  double m_step;
+  std::size_t m_size;
+
+  // the elements once built, shared by copies of the range
+  struct Built {
+    std::once_flag flag;
+    PersistentList<Expression> elements;
+  };
+  std::shared_ptr<Built> m_built;
+};
+
+#endif
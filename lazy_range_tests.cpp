@@ -0,0 +1,70 @@
+#include "catch.hpp"
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "lazy_range.hpp"
+#include "eval_context.hpp"
+#include "expression.hpp"
+#include "interpreter.hpp"
+#include "semantic_error.hpp"
+
+Expression evalRange(Interpreter & interp, const std::string & program){
+  std::istringstream iss(program);
+  REQUIRE(interp.parseStream(iss));
+  return interp.evaluate();
+}
+
+TEST_CASE( "Test lazy range elements", "[lazy_range]" ) {
+
+  INFO("the elements are the accumulated sums range always produced")
+  std::vector<double> expected;
+  for(double i = 0; i <= 1; i = i + 0.1) expected.push_back(i);
+  LazyRange range(0, 0.1, LazyRange::count(0, 1, 0.1));
+  REQUIRE(range.size() == expected.size());
+
+  std::vector<double> visited;
+  range.forEach([&visited](double x) { visited.push_back(x); });
+  REQUIRE(visited == expected);
+
+  const PersistentList<Expression> & elements = range.elements();
+  REQUIRE(&range.elements() == &elements);
+  REQUIRE(elements.size() == expected.size());
+  for(std::size_t i = 0; i < expected.size(); ++i) {
+    REQUIRE(elements[i] == Expression(expected[i]));
+  }
+
+  LazyRange rest = range.rest();
+  REQUIRE(rest.size() == expected.size() - 1);
+  REQUIRE(rest.start() == expected[1]);
+  visited.clear();
+  rest.forEach([&visited](double x) { visited.push_back(x); });
+  REQUIRE(visited == std::vector<double>(expected.begin() + 1, expected.end()));
+}
+
+TEST_CASE( "Test list procedures on lazy ranges", "[lazy_range]" ) {
+
+  Interpreter interp;
+  evalRange(interp, "(define r (range 1 10 1))");
+
+  REQUIRE(evalRange(interp, "(length r)") == Expression(10.));
+  REQUIRE(evalRange(interp, "(first (rest (rest r)))") == Expression(3.));
+  REQUIRE(evalRange(interp, "(apply + r)") == Expression(55.));
+  REQUIRE(evalRange(interp, "(length (join r (rest r)))") == Expression(19.));
+
+  std::ostringstream lazy, built;
+  lazy << evalRange(interp, "(map sqrt (range 0 4 1))");
+  built << evalRange(interp, "(map sqrt (list 0 1 2 3 4))");
+  REQUIRE(lazy.str() == built.str());
+  std::ostringstream printed;
+  printed << evalRange(interp, "(rest (range 1 3 1))");
+  REQUIRE(printed.str() == "((2) (3))");
+
+  INFO("map over a range stores only its results")
+  EvalLimits limits;
+  limits.bytes = 100010 * EvalContext::ELEMENT_BYTES;
+  interp.setLimits(limits);
+  REQUIRE(evalRange(interp, "(length (map sqrt (range 1 100000 1)))") == Expression(100000.));
+  REQUIRE_THROWS_AS(evalRange(interp, "(length (join (range 1 100000 1) (range 1 100000 1)))"), LimitError);
+}
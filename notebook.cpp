@@ -1,11 +1,43 @@
 #include <QApplication>
+#include <QCommandLineParser>
 #include <QWidget>
+#include <iostream>
 #include "notebook_app.hpp"
+#include "trace.hpp"
 
 int main(int argc, char *argv[]) {
   QApplication app(argc, argv);
+  // per-cell budgets, the same options as the plotscript command line
+  QCommandLineParser parser;
+  parser.addHelpOption();
+  QCommandLineOption time("time-limit", "Wall clock seconds per cell.", "seconds");
+  QCommandLineOption steps("step-limit", "Evaluation steps per cell.", "steps");
+  QCommandLineOption memory("memory-limit", "List bytes per cell, with an optional K, M or G suffix.", "bytes");
+  QCommandLineOption parallel("parallel", "Threads evaluating independent arguments of a cell.", "threads");
+  QCommandLineOption trace("trace", "Write a trace of the pipeline stages to a file.", "file");
+  parser.addOption(time);
+  parser.addOption(steps);
+  parser.addOption(memory);
+  parser.addOption(parallel);
+  parser.addOption(trace);
+  parser.process(app);
+  EvalLimits limits;
+  for(auto option : {time, steps, memory, parallel}) {
+    if(!parser.isSet(option)) continue;
+    std::string name = "--" + option.names().first().toStdString();
+    if(!parseLimit(name, parser.value(option).toStdString(), limits)) {
+      qCritical("Invalid value for --%s", qPrintable(option.names().first()));
+      return EXIT_FAILURE;
+    }
+  }
+  if(parser.isSet(trace)) startTracing();
   NotebookApp notebook;
+  notebook.setLimits(limits);
   notebook.show();
-  return app.exec();
+  int status = app.exec();
+  if(parser.isSet(trace)) {
+    if(!saveTrace(parser.value(trace).toStdString())) qCritical("Could not write trace");
+    writeHistograms(std::cerr);
+  }
+  return status;
 }
-
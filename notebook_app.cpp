@@ -10,10 +10,11 @@
 #include "startup_config.hpp"
 
 NotebookApp::NotebookApp() {
+    traceThreadName("gui");
     loadStartup();
-    //initalize all the variables
-    solved.store(false);
-    pI.startThread(&mQ, &pQ, &rQ, &solved, &interp);
+    //completions come from the kernel thread and are handled on this one
+    connect(this, &NotebookApp::requestCompleted, this, &NotebookApp::handleCompleted, Qt::QueuedConnection);
+    startKernel();
     QVBoxLayout * layout = new QVBoxLayout;
     input = new InputWidget;
     input->setObjectName("input");
@@ -21,7 +22,9 @@ NotebookApp::NotebookApp() {
     output = new OutputWidget;
     output->setObjectName("output");
      connect(this, &NotebookApp::plotscriptResult, output, &OutputWidget::recievePlotscript);
+     connect(this, &NotebookApp::plotscriptScene, output, &OutputWidget::recieveScene);
      connect(this, &NotebookApp::plotscriptError, output, &OutputWidget::recieveError);
+     connect(this, &NotebookApp::plotscriptText, output, &OutputWidget::recieveText);
     controlpanel = new cPanel;
      connect(controlpanel->start, SIGNAL(clicked()), this, SLOT(handleStart()));
      connect(controlpanel->stop, SIGNAL(clicked()), this, SLOT(handleStop()));
@@ -33,41 +36,62 @@ NotebookApp::NotebookApp() {
     setLayout(layout);
 }
 
+void NotebookApp::startKernel() {
+    pI.startThread(&pQ, &interp, [this](std::uint64_t id) { emit requestCompleted(id); });
+}
+
+void NotebookApp::stopKernel() {
+    //stop the pending requests first, the kernel only sees the stop request
+    //once they are done
+    interp.interrupt(m_lastRequest);
+    pI.stopThread(&pQ);
+}
+
+void NotebookApp::setLimits(const EvalLimits & limits) {
+    //the kernel thread reads the limits, so change them while it is stopped
+    bool running = pI.size() > 0;
+    stopKernel();
+    interp.setLimits(limits);
+    if(running) startKernel();
+}
+
 void NotebookApp::handleStart() {
     kernalRunning = true;
     if(pI.size() == 0) {
-        pI.startThread(&mQ, &pQ, &rQ, &solved, &interp);
+        startKernel();
     }
 }
 
 void NotebookApp::handleStop() {
     kernalRunning = false;
-    if(pI.size() > 0) {
-        pQ.push(QString("%%%%%"));
-        pI.joinAll();
-    }
+    stopKernel();
 }
 
 void NotebookApp::handleReset() {
-    if(pI.size() > 0) {
-        pQ.push(QString("%%%%%"));
-        pI.joinAll();
-    }
+    stopKernel();
+    //results of requests from before the reset are never shown
+    m_pending.clear();
+    m_lastShown = m_lastRequest;
     interp.reset();
     output->scene->clear();
     input->clear();
-    pI.startThread(&mQ, &pQ, &rQ, &solved, &interp);
     loadStartup();
+    startKernel();
 }
 
 void NotebookApp::handleinterrupt() {
     if(kernalRunning) {
-        handleReset();
-        emit plotscriptError("Error: interpreter kernel interrupted");
+        //the running request, and those queued behind it, complete with the interrupt error
+        interp.interrupt(m_lastRequest);
+        if(m_pending.empty()) {
+            emit plotscriptError("Error: interpreter kernel interrupted");
+        }
     }
 }
 
 void NotebookApp::loadStartup() {
+    // the build-time image is only used while it matches the startup file
+    if(interp.loadImage(STARTUP_IMAGE, STARTUP_FILE)) return;
     std::ifstream startup(STARTUP_FILE);
     if(!interp.parseStream(startup)) {
         emit plotscriptError("Error: Could not parse.");
@@ -89,39 +113,54 @@ void NotebookApp::setData(QString data) {
 }
 
 void NotebookApp::repl(QString data) {
-    QString temp = data;
+    if(data == "%stats") {
+        //the counters are read while the kernel runs
+        std::ostringstream stats;
+        stats << Interpreter::stats() << "parse queue         " << pQ.size();
+        emit plotscriptText(stats.str());
+        input->setEnabled(true);
+        return;
+    }
     if(kernalRunning) {
-        pQ.push(data);
-        Expression exp;
-        std::this_thread::sleep_for(std::chrono::milliseconds(50));
-        if(solved) {
-            rQ.try_pop(exp);
-            emit plotscriptResult(exp);
-        } else {
-            std::string error;
-            mQ.try_pop(error);
-            emit plotscriptError(error);
-        }
+        std::uint64_t id = m_lastRequest = interp.queueRequest();
+        auto done = std::make_shared<std::promise<guiResult>>();
+        std::future<guiResult> result = done->get_future();
+        pQ.push(guiRequest{id, data, done, TraceClock::now()});
+        //never wait here, the result is shown once the kernel reports it done
+        m_pending.emplace(id, std::move(result));
     } else {
         emit plotscriptError("Error: interpreter kernel not running");
     }
     input->setEnabled(true);
 }
 
+void NotebookApp::handleCompleted(quint64 id) {
+    auto found = m_pending.find(id);
+    if(found == m_pending.end()) return;
+    guiResult result = found->second.get();
+    m_pending.erase(found);
+    deliver(id, result);
+}
+
+void NotebookApp::deliver(std::uint64_t id, guiResult result) {
+    traceSpan(ResultHandoff, result.finished, TraceClock::now(), id);
+    //a later request already on screen wins over an older one
+    if(id < m_lastShown) return;
+    m_lastShown = id;
+    if(result.scene) {
+        emit plotscriptScene(result.scene);
+    } else {
+        emit plotscriptError(result.error);
+    }
+}
 
 void NotebookApp::closeEvent(QCloseEvent *event) {
     QCloseEvent *temp = event;
     if(temp == event) {
-        if(pI.size() > 0) {
-            pQ.push(QString("%%%%%"));
-            pI.joinAll();
-        }
+        stopKernel();
     }
 }
 
 NotebookApp::~NotebookApp() {
-    if(pI.size() > 0) {
-        pQ.push(QString("%%%%%"));
-        pI.joinAll();
-    }
+    stopKernel();
 }
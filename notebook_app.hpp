@@ -3,6 +3,9 @@
 
 #include <QWidget>
 #include <atomic>
+#include <map>
+#include <future>
+#include <cstdint>
 #include "input_widget.hpp"
 #include "output_widget.hpp"
 #include "cpanel.hpp"
@@ -18,6 +21,9 @@ public:
     NotebookApp();
     ~NotebookApp();
     void repl(QString data);
+    void setLimits(const EvalLimits & limits);
+    // true while a result has not been shown, they arrive through the event loop
+    bool pending() const {return !m_pending.empty();}
 private:
     QString m_parseData;
     void loadStartup();
@@ -27,10 +33,13 @@ private:
     bool kernalRunning = true;
     Interpreter interp;
     parseQueue pQ;
-    resultQueue rQ;
-    messageQueue mQ;
     guiParseInterp pI;
-    std::atomic_bool solved;
+    std::uint64_t m_lastRequest = 0;
+    std::uint64_t m_lastShown = 0;
+    std::map<std::uint64_t, std::future<guiResult>> m_pending;
+    void startKernel();
+    void stopKernel();
+    void deliver(std::uint64_t id, guiResult result);
     void closeEvent(QCloseEvent *event);
 public slots:
     void setData(QString data);
@@ -38,8 +47,12 @@ public slots:
     void handleStop();
     void handleReset();
     void handleinterrupt();
+    void handleCompleted(quint64 id);
 signals:
+    void requestCompleted(quint64 id);
     void plotscriptResult(Expression result);
+    void plotscriptScene(std::shared_ptr<SceneData> scene);
     void plotscriptError(std::string error);
+    void plotscriptText(std::string text);
 };
 #endif
@@ -2,6 +2,7 @@
 #include <QGraphicsTextItem>
 #include <QGraphicsEllipseItem>
 #include <QGraphicsLineItem>
+#include <QElapsedTimer>
 #include "notebook_app.hpp"
 #include "input_widget.hpp"
 #include "output_widget.hpp"
@@ -23,12 +24,20 @@ private slots:
     void testDiscretePlotLayout();
     void testContinuousPlotLayout();
     void testSineSplitting();
+    void testLargePlotBatched();
     void testResetKernel();
+    void testResetRunaway();
+    void testStatsQuery();
 private:
     NotebookApp notebook;
     
 };
 
+// results are delivered through the event loop, run it until they are shown
+void waitForResults(NotebookApp & app) {
+    QTRY_VERIFY_WITH_TIMEOUT(!app.pending(), 10000);
+}
+
 void NotebookTest::verifyWidgets() {
     auto in = notebook.findChild<InputWidget *>("input");
     auto out = notebook.findChild<OutputWidget *>("output");
@@ -47,6 +56,7 @@ void NotebookTest::testSendingInput() {
     auto in = notebook.findChild<InputWidget *>("input");
     QTest::keyClicks(in, "(define a 3)");
     QTest::keyPress(in, Qt::Key_Return, Qt::KeyboardModifier::ShiftModifier, 0);
+    waitForResults(notebook);
     auto out = notebook.findChild<OutputWidget *>("output");
     auto find = out->scene->items();
     QVERIFY2(find.size() == 1, "Point not found");
@@ -61,6 +71,7 @@ void NotebookTest::testPointInput() {
     auto out = notebook.findChild<OutputWidget *>("output");
     QTest::keyClicks(in, "(make-point 0 0)");
     QTest::keyPress(in, Qt::Key_Return, Qt::KeyboardModifier::ShiftModifier, 0);
+    waitForResults(notebook);
     auto find = out->scene->items();
     QVERIFY2(find.size() == 1, "Point exists");
     QVERIFY2(find[0]->boundingRect().center() == QPointF(0,0), "Point not in right scene location");
@@ -71,6 +82,7 @@ void NotebookTest::testTextInput() {
     auto out = notebook.findChild<OutputWidget *>("output");
     QTest::keyClicks(in, "(make-text \"test\")");
     QTest::keyPress(in, Qt::Key_Return, Qt::KeyboardModifier::ShiftModifier, 0);
+    waitForResults(notebook);
     auto find = out->scene->items();
     QVERIFY2(find.size() == 1, "Text not found");
     QGraphicsTextItem *test = dynamic_cast<QGraphicsTextItem*>(find[0]);
@@ -84,6 +96,7 @@ void NotebookTest::testPointInput2() {
     auto out = notebook.findChild<OutputWidget *>("output");
     QTest::keyClicks(in, "(set-property \"size\" 20 (make-point 20 20))");
     QTest::keyPress(in, Qt::Key_Return, Qt::KeyboardModifier::ShiftModifier, 0);
+    waitForResults(notebook);
     auto find = out->view->items();
     QVERIFY2(find.size() == 1, "Point doesnt exist");
     QVERIFY2(find[0]->boundingRect().center() == QPointF(20,20), "Point centered at wrong location");
@@ -97,6 +110,7 @@ void NotebookTest::testLineInput() {
     auto out = notebook.findChild<OutputWidget *>("output");
     QTest::keyClicks(in, "(make-line (make-point 0 0) (make-point 20 0))");
     QTest::keyPress(in, Qt::Key_Return, Qt::KeyboardModifier::ShiftModifier, 0);
+    waitForResults(notebook);
     auto find = out->scene->items();
     QVERIFY2(find.size() == 1, "Line not found");
     //QGraphicsLineItem *line = dynamic_cast<QGraphicsLineItem*>(find[0]);
@@ -111,6 +125,7 @@ void NotebookTest::testFindPoints() {
     auto out = notebook.findChild<OutputWidget *>("output");
     QTest::keyClicks(in, "(list (set-property \"size\" 1 (make-point 0 0)) (set-property \"size\" 2 (make-point 0 4)) (set-property \"size\" 4 (make-point 0 8)) (set-property \"size\" 8 (make-point 0 16)) (set-property \"size\" 16 (make-point 0 32)) (set-property \"size\" 32 (make-point 0 64)))");
     QTest::keyPress(in, Qt::Key_Return, Qt::KeyboardModifier::ShiftModifier, 0);
+    waitForResults(notebook);
     auto find = out->scene->items();
     QVERIFY2(find.size() == 6, "Points do not exist");
     QVERIFY2(find[5]->boundingRect().center() == QPointF(0,0), "Point not in right scene location");
@@ -135,6 +150,7 @@ void NotebookTest::testCenterText() {
     auto out = notebook.findChild<OutputWidget *>("output");
     QTest::keyClicks(in, "(make-text \"Hello World\")");
     QTest::keyPress(in, Qt::Key_Return, Qt::KeyboardModifier::ShiftModifier, 0);
+    waitForResults(notebook);
     auto find = out->scene->items();
     QVERIFY2(find.size() == 1, "text not found");
     QVERIFY2(find[0]->sceneBoundingRect().center() == QPointF(), "Center of text in wrong location");
@@ -228,6 +244,7 @@ void NotebookTest::testDiscretePlotLayout() {
     )";
     inputWidget->setPlainText(QString::fromStdString(program));
     QTest::keyClick(inputWidget, Qt::Key_Return, Qt::ShiftModifier);
+    waitForResults(notebook);
     auto view = outputWidget->findChild<QGraphicsView *>();
     QVERIFY2(view, "Could not find QGraphicsView as child of OutputWidget");
     auto scene = view->scene();
@@ -290,7 +307,7 @@ void NotebookTest::testContinuousPlotLayout() {
     auto outputWidget = notebook.findChild<OutputWidget *>("output");
     inputWidget->setPlainText(QString::fromStdString(program));
     QTest::keyClick(inputWidget, Qt::Key_Return, Qt::ShiftModifier);
-    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    waitForResults(notebook);
     auto view = outputWidget->findChild<QGraphicsView *>();
     QVERIFY2(view, "Could not find QGraphicsView as child of OutputWidget");
     auto scene = view->scene();
@@ -311,7 +328,7 @@ void NotebookTest::testSineSplitting() {
     auto outputWidget = notebook.findChild<OutputWidget *>("output");
     inputWidget->setPlainText(QString::fromStdString(program));
     QTest::keyClick(inputWidget, Qt::Key_Return, Qt::ShiftModifier);
-    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    waitForResults(notebook);
     auto view = outputWidget->findChild<QGraphicsView *>();
     QVERIFY2(view, "Could not find QGraphicsView as child of OutputWidget");
     auto scene = view->scene();
@@ -321,6 +338,27 @@ void NotebookTest::testSineSplitting() {
     QCOMPARE(items.size(), 76);
 }
 
+void NotebookTest::testLargePlotBatched() {
+    std::string program = R"(
+    (begin
+     (define f (lambda (x) (list x (sin x))))
+     (discrete-plot (map f (range 0 600 1))))
+    )";
+    NotebookApp notebook;
+    auto inputWidget = notebook.findChild<InputWidget *>("input");
+    auto outputWidget = notebook.findChild<OutputWidget *>("output");
+    inputWidget->setPlainText(QString::fromStdString(program));
+    QTest::keyClick(inputWidget, Qt::Key_Return, Qt::ShiftModifier);
+    waitForResults(notebook);
+    auto view = outputWidget->findChild<QGraphicsView *>();
+    QVERIFY2(view, "Could not find QGraphicsView as child of OutputWidget");
+    auto scene = view->scene();
+    // 601 points and their stems are drawn by one batched item
+    auto items = scene->items();
+    QCOMPARE(items.size(), 1);
+    QVERIFY(!scene->itemsBoundingRect().isEmpty());
+}
+
 void NotebookTest::testResetKernel() {
     NotebookApp notebook;
     auto inputWidget = notebook.findChild<InputWidget *>("input");
@@ -335,7 +373,7 @@ void NotebookTest::testResetKernel() {
     )";
     inputWidget->setPlainText(QString::fromStdString(program));
     QTest::keyClick(inputWidget, Qt::Key_Return, Qt::ShiftModifier);
-    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    waitForResults(notebook);
     auto view = outputWidget->findChild<QGraphicsView *>();
     QVERIFY2(view, "Could not find QGraphicsView as child of OutputWidget");
     auto scene = view->scene();
@@ -347,5 +385,37 @@ void NotebookTest::testResetKernel() {
     
 }
 
+void NotebookTest::testResetRunaway() {
+    NotebookApp notebook;
+    auto inputWidget = notebook.findChild<InputWidget *>("input");
+    auto reset = notebook.findChild<cPanel *>()->findChild<QPushButton *>("reset");
+    QVERIFY2(reset, "Could not find reset button");
+    inputWidget->setPlainText("(begin (define f (lambda (x) (+ x 1))) (map f (range 0 100000000 1)))");
+    QTest::keyClick(inputWidget, Qt::Key_Return, Qt::ShiftModifier);
+    QVERIFY(notebook.pending());
+    // the running cell is interrupted, so the reset returns at once
+    QElapsedTimer timer;
+    timer.start();
+    QTest::mouseClick(reset, Qt::LeftButton);
+    QVERIFY(timer.elapsed() < 5000);
+    QVERIFY(!notebook.pending());
+}
+
+void NotebookTest::testStatsQuery() {
+    auto in = notebook.findChild<InputWidget *>("input");
+    auto out = notebook.findChild<OutputWidget *>("output");
+    in->setPlainText("%stats");
+    QTest::keyClick(in, Qt::Key_Return, Qt::ShiftModifier);
+    // the counters are shown as plain text in columns, not as an error
+    auto items = out->scene->items();
+    QCOMPARE(items.size(), 1);
+    auto text = dynamic_cast<QGraphicsTextItem *>(items[0]);
+    QVERIFY2(text, "Stats not shown as text");
+    QVERIFY(text->toPlainText().contains("expression copies"));
+    QCOMPARE(text->font().styleHint(), QFont::TypeWriter);
+    in->clear();
+    out->scene->clear();
+}
+
 QTEST_MAIN(NotebookTest)
 #include "notebook_test.moc"
@@ -0,0 +1,195 @@
+#include "numeric_lambda.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <map>
+#include <string>
+#include <tuple>
+
+#include "environment.hpp"
+#include "expression.hpp"
+
+const std::size_t NumericLambda::BLOCK;
+
+// lowers the body of a lambda, merging identical nodes
+struct NumericLambda::Builder {
+  NumericLambda & lambda;
+  const Environment & env;
+  std::map<std::string, std::size_t> params;
+  std::map<std::tuple<int, std::size_t, std::size_t, std::uint64_t>, std::size_t> known;
+
+  std::size_t node(Op op, std::size_t a, std::size_t b = 0, double value = 0) {
+    std::uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    auto key = std::make_tuple(int(op), a, b, bits);
+    auto found = known.find(key);
+    if(found != known.end()) return found->second;
+    lambda.m_nodes.push_back(Node{op, a, b, value});
+    known.emplace(key, lambda.m_nodes.size() - 1);
+    return lambda.m_nodes.size() - 1;
+  }
+
+  std::size_t constant(double value) {return node(Constant, 0, 0, value);}
+
+  // the node computing exp, false if exp is not numeric
+  bool lower(const Expression & exp, std::size_t & result) {
+    // the tree walker counts a step per expression evaluated
+    ++lambda.m_steps;
+    const Atom & head = exp.head();
+    if(exp.tailConstBegin() == exp.tailConstEnd()) {
+      if(head.isNumber()) {
+        result = constant(head.asNumber());
+        return true;
+      }
+      if(!head.isSymbol()) return false;
+      auto param = params.find(head.asSymbol());
+      if(param != params.end()) {
+        result = node(Param, param->second);
+        return true;
+      }
+      if(!env.is_exp(head)) return false;
+      Expression value = env.get_exp(head);
+      if(!value.isHeadNumber() || value.propSize() != 0) return false;
+      result = constant(value.head().asNumber());
+      return true;
+    }
+    if(!head.isSymbol() || !env.is_proc(head)) return false;
+    std::vector<std::size_t> args;
+    for(auto e = exp.tailConstBegin(); e != exp.tailConstEnd(); ++e) {
+      std::size_t arg;
+      if(!lower(*e, arg)) return false;
+      args.push_back(arg);
+    }
+    const std::string & name = head.asSymbol();
+    if(name == "+") {
+      // the built-in adds to zero, which matters for the sign of a zero
+      result = constant(0);
+      for(auto a : args) result = node(Add, result, a);
+      return true;
+    }
+    if(name == "*") {
+      result = args.empty() ? constant(1) : args[0];
+      for(std::size_t i = 1; i < args.size(); ++i) result = node(Mul, result, args[i]);
+      return true;
+    }
+    static const std::map<std::string, Op> unary = {
+      {"-", Neg}, {"sqrt", Sqrt}, {"ln", Ln}, {"sin", Sin}, {"cos", Cos}, {"tan", Tan}};
+    static const std::map<std::string, Op> binary = {{"-", Sub}, {"/", Div}, {"^", Pow}};
+    if(args.size() == 1 && name == "/") {
+      result = node(Div, constant(1), args[0]);
+      return true;
+    }
+    if(args.size() == 1 && unary.count(name)) {
+      result = node(unary.at(name), args[0]);
+      return true;
+    }
+    if(args.size() == 2 && binary.count(name)) {
+      result = node(binary.at(name), args[0], args[1]);
+      return true;
+    }
+    return false;
+  }
+};
+
+std::shared_ptr<const NumericLambda> NumericLambda::compile(const Expression & lambda, const Environment & env) {
+  if(!lambda.isHeadLambda() || lambda.propSize() != 0 || lambda.tailConstBegin() == lambda.tailConstEnd())
+    return nullptr;
+  std::shared_ptr<NumericLambda> compiled(new NumericLambda);
+  Builder builder{*compiled, env, {}, {}};
+  for(auto & param : lambda.list()) {
+    // a parameter named like a procedure does not shadow it
+    if(!param.head().isSymbol() || env.is_proc(param.head())) return nullptr;
+    // a repeated name is bound to the last argument, as in the tree walker
+    builder.params[param.head().asSymbol()] = compiled->m_arity++;
+  }
+  if(!builder.lower(*lambda.tailConstBegin(), compiled->m_result)) return nullptr;
+  return compiled;
+}
+
+namespace {
+
+template<typename F>
+void unaryKernel(const double * a, double * out, std::size_t size, F f) {
+  for(std::size_t i = 0; i < size; ++i) out[i] = f(a[i]);
+}
+
+template<typename F>
+void binaryKernel(const double * a, const double * b, double * out, std::size_t size, F f) {
+  for(std::size_t i = 0; i < size; ++i) out[i] = f(a[i], b[i]);
+}
+
+// sqrt and ln of a negative number (or NaN) are not real
+bool nonNegative(const double * a, std::size_t size) {
+  bool all = true;
+  for(std::size_t i = 0; i < size; ++i) all = all & (a[i] >= 0);
+  return all;
+}
+
+}
+
+bool NumericLambda::evaluate(const double * const * inputs, std::size_t count, double * results) const {
+  std::size_t width = std::min(BLOCK, count);
+  std::vector<double> scratch(m_nodes.size() * width);
+  // the array of each node's values for the current block
+  std::vector<const double *> values(m_nodes.size());
+  for(std::size_t n = 0; n < m_nodes.size(); ++n) {
+    if(m_nodes[n].op == Constant) std::fill_n(scratch.data() + n * width, width, m_nodes[n].value);
+  }
+  for(std::size_t begin = 0; begin < count; begin += width) {
+    std::size_t size = std::min(width, count - begin);
+    for(std::size_t n = 0; n < m_nodes.size(); ++n) {
+      const Node & node = m_nodes[n];
+      double * out = scratch.data() + n * width;
+      if(node.op == Param) {
+        values[n] = inputs[node.a] + begin;
+        continue;
+      }
+      const double * a = node.op == Constant ? nullptr : values[node.a];
+      const double * b = values[node.b];
+      switch(node.op) {
+      case Param:
+      case Constant:
+        break;
+      case Add:
+        binaryKernel(a, b, out, size, [](double x, double y) {return x + y;});
+        break;
+      case Sub:
+        binaryKernel(a, b, out, size, [](double x, double y) {return x - y;});
+        break;
+      case Mul:
+        binaryKernel(a, b, out, size, [](double x, double y) {return x * y;});
+        break;
+      case Div:
+        binaryKernel(a, b, out, size, [](double x, double y) {return x / y;});
+        break;
+      case Pow:
+        binaryKernel(a, b, out, size, [](double x, double y) {return std::pow(x, y);});
+        break;
+      case Neg:
+        unaryKernel(a, out, size, [](double x) {return -x;});
+        break;
+      case Sqrt:
+        if(!nonNegative(a, size)) return false;
+        unaryKernel(a, out, size, [](double x) {return std::sqrt(x);});
+        break;
+      case Ln:
+        if(!nonNegative(a, size)) return false;
+        unaryKernel(a, out, size, [](double x) {return std::log(x);});
+        break;
+      case Sin:
+        unaryKernel(a, out, size, [](double x) {return std::sin(x);});
+        break;
+      case Cos:
+        unaryKernel(a, out, size, [](double x) {return std::cos(x);});
+        break;
+      case Tan:
+        unaryKernel(a, out, size, [](double x) {return std::tan(x);});
+        break;
+      }
+      values[n] = out;
+    }
+    std::copy_n(values[m_result], size, results + begin);
+  }
+  return true;
+}
@@ -0,0 +1,83 @@
+/*! \file numeric_lambda.hpp
+Defines the NumericLambda type, a lambda compiled to run over arrays of numbers.
+ */
+#ifndef NUMERIC_LAMBDA_HPP
+#define NUMERIC_LAMBDA_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+class Expression;
+class Environment;
+
+/*! \class NumericLambda
+\brief A lambda over real numbers lowered to a DAG of arithmetic operations.
+
+A lambda compiles when its body only applies +, -, *, /, ^, sqrt, ln, sin,
+cos and tan to its parameters, number literals and symbols bound to real
+numbers. Identical subexpressions become a single node of the DAG. The DAG
+is evaluated one node at a time over blocks of inputs, so each node is a
+tight loop over an array that the compiler can vectorize, in place of a
+tree walk, an environment copy and a name lookup per parameter for every
+call.
+
+The result of each point is the one the tree walker gives. The built-ins
+whose result would not be a real number, sqrt and ln of a negative number,
+make evaluate() fail instead, and the caller evaluates those points with
+the tree walker to get the complex result or the error.
+ */
+class NumericLambda {
+public:
+
+  /// inputs are evaluated this many at a time, one array per DAG node
+  static const std::size_t BLOCK = 256;
+
+  /*! Compile a lambda.
+    \param lambda the lambda expression
+    \param env the environment the lambda would be called in
+    \return the compiled lambda, or nullptr if it is not a numeric lambda
+   */
+  static std::shared_ptr<const NumericLambda> compile(const Expression & lambda, const Environment & env);
+
+  /// the number of parameters
+  std::size_t arity() const noexcept {return m_arity;}
+
+  /// the evaluation steps the tree walker takes per call
+  std::uint64_t steps() const noexcept {return m_steps;}
+
+  /// the number of nodes in the DAG
+  std::size_t size() const noexcept {return m_nodes.size();}
+
+  /*! Evaluate the lambda at count points.
+    \param inputs one array per parameter, inputs[p][i] is parameter p at point i
+    \param count the number of points
+    \param results the count results
+    \return false if a point is outside the real domain of a built-in, the
+    results are then incomplete
+   */
+  bool evaluate(const double * const * inputs, std::size_t count, double * results) const;
+
+private:
+  NumericLambda() {}
+
+  enum Op {Param, Constant, Add, Sub, Mul, Div, Neg, Pow, Sqrt, Ln, Sin, Cos, Tan};
+
+  // the operands are indices of earlier nodes, a parameter index for Param
+  struct Node {
+    Op op;
+    std::size_t a, b;
+    double value;
+  };
+
+  struct Builder;
+
+  // in dependency order
+  std::vector<Node> m_nodes;
+  std::size_t m_result = 0;
+  std::size_t m_arity = 0;
+  std::uint64_t m_steps = 0;
+};
+
+#endif
@@ -0,0 +1,115 @@
+#include "catch.hpp"
+
+#include <cmath>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "numeric_lambda.hpp"
+#include "environment.hpp"
+#include "eval_context.hpp"
+#include "expression.hpp"
+#include "interpreter.hpp"
+#include "semantic_error.hpp"
+
+Expression evalNumeric(Interpreter & interp, const std::string & program){
+  std::istringstream iss(program);
+  REQUIRE(interp.parseStream(iss));
+  return interp.evaluate();
+}
+
+std::shared_ptr<const NumericLambda> compileNumeric(Interpreter & interp, const std::string & lambda){
+  Expression exp = evalNumeric(interp, lambda);
+  REQUIRE(exp.isHeadLambda());
+  return NumericLambda::compile(exp, interp.environment());
+}
+
+TEST_CASE( "Test compiling numeric lambdas", "[numeric_lambda]" ) {
+
+  Interpreter interp;
+  evalNumeric(interp, "(define k 3)");
+
+  REQUIRE(compileNumeric(interp, "(lambda (x) (+ (sin x) (* 0.5 (cos (* 3 x)))))"));
+  REQUIRE(compileNumeric(interp, "(lambda (x y) (/ (^ x 2) (- y)))"));
+  REQUIRE(compileNumeric(interp, "(lambda (x) (* k pi (ln (sqrt (tan x)))))"));
+  REQUIRE(compileNumeric(interp, "(lambda (x) x)"));
+
+  INFO("anything but real arithmetic on numbers is left to the tree walker")
+  REQUIRE_FALSE(compileNumeric(interp, "(lambda (x) (+ x I))"));
+  REQUIRE_FALSE(compileNumeric(interp, "(lambda (x) (real x))"));
+  REQUIRE_FALSE(compileNumeric(interp, "(lambda (x) (- x 1 2))"));
+  REQUIRE_FALSE(compileNumeric(interp, "(lambda (x) (begin (+ x 1)))"));
+  REQUIRE_FALSE(compileNumeric(interp, "(lambda (x) (+ x undefined))"));
+  REQUIRE_FALSE(compileNumeric(interp, "(lambda (x) (first (list x)))"));
+  REQUIRE_FALSE(compileNumeric(interp, "(lambda (x) (+ x \"a\"))"));
+
+  INFO("identical subexpressions are computed once")
+  auto shared = compileNumeric(interp, "(lambda (x) (+ (sin x) (sin x)))");
+  REQUIRE(shared);
+  // x, the zero the sum starts from, sin and two additions
+  REQUIRE(shared->size() == 5);
+  REQUIRE(shared->steps() == 5);
+}
+
+TEST_CASE( "Test evaluating numeric lambdas", "[numeric_lambda]" ) {
+
+  Interpreter interp;
+  evalNumeric(interp, "(define f (lambda (x y) (+ (sin x) (* 0.5 (cos (* 3 y))) (/ x))))");
+  auto compiled = compileNumeric(interp, "(begin f)");
+  REQUIRE(compiled);
+  REQUIRE(compiled->arity() == 2);
+
+  // more than a block, ending part way through one
+  std::size_t count = 3 * NumericLambda::BLOCK + 7;
+  std::vector<double> xs, ys, results(count);
+  for(std::size_t i = 0; i < count; ++i) {
+    xs.push_back(0.01 * i - 1);
+    ys.push_back(0.02 * i);
+  }
+  const double * inputs[] = {xs.data(), ys.data()};
+  REQUIRE(compiled->evaluate(inputs, count, results.data()));
+  for(std::size_t i = 0; i < count; ++i) {
+    double expected = 0 + std::sin(xs[i]) + 0.5 * std::cos(3 * ys[i]) + 1.0 / xs[i];
+    REQUIRE(results[i] == expected);
+  }
+
+  INFO("a point outside the real domain of a built-in fails the evaluation")
+  auto root = compileNumeric(interp, "(lambda (x) (sqrt x))");
+  std::vector<double> signs = {4, 1, -1};
+  const double * rootInputs[] = {signs.data()};
+  REQUIRE(root->evaluate(rootInputs, 2, results.data()));
+  REQUIRE(results[1] == 1);
+  REQUIRE_FALSE(root->evaluate(rootInputs, 3, results.data()));
+}
+
+TEST_CASE( "Test map and continuous-plot with numeric lambdas", "[numeric_lambda]" ) {
+
+  Interpreter interp;
+  evalNumeric(interp, "(define f (lambda (x) (+ (sin x) (* 0.5 (cos (* 3 x))))))");
+  evalNumeric(interp, "(define g (lambda (x) (begin (+ (sin x) (* 0.5 (cos (* 3 x)))))))");
+
+  INFO("compiled and tree walked lambdas give the same results")
+  Expression fast = evalNumeric(interp, "(map f (range -10 10 0.05))");
+  Expression slow = evalNumeric(interp, "(map g (range -10 10 0.05))");
+  REQUIRE(fast.listSize() == slow.listSize());
+  for(std::size_t i = 0; i < fast.list().size(); ++i) {
+    REQUIRE(fast.list()[i] == slow.list()[i]);
+  }
+  REQUIRE(evalNumeric(interp, "(continuous-plot f (list -10 10))") ==
+          evalNumeric(interp, "(continuous-plot g (list -10 10))"));
+
+  INFO("elements that are not real numbers go through the tree walker")
+  evalNumeric(interp, "(define root (lambda (x) (sqrt x)))");
+  Expression roots = evalNumeric(interp, "(map root (list 4 -4 I))");
+  REQUIRE(roots.list()[0] == Expression(2.));
+  REQUIRE(roots.list()[1] == Expression(Atom(0, 2)));
+  REQUIRE(roots.list()[2] == evalNumeric(interp, "(sqrt I)"));
+  evalNumeric(interp, "(define log (lambda (x) (ln x)))");
+  REQUIRE_THROWS_AS(evalNumeric(interp, "(map log (list 1 -1))"), SemanticError);
+
+  INFO("compiled calls still count their steps")
+  EvalLimits steps;
+  steps.steps = 1000;
+  interp.setLimits(steps);
+  REQUIRE_THROWS_AS(evalNumeric(interp, "(map f (range 0 10000 1))"), LimitError);
+}
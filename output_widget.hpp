@@ -8,8 +8,10 @@
 #include <QGraphicsEllipseItem>
 #include <QGraphicsLineItem>
 #include <QFont>
+#include <memory>
 #include "interpreter.hpp"
 #include "semantic_error.hpp"
+#include "scene_data.hpp"
 
 class OutputWidget: public QWidget {
     Q_OBJECT
@@ -19,22 +21,13 @@ public:
     QGraphicsView * view;
 private:
     Expression m_result;
-    void eval(Expression exp);
-    void printExpression(Expression exp);
-    void printPoint(Expression exp);
-    void printLine(Expression exp);
-    void printText(Expression exp);
-    enum Type {Point, Line, Text, List, None, Define, Discrete, Continuos};
-    Type m_type;
-    void getType(Expression exp);
-    QPointF makePoint(Expression exp);
-    QString makeString(Expression exp);
-    QString makeQExpression(Expression exp);
+    QFont m_font;
+    void showScene(SceneData & data);
     void resizeEvent(QResizeEvent* event);
 public slots:
     void recievePlotscript(Expression result);
+    void recieveScene(std::shared_ptr<SceneData> data);
     void recieveError(std::string error);
+    void recieveText(std::string text);
 };
 #endif
-
-
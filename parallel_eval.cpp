@@ -0,0 +1,134 @@
+#include "parallel_eval.hpp"
+
+#include <atomic>
+#include <exception>
+#include <string>
+#include <system_error>
+#include <thread>
+
+#include "environment.hpp"
+#include "eval_context.hpp"
+#include "expression.hpp"
+
+// threads evaluating arguments besides the evaluations' own, process wide
+std::atomic<unsigned> parallelThreads(0);
+
+// the forms that evaluate a lambda or procedure once per element
+bool isHeavyForm(const std::string & name) {
+  static const char * forms[] = {"map", "fold", "reduce", "apply", "discrete-plot", "continuous-plot"};
+  for(auto form : forms) {
+    if(name == form) return true;
+  }
+  return false;
+}
+
+std::size_t countCost(const Expression & exp, const Environment & env, std::size_t cap, std::size_t cost) {
+  cost += 1;
+  const Atom & head = exp.head();
+  if(exp.tailConstBegin() != exp.tailConstEnd() && head.isSymbol()) {
+    std::string name = head.asSymbol();
+    if(isHeavyForm(name) || env.is_exp(head)) cost += PARALLEL_COST;
+  }
+  for(auto e = exp.tailConstBegin(); e != exp.tailConstEnd() && cost < cap; ++e) {
+    cost = countCost(*e, env, cap, cost);
+  }
+  return cost;
+}
+
+std::size_t evalCost(const Expression & exp, const Environment & env, std::size_t cap) {
+  return std::min(cap, countCost(exp, env, cap, 0));
+}
+
+bool isPure(const Expression & exp) noexcept {
+  const Atom & head = exp.head();
+  if(exp.tailConstBegin() != exp.tailConstEnd() && head.isSymbol() && head.asSymbol() == "define") {
+    return false;
+  }
+  for(auto e = exp.tailConstBegin(); e != exp.tailConstEnd(); ++e) {
+    if(!isPure(*e)) return false;
+  }
+  return true;
+}
+
+unsigned reserveThreads(unsigned wanted) {
+  EvalContext * context = EvalContext::active();
+  if(!context || context->limits().parallel < 2) return 0;
+  unsigned limit = context->limits().parallel - 1;
+  unsigned running = parallelThreads.load();
+  while(true) {
+    unsigned reserved = (running < limit) ? std::min(wanted, limit - running) : 0;
+    if(reserved == 0) return 0;
+    if(parallelThreads.compare_exchange_weak(running, running + reserved)) return reserved;
+  }
+}
+
+void releaseThreads(unsigned count) noexcept {
+  parallelThreads -= count;
+}
+
+bool evalParallel(std::vector<Expression> & exps, Environment & env, std::vector<Expression> & results) {
+  EvalContext * context = EvalContext::active();
+  if(!context || context->limits().parallel < 2 || exps.size() < 2) return false;
+
+  std::vector<std::size_t> costly;
+  for(std::size_t i = 0; i < exps.size(); ++i) {
+    if(evalCost(exps[i], env, PARALLEL_COST) >= PARALLEL_COST) costly.push_back(i);
+  }
+  if(costly.size() < 2) return false;
+  for(auto & exp : exps) {
+    if(!isPure(exp)) return false;
+  }
+  unsigned extra = reserveThreads(static_cast<unsigned>(costly.size() - 1));
+  if(extra == 0) return false;
+
+  std::vector<Expression> values(exps.size());
+  std::vector<std::exception_ptr> errors(exps.size());
+  // expressions after a failed one are not started, their values are never used
+  std::atomic<std::size_t> firstError(exps.size());
+  auto evaluate = [&](std::size_t i) {
+    if(i > firstError) return;
+    try {
+      values[i] = exps[i].eval(env);
+    } catch(...) {
+      errors[i] = std::current_exception();
+      std::size_t first = firstError.load();
+      while(i < first && !firstError.compare_exchange_weak(first, i)) {}
+    }
+  };
+  std::atomic<std::size_t> next(0);
+  auto evaluateCostly = [&]() {
+    for(std::size_t task = next++; task < costly.size(); task = next++) evaluate(costly[task]);
+  };
+
+  EvalLimits left = context->left();
+  std::vector<std::uint64_t> steps(extra, 0), bytes(extra, 0);
+  std::vector<std::thread> threads;
+  for(unsigned t = 0; t < extra; ++t) {
+    try {
+      threads.emplace_back([&, t]() {
+        EvalContext part(*context, left);
+        evaluateCostly();
+        steps[t] = part.steps();
+        bytes[t] = part.bytes();
+      });
+    } catch(const std::system_error &) {
+      // the others share the work
+      break;
+    }
+  }
+  for(std::size_t i = 0, c = 0; i < exps.size(); ++i) {
+    if(c < costly.size() && costly[c] == i) {
+      ++c;
+      continue;
+    }
+    evaluate(i);
+  }
+  evaluateCostly();
+  for(auto & thread : threads) thread.join();
+  releaseThreads(extra);
+
+  for(std::size_t t = 0; t < extra; ++t) context->absorb(steps[t], bytes[t]);
+  if(firstError < exps.size()) std::rethrow_exception(errors[firstError]);
+  results = std::move(values);
+  return true;
+}
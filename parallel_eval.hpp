@@ -0,0 +1,65 @@
+/*! \file parallel_eval.hpp
+Defines the opt-in evaluation of independent arguments on several threads.
+ */
+#ifndef PARALLEL_EVAL_HPP
+#define PARALLEL_EVAL_HPP
+
+#include <cstddef>
+#include <vector>
+
+class Environment;
+class Expression;
+
+/// the estimated cost from which an argument is worth a thread of its own
+const std::size_t PARALLEL_COST = 256;
+
+/*! Estimate the cost of evaluating exp, stopping once it reaches cap.
+
+  Every node counts one. Calls that evaluate a lambda or a procedure over
+  a list (map, fold, reduce, apply, the plots, and calls of symbols bound
+  to expressions, which are lambdas) count PARALLEL_COST.
+  \param exp the unevaluated expression
+  \param env the environment it would be evaluated in
+  \param cap where to stop counting
+  \return the estimate, at most cap
+ */
+std::size_t evalCost(const Expression & exp, const Environment & env, std::size_t cap);
+
+/*! Determine if exp can be evaluated alongside other expressions: it
+  contains no define, so evaluating it only reads the environment.
+  \param exp the unevaluated expression
+ */
+bool isPure(const Expression & exp) noexcept;
+
+/*! Reserve threads for the evaluation of this thread to use besides its
+  own. All evaluations of the process share EvalLimits::parallel - 1 extra
+  threads, so parallel evaluations running at once, as in the daemon and
+  batch modes, do not oversubscribe the machine.
+  \param wanted the most threads wanted
+  \return how many were reserved, 0 without an EvalContext allowing more
+  than one thread, hand them back with releaseThreads
+ */
+unsigned reserveThreads(unsigned wanted);
+
+/// hand back count threads reserved with reserveThreads
+void releaseThreads(unsigned count) noexcept;
+
+/*! Evaluate exps on several threads if the evaluation allows it and is
+  worth it, as the arguments of a call or the elements of a list.
+
+  Nothing is done unless the EvalContext of this thread allows more than
+  one thread, at least two of exps cost PARALLEL_COST, and all of them are
+  pure. The costly ones are then shared between this thread and up to
+  EvalLimits::parallel - 1 others, counted across all evaluations of the
+  process, while this thread also evaluates the cheap ones. Each thread
+  polls the token and deadline of the evaluation, and the steps and bytes
+  it counts are charged to it. If any expression fails, the error of the
+  first failing one in order is rethrown, as evaluating in order would.
+  \param exps the expressions, in order
+  \param env the environment to evaluate them in, which is only read
+  \param results the values of exps when true is returned
+  \return false if exps should be evaluated in order instead
+ */
+bool evalParallel(std::vector<Expression> & exps, Environment & env, std::vector<Expression> & results);
+
+#endif
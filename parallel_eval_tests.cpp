@@ -0,0 +1,114 @@
+#include "catch.hpp"
+
+#include <string>
+#include <sstream>
+
+#include "environment.hpp"
+#include "eval_context.hpp"
+#include "interpreter.hpp"
+#include "parallel_eval.hpp"
+#include "parse.hpp"
+#include "semantic_error.hpp"
+
+Expression evalWith(Interpreter & interp, const std::string & program){
+  std::istringstream iss(program);
+  REQUIRE(interp.parseStream(iss));
+  return interp.evaluate();
+}
+
+Expression parseOnly(const std::string & program){
+  std::istringstream iss(program);
+  return parse(tokenize(iss));
+}
+
+// the message of the error evaluating program throws
+std::string errorOf(Interpreter & interp, const std::string & program){
+  try {
+    evalWith(interp, program);
+  } catch(const SemanticError & e) {
+    return e.what();
+  }
+  return "";
+}
+
+TEST_CASE( "Test the --parallel option", "[parallel_eval]" ) {
+
+  EvalLimits limits;
+  REQUIRE(parseLimit("--parallel", "4", limits));
+  REQUIRE(limits.parallel == 4);
+  REQUIRE_FALSE(parseLimit("--parallel", "2.5", limits));
+  REQUIRE_FALSE(parseLimit("--parallel", "many", limits));
+  REQUIRE(limits.parallel == 4);
+}
+
+TEST_CASE( "Test estimating the cost of arguments", "[parallel_eval]" ) {
+
+  Environment env;
+  REQUIRE(evalCost(parseOnly("(+ 1 2)"), env, PARALLEL_COST) == 3);
+  REQUIRE(evalCost(parseOnly("(map sin (range 0 10 1))"), env, PARALLEL_COST) == PARALLEL_COST);
+  REQUIRE(evalCost(parseOnly("(apply + (list 1 2))"), env, 10) == 10);
+
+  REQUIRE(isPure(parseOnly("(map sin (list 1 2))")));
+  REQUIRE_FALSE(isPure(parseOnly("(list (begin (define a 1) a))")));
+}
+
+TEST_CASE( "Test when arguments are evaluated in parallel", "[parallel_eval]" ) {
+
+  Environment env;
+  std::vector<Expression> costly = {parseOnly("(map sin (range 0 10 1))"), parseOnly("(+ 1 2)"),
+                                    parseOnly("(apply + (range 0 10 1))")};
+  std::vector<Expression> results;
+
+  INFO("only inside an evaluation allowing several threads")
+  REQUIRE_FALSE(evalParallel(costly, env, results));
+  CancellationToken token;
+  EvalLimits limits;
+  limits.parallel = 4;
+  EvalContext context(token, limits);
+  REQUIRE(evalParallel(costly, env, results));
+  REQUIRE(results.size() == 3);
+  REQUIRE(results[1] == Expression(3.));
+  REQUIRE(results[2] == Expression(55.));
+
+  INFO("not for a single costly argument or a define")
+  std::vector<Expression> single = {parseOnly("(map sin (range 0 10 1))"), parseOnly("(+ 1 2)")};
+  REQUIRE_FALSE(evalParallel(single, env, results));
+  costly.push_back(parseOnly("(begin (define a 1) a)"));
+  REQUIRE_FALSE(evalParallel(costly, env, results));
+}
+
+TEST_CASE( "Test evaluating arguments in parallel", "[parallel_eval]" ) {
+
+  std::string program =
+    "(begin (define f (lambda (x) (* x x))) "
+    "(list (map f (range 0 200 1)) (+ 1 2) (fold + 0 (range 0 300 1)) "
+    "(apply + (map f (range 0 50 1))) (length (range 0 10 1))))";
+
+  Interpreter sequential;
+  Expression expected = evalWith(sequential, program);
+
+  Interpreter parallel;
+  EvalLimits limits;
+  limits.parallel = 4;
+  parallel.setLimits(limits);
+  REQUIRE(evalWith(parallel, program) == expected);
+
+  INFO("the arguments of a procedure")
+  REQUIRE(evalWith(parallel, "(+ (apply + (range 0 100 1)) (fold + 0 (range 0 100 1)))") == Expression(10100.));
+
+  INFO("the first failing argument in order is reported")
+  std::string failing = "(list (map sin (range 0 10 1)) (map first (list 1 2)) (apply cos (list 1 2)))";
+  std::string first = errorOf(sequential, failing);
+  REQUIRE(first != "");
+  REQUIRE(first != errorOf(sequential, "(apply cos (list 1 2))"));
+  REQUIRE(errorOf(parallel, failing) == first);
+
+  INFO("definitions are kept in order")
+  REQUIRE(evalWith(parallel,
+    "(list (begin (define g (lambda (x) x)) (map g (list 1))) (map g (list 2)))").isHeadList());
+
+  INFO("the step limit counts the steps of every thread")
+  limits.steps = 2000;
+  parallel.setLimits(limits);
+  REQUIRE_THROWS_AS(evalWith(parallel, "(list (map f (range 0 500 1)) (map f (range 0 500 1)))"), LimitError);
+}
@@ -1,6 +1,19 @@
 #include "parse.hpp"
 
+#include <algorithm>
+#include <atomic>
 #include <stack>
+#include <system_error>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// programs with fewer tokens are parsed on one thread
+const std::size_t PARALLEL_TOKENS = 1 << 16;
+// the tokens in a unit of parallel work, and the least a form is split at
+const std::size_t PARSE_GRAIN = 1 << 14;
+
+typedef TokenSequenceType::const_iterator TokenIterator;
 
 bool setHead(Expression &exp, const Token &token) {
   Atom a(token);
@@ -14,15 +27,17 @@ bool append(Expression *exp, const Token &token) {
   return !a.isNone();
 }
 
-Expression parse(const TokenSequenceType &tokens) noexcept {
+// parse the tokens from begin to end on this thread
+Expression parseRange(TokenIterator begin, TokenIterator end) noexcept {
   Expression ast;
   // cannot parse empty
-  if (tokens.empty()) return Expression();
+  if (begin == end) return Expression();
   bool athead = false;
   // stack tracks the last node created
   std::stack<Expression *> stack;
   std::size_t num_tokens_seen = 0;
-  for (auto &t : tokens) {
+  for (auto it = begin; it != end; ++it) {
+    const Token &t = *it;
     if (t.type() == Token::OPEN) {
       athead = true;
     } else if (t.type() == Token::CLOSE) {
@@ -63,8 +78,185 @@ Expression parse(const TokenSequenceType &tokens) noexcept {
     }
     num_tokens_seen += 1;
   }
-  if (stack.empty() && (num_tokens_seen == tokens.size())) {
+  if (stack.empty() && (num_tokens_seen == static_cast<std::size_t>(end - begin))) {
     return ast;
   }
   return Expression();
+}
+
+/*
+Splits a program into parts built on several threads. Forms of at least
+PARSE_GRAIN tokens are split into their children, the rest of the parts
+are single atoms or small forms, grouped into units of about PARSE_GRAIN
+tokens. The parts are then moved into their forms in program order, so
+the tree does not depend on how the work was scheduled.
+ */
+class ParallelParser {
+public:
+  explicit ParallelParser(const TokenSequenceType & tokens): tokens(tokens) {}
+
+  // false if the program is not a single form with a head in every list
+  bool plan() {
+    std::vector<std::size_t> opens;
+    std::size_t size = tokens.size();
+    if (tokens[0].type() != Token::OPEN) return false;
+    for (std::size_t i = 0; i < size; ++i) {
+      Token::TokenType type = tokens[i].type();
+      if (type == Token::OPEN) {
+        if (i + 1 == size || tokens[i + 1].type() == Token::OPEN || tokens[i + 1].type() == Token::CLOSE) {
+          return false;
+        }
+        opens.push_back(i);
+      } else if (type == Token::CLOSE) {
+        if (opens.empty()) return false;
+        std::size_t open = opens.back();
+        opens.pop_back();
+        if (i - open + 1 >= PARSE_GRAIN) large.emplace(open, i);
+        if (opens.empty() && i + 1 != size) return false;
+      }
+    }
+    if (!opens.empty()) return false;
+    split(0, size - 1);
+    return true;
+  }
+
+  // build the parts and then the tree, the None Expression if an atom is invalid
+  Expression build() {
+    std::vector<std::size_t> units;
+    std::size_t count = 0;
+    for (std::size_t i = 0; i < parts.size(); ++i) {
+      if (parts[i].form != NONE) continue;
+      if (count == 0) units.push_back(i);
+      parts[i].unit = units.size() - 1;
+      count += parts[i].end - parts[i].begin;
+      if (count >= PARSE_GRAIN) count = 0;
+    }
+    units.push_back(parts.size());
+    built.resize(units.size() - 1);
+
+    std::atomic<std::size_t> next(0);
+    std::atomic_bool failed(false);
+    auto work = [&]() {
+      for (std::size_t unit = next++; unit < built.size() && !failed; unit = next++) {
+        std::vector<Expression> & exps = built[unit];
+        for (std::size_t i = units[unit]; i < units[unit + 1]; ++i) {
+          Part & part = parts[i];
+          if (part.form != NONE) continue;
+          part.slot = exps.size();
+          if (part.end - part.begin == 1) {
+            // an atom, which is not a program of its own
+            exps.emplace_back(Atom(tokens[part.begin]));
+            if (exps.back().isHeadNone()) failed = true;
+          } else {
+            exps.push_back(parseRange(tokens.begin() + part.begin, tokens.begin() + part.end));
+            if (exps.back() == Expression()) failed = true;
+          }
+        }
+      }
+    };
+    std::size_t workers = std::min<std::size_t>(built.size(), std::max(1u, std::thread::hardware_concurrency()));
+    std::vector<std::thread> threads;
+    for (std::size_t i = 1; i < workers; ++i) {
+      try {
+        threads.emplace_back(work);
+      } catch (const std::system_error &) {
+        // the remaining units are built on fewer threads
+        break;
+      }
+    }
+    work();
+    for (auto & thread : threads) thread.join();
+    if (failed) return Expression();
+    return stitch(0);
+  }
+
+private:
+  static const std::size_t NONE = static_cast<std::size_t>(-1);
+
+  // a child of a split form: its tokens, and either the split form or where it is built
+  struct Part {
+    std::size_t begin;
+    std::size_t end;
+    std::size_t form;
+    std::size_t unit;
+    std::size_t slot;
+  };
+
+  // a form split into the parts from first to last
+  struct Form {
+    std::size_t head;
+    std::size_t first;
+    std::size_t last;
+  };
+
+  // split the form from open to close, return its index
+  std::size_t split(std::size_t open, std::size_t close) {
+    std::size_t index = forms.size();
+    forms.push_back(Form{open + 1, 0, 0});
+    std::vector<Part> children;
+    std::size_t i = open + 2;
+    while (i < close) {
+      Part part{i, i + 1, NONE, 0, 0};
+      if (tokens[i].type() == Token::OPEN) {
+        auto found = large.find(i);
+        if (found != large.end()) {
+          part.end = found->second + 1;
+          part.form = split(i, found->second);
+        } else {
+          part.end = matching(i) + 1;
+        }
+      }
+      children.push_back(part);
+      i = children.back().end;
+    }
+    forms[index].first = parts.size();
+    parts.insert(parts.end(), children.begin(), children.end());
+    forms[index].last = parts.size();
+    return index;
+  }
+
+  // the CLOSE of a form below PARSE_GRAIN tokens
+  std::size_t matching(std::size_t open) const {
+    std::size_t depth = 0;
+    for (std::size_t i = open; ; ++i) {
+      if (tokens[i].type() == Token::OPEN) ++depth;
+      else if (tokens[i].type() == Token::CLOSE && --depth == 0) return i;
+    }
+  }
+
+  Expression stitch(std::size_t index) {
+    Expression exp;
+    if (!setHead(exp, tokens[forms[index].head])) return Expression();
+    for (std::size_t i = forms[index].first; i < forms[index].last; ++i) {
+      const Part & part = parts[i];
+      if (part.form == NONE) {
+        exp.append(std::move(built[part.unit][part.slot]));
+        continue;
+      }
+      Expression child = stitch(part.form);
+      if (child == Expression()) return Expression();
+      exp.append(std::move(child));
+    }
+    return exp;
+  }
+
+  const TokenSequenceType & tokens;
+  // the CLOSE of each form of at least PARSE_GRAIN tokens, by its OPEN
+  std::unordered_map<std::size_t, std::size_t> large;
+  std::vector<Form> forms;
+  std::vector<Part> parts;
+  // the parts built by each unit of work
+  std::vector<std::vector<Expression>> built;
+};
+
+Expression parse(const TokenSequenceType &tokens) noexcept {
+  if (tokens.size() < PARALLEL_TOKENS) {
+    return parseRange(tokens.begin(), tokens.end());
+  }
+  ParallelParser parser(tokens);
+  if (!parser.plan()) {
+    // malformed, or one of the shapes only the sequential parse accepts
+    return parseRange(tokens.begin(), tokens.end());
+  }
+  return parser.build();
 };
@@ -7,18 +7,43 @@
 #include <fstream>
 #include <atomic>
 #include <thread>
+#include <cstdint>
 #include "interpreter.hpp"
 #include "startup_config.hpp"
-#include "tsQueue.hpp"
+#include "spscQueue.hpp"
+#include "trace.hpp"
 
-typedef tsQueue<std::string> parseQueue;
-typedef tsQueue<Expression> resultQueue;
+// a line for the kernel, tagged so its result can be matched to it
+struct parseRequest {
+    std::uint64_t id;
+    std::string line;
+    // when it was queued, for tracing
+    TraceClock::time_point queued;
+};
+
+// the outcome of a request, either the value or the error message
+struct parseResult {
+    std::uint64_t id = 0;
+    bool ok = false;
+    Expression exp;
+    std::string error;
+    // when the kernel finished it, for tracing
+    TraceClock::time_point finished;
+};
+
+typedef spscQueue<parseRequest> parseQueue;
+typedef spscQueue<parseResult> resultQueue;
+
+// the request that stops the kernel thread
+const std::string KILL_REQUEST = "%%%%%";
 
 void error(const std::string & err_str) {
     std::cerr << "Error: " << err_str << std::endl;
 }
 
 void loadStartup(Interpreter *interp) {
+    // the build-time image is only used while it matches the startup file
+    if(interp->loadImage(STARTUP_IMAGE, STARTUP_FILE)) return;
     std::ifstream startup(STARTUP_FILE);
     if(!interp->parseStream(startup)) {
         error("Invalid Startup. Could not parse.");
@@ -34,8 +59,14 @@ void loadStartup(Interpreter *interp) {
 class parseInterp {
 public:
     parseInterp() {}
-    void startThread(parseQueue *pQ, resultQueue *rQ, std::atomic_bool *solved, Interpreter * interp) {
-        pool.emplace_back(std::thread(&parseInterp::pI, this, pQ, rQ, solved, interp));
+    void startThread(parseQueue *pQ, resultQueue *rQ, Interpreter * interp) {
+        pool.emplace_back(std::thread(&parseInterp::pI, this, pQ, rQ, interp));
+    }
+    void stopThread(parseQueue *pQ) {
+        if(pool.size() > 0) {
+            pQ->push(parseRequest{0, KILL_REQUEST, TraceClock::time_point()});
+            joinAll();
+        }
     }
     int size() {
         return pool.size();
@@ -49,30 +80,32 @@ public:
     }
 private:
     std::vector<std::thread> pool;
-    void pI(parseQueue *pQ, resultQueue *rQ, std::atomic_bool *solved, Interpreter * interp) {
-        //load startup file
-        loadStartup(interp);
+    void pI(parseQueue *pQ, resultQueue *rQ, Interpreter * interp) {
+        traceThreadName("kernel");
         //keep thread alive
         while(1) {
-            std::string line;
-            pQ->wait_and_pop(line);
-            if(line == "%%%%%") return;
-            std::istringstream expression(line);
+            parseRequest request;
+            pQ->wait_and_pop(request);
+            if(request.line == KILL_REQUEST) return;
+            traceSpan(QueueWait, request.queued, TraceClock::now(), request.id);
+            parseResult result;
+            result.id = request.id;
+            std::istringstream expression(request.line);
             if(!interp->parseStream(expression)){
-                error("Invalid Expression. Could not parse.");
-                solved->store(false);
+                result.error = "Error: Invalid Expression. Could not parse.";
             }
             else{
                 try{
-                    Expression exp = interp->evaluate();
-                    solved->store(true);
-                    rQ->push(exp);
+                    result.exp = interp->evaluate(request.id);
+                    result.ok = true;
                 }
                 catch(const SemanticError & ex){
-                    solved->store(false);
-                    std::cerr << ex.what() << std::endl;
+                    result.error = ex.what();
                 }
             }
+            //the result wakes the REPL as soon as it is ready
+            result.finished = TraceClock::now();
+            rQ->push(std::move(result));
         }
     }
 };
@@ -57,3 +57,64 @@ TEST_CASE( "Test empty parens", "[parse]" ) {
   REQUIRE(parse(tokens) == Expression());
 }
 
+
+// a program large enough to be parsed on several threads
+std::string largeProgram(std::size_t elements){
+  std::string program = "(begin (define data (list";
+  for(std::size_t i = 0; i < elements; ++i){
+    program += " " + std::to_string(i);
+    if(i % 1000 == 0) program += " (+ " + std::to_string(i) + " (- 1))";
+  }
+  program += ")) (define s \"a b\") (first data))";
+  return program;
+}
+
+TokenSequenceType tokensOf(const std::string & program){
+  std::istringstream iss(program);
+  return tokenize(iss);
+}
+
+TEST_CASE( "Test parsing large programs in parallel", "[parse]" ) {
+
+  std::size_t elements = 100000;
+  TokenSequenceType tokens = tokensOf(largeProgram(elements));
+  Expression ast = parse(tokens);
+  REQUIRE(ast != Expression());
+
+  INFO("the parts are stitched together in program order")
+  Expression expected(Atom("begin"));
+  expected.append(Atom("define"));
+  Expression * define = expected.tail();
+  define->append(Atom("data"));
+  define->append(Atom("list"));
+  Expression * list = define->tail();
+  for(std::size_t i = 0; i < elements; ++i){
+    list->append(Atom(static_cast<double>(i)));
+    if(i % 1000 == 0){
+      list->append(Atom("+"));
+      list->tail()->append(Atom(static_cast<double>(i)));
+      list->tail()->append(Atom("-"));
+      list->tail()->tail()->append(Atom(1.));
+    }
+  }
+  expected.append(Atom("define"));
+  expected.tail()->append(Atom("s"));
+  expected.tail()->append(Atom(std::string("a b\"")));
+  expected.append(Atom("first"));
+  expected.tail()->append(Atom("data"));
+  REQUIRE(ast == expected);
+
+  INFO("malformed programs fail as they do on one thread")
+  TokenSequenceType bad = tokens;
+  bad[tokens.size() / 2] = Token("1.2abc");
+  REQUIRE(parse(bad) == Expression());
+  bad = tokens;
+  bad.push_back(Token::CLOSE);
+  REQUIRE(parse(bad) == Expression());
+  bad = tokens;
+  bad.pop_back();
+  REQUIRE(parse(bad) == Expression());
+  bad = tokens;
+  bad.push_front(Token::OPEN);
+  REQUIRE(parse(bad) == ast);
+}
@@ -0,0 +1,362 @@
+/*! \file persistent_list.hpp
+Defines the PersistentList type holding the elements of a list Expression.
+ */
+#ifndef PERSISTENT_LIST_HPP
+#define PERSISTENT_LIST_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <iterator>
+#include <new>
+#include <list>
+#include <memory>
+#include <utility>
+#include <vector>
+
+/*! \class PersistentList
+\brief An immutable sequence with structural sharing.
+
+The elements are stored in chunks of at most CHUNK at the leaves of a
+height-balanced binary tree. A node is never modified once it is built, so
+copies of a list share the whole tree and lists may be read from several
+threads at once.
+
+Copying a list and rest() are O(1): rest() is a view that skips the first
+element of the same tree. push_back() and join() build only the O(log n)
+nodes on the path to the changed chunk. A chunk's elements live in a buffer
+with room to grow, and the first chunk to extend a buffer past its end
+constructs the new elements there instead of copying the chunk. When more
+than half of the tree is skipped, the skipped elements are dropped so
+memory stays proportional to the size of the list.
+ */
+template<typename T>
+class PersistentList {
+  struct Node;
+  typedef std::shared_ptr<const Node> NodePtr;
+
+public:
+
+  /// the most elements stored in one chunk
+  static const std::size_t CHUNK = 32;
+
+  /// forward iterator over the elements, valid while the list is unchanged
+  class const_iterator {
+  public:
+    typedef std::forward_iterator_tag iterator_category;
+    typedef T value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef const T * pointer;
+    typedef const T & reference;
+
+    const_iterator() {}
+
+    reference operator*() const {return m_chunk[m_index - m_chunkStart];}
+
+    pointer operator->() const {return &**this;}
+
+    const_iterator & operator++() {
+      // the next chunk is found from the root, once per CHUNK elements
+      if(++m_index == m_chunkEnd && m_index < m_end) seek();
+      return *this;
+    }
+
+    const_iterator operator++(int) {
+      const_iterator previous = *this;
+      ++*this;
+      return previous;
+    }
+
+    bool operator==(const const_iterator & other) const noexcept {return m_index == other.m_index;}
+
+    bool operator!=(const const_iterator & other) const noexcept {return m_index != other.m_index;}
+
+  private:
+    friend class PersistentList;
+
+    const_iterator(const Node * root, std::size_t index, std::size_t end):
+      m_root(root), m_index(index), m_end(end) {
+      if(m_index < m_end) seek();
+    }
+
+    void seek() {
+      const Node * chunk = PersistentList::chunkAt(m_root, m_index, m_chunkStart);
+      m_chunk = chunk->items();
+      m_chunkEnd = m_chunkStart + chunk->size;
+    }
+
+    const Node * m_root = nullptr;
+    // position in the whole tree, including elements skipped by rest()
+    std::size_t m_index = 0;
+    std::size_t m_end = 0;
+    const T * m_chunk = nullptr;
+    std::size_t m_chunkStart = 0;
+    std::size_t m_chunkEnd = 0;
+  };
+
+  /// Construct an empty list
+  PersistentList() {}
+
+  /// Construct a list of elements, in order
+  explicit PersistentList(std::vector<T> && elements) {
+    std::vector<NodePtr> chunks;
+    for(std::size_t i = 0; i < elements.size(); i += CHUNK) {
+      std::size_t end = std::min(elements.size(), i + CHUNK);
+      chunks.push_back(makeChunk(std::make_move_iterator(elements.begin() + i),
+                                 std::make_move_iterator(elements.begin() + end), end - i));
+    }
+    m_root = build(chunks, 0, chunks.size());
+  }
+
+  /// Construct a list of elements, in order
+  explicit PersistentList(const std::list<T> & elements):
+    PersistentList(std::vector<T>(elements.begin(), elements.end())) {}
+
+  /// number of elements
+  std::size_t size() const noexcept {return m_root ? m_root->size - m_offset : 0;}
+
+  /// true if there are no elements
+  bool empty() const noexcept {return size() == 0;}
+
+  /// the element at index, which must be less than size()
+  const T & operator[](std::size_t index) const {
+    std::size_t start;
+    const Node * chunk = chunkAt(m_root.get(), m_offset + index, start);
+    return chunk->items()[m_offset + index - start];
+  }
+
+  /// the first element, the list must not be empty
+  const T & front() const {return (*this)[0];}
+
+  /// the list without its first element, the list must not be empty
+  PersistentList rest() const {
+    PersistentList result(*this);
+    ++result.m_offset;
+    result.compact();
+    return result;
+  }
+
+  /// add exp at the end of this list, other copies are unchanged
+  void push_back(const T & exp) {
+    compact();
+    m_root = pushBack(m_root, exp);
+  }
+
+  /// the elements of this list followed by those of other
+  PersistentList join(const PersistentList & other) const {
+    PersistentList result(*this);
+    result.m_root = concat(m_root, dropFront(other.m_root, other.m_offset));
+    result.compact();
+    return result;
+  }
+
+  /// remove every element
+  void clear() noexcept {
+    m_root.reset();
+    m_offset = 0;
+  }
+
+  /// iterator to the first element
+  const_iterator begin() const noexcept {return const_iterator(m_root.get(), m_offset, m_offset + size());}
+
+  /// iterator to the element at index, which must be at most size()
+  const_iterator iteratorAt(std::size_t index) const {return const_iterator(m_root.get(), m_offset + index, m_offset + size());}
+
+  /// iterator past the last element
+  const_iterator end() const noexcept {return const_iterator(m_root.get(), m_offset + size(), m_offset + size());}
+
+  /// iterator to the first element
+  const_iterator cbegin() const noexcept {return begin();}
+
+  /// iterator past the last element
+  const_iterator cend() const noexcept {return end();}
+
+private:
+
+  // storage shared by the versions of a chunk, a version may construct
+  // elements past the end of the constructed ones if it ends there
+  struct Buffer {
+    explicit Buffer(std::size_t capacity):
+      data(static_cast<T *>(::operator new(capacity * sizeof(T)))), capacity(capacity), used(0) {}
+
+    ~Buffer() {
+      std::size_t count = used.load();
+      for(std::size_t i = 0; i < count; ++i) data[i].~T();
+      ::operator delete(data);
+    }
+
+    Buffer(const Buffer &) = delete;
+    Buffer & operator=(const Buffer &) = delete;
+
+    // claim [begin, begin + count) if nothing was constructed from begin on
+    bool claim(std::size_t begin, std::size_t count) {
+      if(begin + count > capacity) return false;
+      return used.compare_exchange_strong(begin, begin + count);
+    }
+
+    T * data;
+    std::size_t capacity;
+    std::atomic<std::size_t> used;
+  };
+
+  // a chunk when height is 0, otherwise a branch with both children set
+  struct Node {
+    std::size_t size;
+    int height;
+    NodePtr left, right;
+    // chunks only, the elements are buffer->data[start, start + size)
+    std::shared_ptr<Buffer> buffer;
+    std::size_t start;
+
+    const T * items() const noexcept {return buffer->data + start;}
+  };
+
+  static int height(const NodePtr & node) noexcept {return node ? node->height : -1;}
+
+  // a chunk of the count elements of [first, last) with room to grow
+  template<typename Iterator>
+  static NodePtr makeChunk(Iterator first, Iterator last, std::size_t count) {
+    std::shared_ptr<Buffer> buffer = std::make_shared<Buffer>(std::max<std::size_t>(count, 2));
+    for(; first != last; ++first) {
+      new (buffer->data + buffer->used.load(std::memory_order_relaxed)) T(*first);
+      buffer->used.fetch_add(1, std::memory_order_relaxed);
+    }
+    return chunkOf(buffer, 0, count);
+  }
+
+  static NodePtr chunkOf(const std::shared_ptr<Buffer> & buffer, std::size_t start, std::size_t size) {
+    std::shared_ptr<Node> node = std::make_shared<Node>();
+    node->size = size;
+    node->height = 0;
+    node->buffer = buffer;
+    node->start = start;
+    return node;
+  }
+
+  // the chunk followed by the count elements at items, at most CHUNK in all
+  static NodePtr extendChunk(const NodePtr & chunk, const T * items, std::size_t count) {
+    Buffer & buffer = *chunk->buffer;
+    std::size_t end = chunk->start + chunk->size;
+    if(buffer.claim(end, count)) {
+      std::size_t built = 0;
+      try {
+        for(; built < count; ++built) new (buffer.data + end + built) T(items[built]);
+      } catch(...) {
+        // the claimed slots must hold something for the destructor
+        for(; built < count; ++built) new (buffer.data + end + built) T();
+        throw;
+      }
+      return chunkOf(chunk->buffer, chunk->start, chunk->size + count);
+    }
+    // someone else grew the buffer, or it is full: copy into a larger one
+    std::size_t size = chunk->size + count;
+    std::shared_ptr<Buffer> copy = std::make_shared<Buffer>(std::min(CHUNK, std::max<std::size_t>(2 * size, 4)));
+    for(std::size_t i = 0; i < size; ++i) {
+      new (copy->data + i) T(i < chunk->size ? chunk->items()[i] : items[i - chunk->size]);
+      copy->used.fetch_add(1, std::memory_order_relaxed);
+    }
+    return chunkOf(copy, 0, size);
+  }
+
+  static NodePtr makeBranch(const NodePtr & left, const NodePtr & right) {
+    std::shared_ptr<Node> node = std::make_shared<Node>();
+    node->size = left->size + right->size;
+    node->height = std::max(left->height, right->height) + 1;
+    node->left = left;
+    node->right = right;
+    node->start = 0;
+    return node;
+  }
+
+  // a balanced tree over chunks[begin, end)
+  static NodePtr build(const std::vector<NodePtr> & chunks, std::size_t begin, std::size_t end) {
+    if(begin == end) return NodePtr();
+    if(end - begin == 1) return chunks[begin];
+    std::size_t middle = begin + (end - begin) / 2;
+    return makeBranch(build(chunks, begin, middle), build(chunks, middle, end));
+  }
+
+  // a branch over two trees whose heights differ by at most two
+  static NodePtr balance(const NodePtr & left, const NodePtr & right) {
+    if(height(left) > height(right) + 1) {
+      if(height(left->left) >= height(left->right))
+        return makeBranch(left->left, makeBranch(left->right, right));
+      return makeBranch(makeBranch(left->left, left->right->left),
+                        makeBranch(left->right->right, right));
+    }
+    if(height(right) > height(left) + 1) {
+      if(height(right->right) >= height(right->left))
+        return makeBranch(makeBranch(left, right->left), right->right);
+      return makeBranch(makeBranch(left, right->left->left),
+                        makeBranch(right->left->right, right->right));
+    }
+    return makeBranch(left, right);
+  }
+
+  // the tree followed by exp, along the right spine
+  static NodePtr pushBack(const NodePtr & node, const T & exp) {
+    if(!node) return makeChunk(&exp, &exp + 1, 1);
+    if(node->height == 0) {
+      if(node->size < CHUNK) return extendChunk(node, &exp, 1);
+      return makeBranch(node, makeChunk(&exp, &exp + 1, 1));
+    }
+    return balance(node->left, pushBack(node->right, exp));
+  }
+
+  // the elements of left followed by those of right, descending the facing
+  // spine of the taller tree so that small chunks at the seam are merged
+  static NodePtr concat(const NodePtr & left, const NodePtr & right) {
+    if(!left) return right;
+    if(!right) return left;
+    if(left->height == 0 && right->height == 0 && left->size + right->size <= CHUNK) {
+      return extendChunk(left, right->items(), right->size);
+    }
+    if(left->height > right->height + 1 || (right->height == 0 && left->height > 0))
+      return balance(left->left, concat(left->right, right));
+    if(right->height > left->height + 1 || (left->height == 0 && right->height > 0))
+      return balance(concat(left, right->left), right->right);
+    return makeBranch(left, right);
+  }
+
+  // the tree without its first count elements
+  static NodePtr dropFront(const NodePtr & node, std::size_t count) {
+    if(count == 0) return node;
+    if(!node || count >= node->size) return NodePtr();
+    if(node->height == 0)
+      return chunkOf(node->buffer, node->start + count, node->size - count);
+    if(count >= node->left->size)
+      return dropFront(node->right, count - node->left->size);
+    return concat(dropFront(node->left, count), node->right);
+  }
+
+  // the chunk holding element index of the tree, and the index of its first element
+  static const Node * chunkAt(const Node * node, std::size_t index, std::size_t & start) {
+    start = 0;
+    while(node->height > 0) {
+      if(index - start < node->left->size) {
+        node = node->left.get();
+      } else {
+        start += node->left->size;
+        node = node->right.get();
+      }
+    }
+    return node;
+  }
+
+  // drop the skipped elements once they are most of the tree
+  void compact() {
+    if(m_offset > CHUNK && m_offset * 2 > m_root->size) {
+      m_root = dropFront(m_root, m_offset);
+      m_offset = 0;
+    }
+  }
+
+  NodePtr m_root;
+  // elements at the front of the tree that are not part of this list
+  std::size_t m_offset = 0;
+};
+
+template<typename T>
+const std::size_t PersistentList<T>::CHUNK;
+
+#endif
@@ -0,0 +1,120 @@
+#include "catch.hpp"
+
+#include <random>
+#include <sstream>
+#include <vector>
+
+#include "persistent_list.hpp"
+#include "expression.hpp"
+#include "interpreter.hpp"
+
+// the elements of a list, in iteration order
+template<typename T>
+std::vector<T> elements(const PersistentList<T> & list) {
+  return std::vector<T>(list.begin(), list.end());
+}
+
+// the list and the vector hold the same elements
+template<typename T>
+bool matches(const PersistentList<T> & list, const std::vector<T> & model) {
+  if(list.size() != model.size()) return false;
+  for(std::size_t i = 0; i < model.size(); ++i) {
+    if(list[i] != model[i]) return false;
+  }
+  return elements(list) == model;
+}
+
+TEST_CASE( "Test persistent list operations", "[persistent_list]" ) {
+
+  PersistentList<int> empty;
+  REQUIRE(empty.empty());
+  REQUIRE(empty.begin() == empty.end());
+
+  std::vector<int> model;
+  for(int i = 0; i < 1000; ++i) model.push_back(i);
+  PersistentList<int> list{std::vector<int>(model)};
+  REQUIRE(matches(list, model));
+  REQUIRE(list.front() == 0);
+
+  INFO("rest and push_back leave the original unchanged")
+  PersistentList<int> tail = list.rest();
+  tail.push_back(1000);
+  REQUIRE(matches(list, model));
+  std::vector<int> tailModel(model.begin() + 1, model.end());
+  tailModel.push_back(1000);
+  REQUIRE(matches(tail, tailModel));
+
+  INFO("rest down to nothing")
+  PersistentList<int> shrinking = list;
+  for(std::size_t i = 0; i < model.size(); ++i) {
+    REQUIRE(shrinking.front() == static_cast<int>(i));
+    shrinking = shrinking.rest();
+  }
+  REQUIRE(shrinking.empty());
+  shrinking.push_back(7);
+  REQUIRE(matches(shrinking, std::vector<int>{7}));
+
+  INFO("join shares both sides")
+  PersistentList<int> joined = tail.join(list);
+  std::vector<int> joinedModel(tailModel);
+  joinedModel.insert(joinedModel.end(), model.begin(), model.end());
+  REQUIRE(matches(joined, joinedModel));
+  REQUIRE(matches(empty.join(list), model));
+  REQUIRE(matches(list.join(empty), model));
+}
+
+TEST_CASE( "Test persistent lists against a vector", "[persistent_list]" ) {
+
+  std::mt19937 random(3574);
+  std::vector<PersistentList<int>> lists(1);
+  std::vector<std::vector<int>> models(1);
+  for(int step = 0; step < 3000; ++step) {
+    std::size_t a = random() % lists.size();
+    std::size_t b = random() % lists.size();
+    PersistentList<int> list = lists[a];
+    std::vector<int> model = models[a];
+    switch(random() % 4) {
+    case 0:
+    case 1:
+      list.push_back(step);
+      model.push_back(step);
+      break;
+    case 2:
+      if(!model.empty()) {
+        list = list.rest();
+        model.erase(model.begin());
+      }
+      break;
+    default:
+      if(model.size() + models[b].size() < 20000) {
+        list = list.join(lists[b]);
+        model.insert(model.end(), models[b].begin(), models[b].end());
+      }
+    }
+    lists.push_back(list);
+    models.push_back(model);
+  }
+  bool all = true;
+  for(std::size_t i = 0; i < lists.size(); ++i) {
+    all = all && matches(lists[i], models[i]);
+  }
+  REQUIRE(all);
+}
+
+TEST_CASE( "Test list procedures on long lists", "[persistent_list]" ) {
+
+  Interpreter interp;
+  std::istringstream program(
+    "(begin"
+    " (define big (range 1 20000 1))"
+    " (define longer (append big 20001))"
+    " (list (apply + longer) (length (join big longer)) (first (rest (rest big))) (length big)))");
+  REQUIRE(interp.parseStream(program));
+  Expression result = interp.evaluate();
+  std::vector<Expression> values = elements(result.list());
+  REQUIRE(values.size() == 4);
+  REQUIRE(values[0] == Expression(200030001.));
+  REQUIRE(values[1] == Expression(40001.));
+  REQUIRE(values[2] == Expression(3.));
+  REQUIRE(values[3] == Expression(20000.));
+}
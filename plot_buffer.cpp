@@ -0,0 +1,72 @@
+#include "plot_buffer.hpp"
+
+#include <list>
+
+#include "expression.hpp"
+
+void PlotBuffer::addPoint(double x, double y, double size) {
+  pointX.push_back(x);
+  pointY.push_back(y);
+  pointSize.push_back(size);
+}
+
+void PlotBuffer::addLine(double x1, double y1, double x2, double y2, double thickness) {
+  lineX1.push_back(x1);
+  lineY1.push_back(y1);
+  lineX2.push_back(x2);
+  lineY2.push_back(y2);
+  lineThickness.push_back(thickness);
+}
+
+void PlotBuffer::addText(const std::string & str, double x, double y, double scale, double rotation) {
+  text.push_back(str);
+  textX.push_back(x);
+  textY.push_back(y);
+  textScale.push_back(scale);
+  textRotation.push_back(rotation);
+}
+
+// a point primitive as built by make-point
+Expression pointExpression(double x, double y) {
+  std::list<Expression> coords;
+  coords.push_back(Expression(Atom(x)));
+  coords.push_back(Expression(Atom(y)));
+  Expression point(coords);
+  point.set_prop(OBJECT_NAME_KEY, Expression(Atom("point\"")));
+  return point;
+}
+
+Expression PlotBuffer::toExpression() const {
+  std::list<Expression> primitives;
+  for(std::size_t i = 0; i < lineCount(); ++i) {
+    std::list<Expression> ends;
+    ends.push_back(pointExpression(lineX1[i], lineY1[i]));
+    ends.push_back(pointExpression(lineX2[i], lineY2[i]));
+    Expression line(ends);
+    line.set_prop(OBJECT_NAME_KEY, Expression(Atom("line\"")));
+    line.set_prop(THICKNESS_KEY, Expression(Atom(lineThickness[i])));
+    primitives.push_back(line);
+  }
+  for(std::size_t i = 0; i < pointCount(); ++i) {
+    Expression point = pointExpression(pointX[i], pointY[i]);
+    point.set_prop(SIZE_KEY, Expression(Atom(pointSize[i])));
+    primitives.push_back(point);
+  }
+  for(std::size_t i = 0; i < textCount(); ++i) {
+    Expression label(Atom(text[i] + '"'));
+    label.set_prop(OBJECT_NAME_KEY, Expression(Atom("text\"")));
+    label.set_prop(POSITION_KEY, pointExpression(textX[i], textY[i]));
+    label.set_prop(SCALE_KEY, Expression(Atom(textScale[i])));
+    label.set_prop(ROTATION_KEY, Expression(Atom(textRotation[i])));
+    primitives.push_back(label);
+  }
+  return Expression(primitives);
+}
+
+bool PlotBuffer::operator==(const PlotBuffer & other) const noexcept {
+  return pointX == other.pointX && pointY == other.pointY && pointSize == other.pointSize &&
+    lineX1 == other.lineX1 && lineY1 == other.lineY1 && lineX2 == other.lineX2 &&
+    lineY2 == other.lineY2 && lineThickness == other.lineThickness &&
+    text == other.text && textX == other.textX && textY == other.textY &&
+    textScale == other.textScale && textRotation == other.textRotation;
+}
@@ -0,0 +1,64 @@
+/*! \file plot_buffer.hpp
+Defines the PlotBuffer type holding the graphics primitives of a plot.
+ */
+#ifndef PLOT_BUFFER_HPP
+#define PLOT_BUFFER_HPP
+
+#include <string>
+#include <vector>
+
+class Expression;
+
+/*! \class PlotBuffer
+\brief Struct-of-arrays storage for the points, lines and text of a plot.
+
+discrete-plot and continuous-plot fill a PlotBuffer instead of building a
+list of point, line and text Expressions. The renderer walks the arrays
+directly; toExpression() rebuilds the equivalent list of primitives when
+a script wants to inspect the plot.
+
+All coordinates are in scene units, already scaled and with the ordinate
+flipped.
+ */
+class PlotBuffer {
+public:
+
+  /// add a point centered at (x, y) with diameter size
+  void addPoint(double x, double y, double size);
+
+  /// add a line from (x1, y1) to (x2, y2)
+  void addLine(double x1, double y1, double x2, double y2, double thickness);
+
+  /// add a text run centered at (x, y)
+  void addText(const std::string & str, double x, double y, double scale, double rotation);
+
+  /// number of points
+  std::size_t pointCount() const noexcept {return pointX.size();}
+
+  /// number of lines
+  std::size_t lineCount() const noexcept {return lineX1.size();}
+
+  /// number of text runs
+  std::size_t textCount() const noexcept {return text.size();}
+
+  /// total number of primitives
+  std::size_t size() const noexcept {return pointCount() + lineCount() + textCount();}
+
+  /// the plot as a list of point, line and text Expressions
+  Expression toExpression() const;
+
+  /// equality comparison of every primitive
+  bool operator==(const PlotBuffer & other) const noexcept;
+
+  // points
+  std::vector<double> pointX, pointY, pointSize;
+
+  // lines
+  std::vector<double> lineX1, lineY1, lineX2, lineY2, lineThickness;
+
+  // text runs, rotation is in radians
+  std::vector<std::string> text;
+  std::vector<double> textX, textY, textScale, textRotation;
+};
+
+#endif
@@ -0,0 +1,72 @@
+#include "catch.hpp"
+
+#include <string>
+#include <sstream>
+
+#include "interpreter.hpp"
+#include "plot_buffer.hpp"
+#include "semantic_error.hpp"
+
+Expression runPlot(const std::string & program){
+  Interpreter interp;
+  std::istringstream iss(program);
+  REQUIRE(interp.parseStream(iss));
+  return interp.evaluate();
+}
+
+TEST_CASE( "Test plot buffer primitives", "[plot_buffer]" ) {
+
+  PlotBuffer plot;
+  plot.addLine(0, 0, 1, 1, 0);
+  plot.addPoint(2, 3, 0.5);
+  plot.addText("label", 4, 5, 2, 0);
+  REQUIRE(plot.lineCount() == 1);
+  REQUIRE(plot.pointCount() == 1);
+  REQUIRE(plot.textCount() == 1);
+  REQUIRE(plot.size() == 3);
+
+  Expression list = plot.toExpression();
+  REQUIRE(list.isHeadList());
+  REQUIRE(list.listSize() == 3);
+
+  // lines, then points, then text
+  auto e = list.listConstBegin();
+  REQUIRE(e->find_prop(OBJECT_NAME_KEY)->head().asString() == "line");
+  REQUIRE(*e->find_prop(THICKNESS_KEY) == Expression(0.));
+  ++e;
+  REQUIRE(e->find_prop(OBJECT_NAME_KEY)->head().asString() == "point");
+  REQUIRE(*e->find_prop(SIZE_KEY) == Expression(0.5));
+  REQUIRE(*e->listConstBegin() == Expression(2.));
+  ++e;
+  REQUIRE(e->head().asString() == "label");
+  REQUIRE(*e->find_prop(SCALE_KEY) == Expression(2.));
+
+  PlotBuffer copy = plot;
+  REQUIRE(copy == plot);
+  copy.addPoint(0, 0, 0);
+  REQUIRE(!(copy == plot));
+}
+
+TEST_CASE( "Test plots are held as primitive buffers", "[plot_buffer]" ) {
+
+  std::string program = R"(
+(discrete-plot (list (list -1 -1) (list 1 1))
+ (list (list "title" "The Title")
+  (list "abscissa-label" "X Label")
+  (list "ordinate-label" "Y Label") ))
+)";
+  Expression result = runPlot(program);
+  REQUIRE(result.isHeadPlot());
+  const PlotBuffer * plot = result.plot();
+  REQUIRE(plot != nullptr);
+  // four bounding lines, the two axes and a stem per point
+  REQUIRE(plot->lineCount() == 8);
+  REQUIRE(plot->pointCount() == 2);
+  // four axis bound labels and the three option labels
+  REQUIRE(plot->textCount() == 7);
+  REQUIRE(plot->text[4] == "The Title");
+
+  INFO("list procedures see the plot as a list of primitives")
+  REQUIRE(runPlot("(length " + program + ")") == Expression(17.));
+  REQUIRE(runPlot("(length (map length (list " + program + ")))") == Expression(1.));
+}
@@ -0,0 +1,75 @@
+#include "plot_item.hpp"
+#include <QPainter>
+#include <QtMath>
+#include <cmath>
+
+#include "plot_buffer.hpp"
+
+PlotItem::PlotItem(const PlotBuffer & plot) {
+    //thickness is truncated to a whole pen width as in OutputWidget::printLine
+    for(std::size_t i = 0; i < plot.lineCount(); ++i) {
+        QLineF line(plot.lineX1[i], plot.lineY1[i], plot.lineX2[i], plot.lineY2[i]);
+        int thickness = plot.lineThickness[i];
+        m_lines[thickness].append(line);
+        qreal pad = thickness / 2.0;
+        m_bounds |= QRectF(line.p1(), line.p2()).normalized().adjusted(-pad, -pad, pad, pad);
+    }
+    for(std::size_t i = 0; i < plot.pointCount(); ++i) {
+        QPointF point(plot.pointX[i], plot.pointY[i]);
+        double size = plot.pointSize[i];
+        m_points[size].append(point);
+        m_bounds |= QRectF(point.x() - size / 2, point.y() - size / 2, size, size);
+    }
+    for(std::size_t i = 0; i < plot.textCount(); ++i) {
+        TextRun run;
+        run.source = QString::fromStdString(plot.text[i]);
+        run.center = QPointF(plot.textX[i], plot.textY[i]);
+        //scale is truncated as in OutputWidget::printText
+        run.scale = static_cast<int>(plot.textScale[i]);
+        run.rotation = (plot.textRotation[i] * 180) / M_PI;
+        m_text.append(run);
+    }
+}
+
+void PlotItem::layoutText() {
+    m_font = QFont("Courier");
+    m_font.setStyleHint(QFont::TypeWriter);
+    m_font.setPointSize(1);
+    for(auto & run : m_text) {
+        run.text = QStaticText(run.source);
+        run.text.setPerformanceHint(QStaticText::AggressiveCaching);
+        run.text.prepare(QTransform(), m_font);
+        //a square around the center covers the run at any rotation
+        QSizeF size = run.text.size() * run.scale;
+        qreal half = std::hypot(size.width(), size.height()) / 2;
+        m_bounds |= QRectF(run.center.x() - half, run.center.y() - half, 2 * half, 2 * half);
+    }
+}
+
+QRectF PlotItem::boundingRect() const {
+    return m_bounds;
+}
+
+void PlotItem::paint(QPainter * painter, const QStyleOptionGraphicsItem *, QWidget *) {
+    painter->setBrush(Qt::NoBrush);
+    for(auto & group : m_lines) {
+        painter->setPen(QPen(QBrush(QColor(Qt::black)), group.first));
+        painter->drawLines(group.second);
+    }
+    //a round pen as wide as the point diameter draws each point as a filled circle
+    for(auto & group : m_points) {
+        painter->setPen(QPen(QBrush(QColor(Qt::black)), group.first, Qt::SolidLine, Qt::RoundCap));
+        painter->drawPoints(group.second.constData(), group.second.size());
+    }
+    painter->setFont(m_font);
+    painter->setPen(QPen(QColor(Qt::black)));
+    for(auto & run : m_text) {
+        painter->save();
+        painter->translate(run.center);
+        painter->rotate(run.rotation);
+        painter->scale(run.scale, run.scale);
+        QSizeF size = run.text.size();
+        painter->drawStaticText(QPointF(-size.width() / 2, -size.height() / 2), run.text);
+        painter->restore();
+    }
+}
@@ -0,0 +1,44 @@
+#ifndef PLOT_ITEM_HPP
+#define PLOT_ITEM_HPP
+
+#include <QGraphicsItem>
+#include <QPen>
+#include <QFont>
+#include <QStaticText>
+#include <QVector>
+#include <QPointF>
+#include <QLineF>
+#include <map>
+
+class PlotBuffer;
+
+// draws every primitive of a plot as a single scene item, used for plots
+// too large to give each point, line and text run its own item
+//
+// The constructor only copies geometry, so it may run on the kernel thread.
+// Laying out the text needs the font machinery of the GUI thread and is
+// left to layoutText.
+class PlotItem: public QGraphicsItem {
+public:
+    PlotItem(const PlotBuffer & plot);
+    // lay out the text runs, on the GUI thread before the item is shown
+    void layoutText();
+    QRectF boundingRect() const override;
+    void paint(QPainter * painter, const QStyleOptionGraphicsItem * option, QWidget * widget) override;
+private:
+    struct TextRun {
+        QString source;
+        QStaticText text;
+        QPointF center;
+        qreal scale;
+        qreal rotation;
+    };
+    // primitives grouped by pen so each group is a single draw call
+    std::map<int, QVector<QLineF>> m_lines;
+    std::map<double, QVector<QPointF>> m_points;
+    QVector<TextRun> m_text;
+    QFont m_font;
+    QRectF m_bounds;
+};
+
+#endif
@@ -2,13 +2,18 @@
 #include <sstream>
 #include <iostream>
 #include <fstream>
+#include <iomanip>
 #include <thread>
 #include <atomic>
+#include <vector>
 #include "interpreter.hpp"
+#include "image.hpp"
 #include "semantic_error.hpp"
 #include "startup_config.hpp"
 #include "parseInterp.hpp"
 #include "interrupt.hpp"
+#include "kernelDaemon.hpp"
+#include "batchRunner.hpp"
 
 void prompt(){
     std::cout << "\nplotscript> ";
@@ -24,8 +29,9 @@ void info(const std::string & err_str){
     std::cout << "Info: " << err_str << std::endl;
 }
 
-int eval_from_stream(std::istream & stream){
+int eval_from_stream(std::istream & stream, const EvalLimits & limits){
     Interpreter interp;
+    interp.setLimits(limits);
     if(!interp.parseStream(stream)){
         error("Invalid Program. Could not parse.");
         return EXIT_FAILURE;
@@ -43,128 +49,322 @@ int eval_from_stream(std::istream & stream){
     return EXIT_SUCCESS;
 }
 
-int eval_from_file(std::string filename){
+// print the result of each top-level form as soon as it is evaluated
+int eval_streaming(std::string filename, const EvalLimits & limits){
+    // the parser may outlive this function, so it shares the stream
+    std::shared_ptr<std::istream> stream(&std::cin, [](std::istream *){});
+    if(filename != "-"){
+        stream = std::make_shared<std::ifstream>(filename);
+        if(!*stream){
+            error("Could not open file for reading.");
+            return EXIT_FAILURE;
+        }
+    }
+    Interpreter interp;
+    interp.setLimits(limits);
+    try{
+        if(!interp.evaluateStream(stream, [](const Expression & exp){ std::cout << exp << std::endl; })){
+            error("Invalid Program. Could not parse.");
+            return EXIT_FAILURE;
+        }
+    }
+    catch(const SemanticError & ex){
+        std::cerr << ex.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+int eval_from_file(std::string filename, const EvalLimits & limits){
+    std::ifstream ifs(filename);
+    if(!ifs){
+        error("Could not open file for reading.");
+        return EXIT_FAILURE;
+    }
+    return eval_from_stream(ifs, limits);
+}
+
+int make_image(std::string imagename, std::string filename){
     std::ifstream ifs(filename);
     if(!ifs){
         error("Could not open file for reading.");
         return EXIT_FAILURE;
     }
-    return eval_from_stream(ifs);
+    Interpreter interp;
+    if(!interp.parseStream(ifs)){
+        error("Invalid Program. Could not parse.");
+        return EXIT_FAILURE;
+    }
+    try{
+        interp.evaluate();
+    }
+    catch(const SemanticError & ex){
+        std::cerr << ex.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::ifstream source(filename, std::ios::binary);
+    if(!interp.saveImage(imagename, imageDigest(source))){
+        error("Could not write image.");
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
 }
 
-int eval_from_command(std::string argexp){
+int eval_from_command(std::string argexp, const EvalLimits & limits){
     std::istringstream expression(argexp);
-    return eval_from_stream(expression);
+    return eval_from_stream(expression, limits);
 }
 
-bool checkInterrupt(Interpreter *interp, parseQueue *pQ, resultQueue *rQ) {
-    if (global_status_flag > 0){
-        error("interpreter kernel interrupted");
-        interp->reset();
-        pQ->clear();
-        rQ->clear();
-        return true;
+// stop the kernel, start over from the startup environment and restart it
+void restartKernel(Interpreter *interp, parseInterp *pI, parseQueue *pQ, resultQueue *rQ) {
+    pI->stopThread(pQ);
+    // with the kernel stopped this thread is the only user of both queues
+    pQ->clear();
+    rQ->clear();
+    interp->reset();
+    loadStartup(interp);
+    pI->startThread(pQ, rQ, interp);
+}
+
+// wait for the result of request id, cntrl-c interrupts the evaluation
+// and the interrupt error arrives as its result
+parseResult waitForResult(std::uint64_t id, Interpreter *interp, resultQueue *rQ) {
+    parseResult result;
+    while(true) {
+        if(global_status_flag > 0) {
+            // a second cntrl-c interrupts again rather than exiting
+            global_status_flag = 0;
+            interp->interrupt(id);
+        }
+        // the timeout only bounds how late an interrupt is noticed
+        if(!rQ->wait_for_pop(result, std::chrono::milliseconds(10))) continue;
+        // results of abandoned requests are dropped
+        if(result.id == id) {
+            traceSpan(ResultHandoff, result.finished, TraceClock::now(), id);
+            return result;
+        }
     }
-    return false;
 }
 
 // A REPL is a repeated read-eval-print loop
-void repl(){
+void repl(const EvalLimits & limits){
+    traceThreadName("repl");
     Interpreter interp;
+    interp.setLimits(limits);
     bool kernalRunning(true);
-    std::atomic_bool solved(false);
     parseQueue pQ; resultQueue rQ;
     parseInterp pI;
-    pI.startThread(&pQ, &rQ, &solved, &interp);
-    std::string kill = "%%%%%";
+    loadStartup(&interp);
+    pI.startThread(&pQ, &rQ, &interp);
     while(!std::cin.eof()){
         global_status_flag = 0;
         prompt();
         std::string line = readline();
-        if (std::cin.fail() && kernalRunning) {
-            //cntrl-c here
-            error("interpreter kernel interrupted");
+        if (std::cin.fail()) {
+            // end of input rather than cntrl-c
+            if(global_status_flag == 0) break;
             std::cin.clear();
-            line.clear();
-            if(pI.size() > 0) {
-                pQ.push(kill);
-                pI.joinAll();
+            if(kernalRunning) {
+                error("interpreter kernel interrupted");
+                restartKernel(&interp, &pI, &pQ, &rQ);
             }
-            interp.reset();
-            pQ.clear();
-            rQ.clear();
-            pI.startThread(&pQ, &rQ, &solved, &interp);
             continue;
         }
         if(line.empty()) continue;
         if(line.front() == '%') {
             if(line == "%exit") {
-                pQ.push(kill);
-                pI.joinAll();
+                pI.stopThread(&pQ);
                 return;
             } else if(line == "%start") {
                 kernalRunning = true;
                 if(pI.size() == 0) {
-                    pI.startThread(&pQ, &rQ, &solved, &interp);
+                    pI.startThread(&pQ, &rQ, &interp);
                 }
                 continue;
             } else if(line == "%stop") {
                 kernalRunning = false;
-                if(pI.size() > 0) {
-                    pQ.push(kill);
-                    pI.joinAll();
-                }
+                pI.stopThread(&pQ);
                 continue;
             } else if(line == "%reset") {
-                if(pI.size() > 0) {
-                    pQ.push(kill);
-                    pI.joinAll();
-                }
+                pI.stopThread(&pQ);
                 interp.reset();
-                pI.startThread(&pQ, &rQ, &solved, &interp);
+                loadStartup(&interp);
+                pI.startThread(&pQ, &rQ, &interp);
                 continue;
-            }
-        }
-        if(kernalRunning) {
-            pQ.push(line);
-            Expression exp;
-            if(checkInterrupt(&interp, &pQ, &rQ)) {
-                if(pI.size() > 0) {
-                    pQ.push(kill);
-                    pI.joinAll();
+            } else if(line == "%stats") {
+                // read while the kernel runs, the queues are between the two threads
+                std::cout << Interpreter::stats()
+                          << std::left << std::setw(20) << "parse queue" << pQ.size() << "\n"
+                          << std::left << std::setw(20) << "result queue" << rQ.size() << std::endl;
+                continue;
+            } else if(line == "%trace") {
+                writeHistograms(std::cout);
+                continue;
+            } else if(line.compare(0, 6, "%save ") == 0) {
+                // the kernel is paused so the environment is not changing
+                bool running = pI.size() > 0;
+                pI.stopThread(&pQ);
+                if(!interp.saveImage(line.substr(6))) {
+                    error("Could not write image.");
+                }
+                if(running) pI.startThread(&pQ, &rQ, &interp);
+                continue;
+            } else if(line.compare(0, 6, "%load ") == 0) {
+                bool running = pI.size() > 0;
+                pI.stopThread(&pQ);
+                if(!interp.loadImage(line.substr(6))) {
+                    error("Could not load image.");
                 }
-                pI.startThread(&pQ, &rQ, &solved, &interp);
+                if(running) pI.startThread(&pQ, &rQ, &interp);
                 continue;
             }
-            std::this_thread::sleep_for(std::chrono::milliseconds(20));
-            if(solved) {
-                rQ.try_pop(exp);
-                std::cout << exp << std::endl;
+        }
+        if(kernalRunning) {
+            std::uint64_t id = interp.queueRequest();
+            pQ.push(parseRequest{id, line, TraceClock::now()});
+            parseResult result = waitForResult(id, &interp, &rQ);
+            TraceSpan render(Render, id);
+            if(result.ok) {
+                std::cout << result.exp << std::endl;
             } else {
-                continue;
+                std::cerr << result.error << std::endl;
             }
         } else {
             error("interpreter kernel not running");
         }
     }
-    pI.joinAll();
+    pI.stopThread(&pQ);
 }
 
+// serve sessions on a Unix socket until cntrl-c, -j sets the worker count
+int run_daemon(const std::vector<std::string> & args, const EvalLimits & limits){
+    unsigned workers = std::thread::hardware_concurrency();
+    if(args.size() == 4 && args[2] == "-j"){
+        std::istringstream count(args[3]);
+        if(!(count >> workers) || workers == 0){
+            error("Invalid worker count " + args[3]);
+            return EXIT_FAILURE;
+        }
+    }
+    else if(args.size() != 2){
+        error("Incorrect number of command line arguments.");
+        return EXIT_FAILURE;
+    }
+    kernelDaemon server(args[1], workers, limits);
+    return server.run();
+}
+
+// evaluate many scripts in parallel, each from a copy of the startup environment
+// --batch [-j N] [--out-dir DIR] [--manifest FILE] [file ...]
+int run_batch(const std::vector<std::string> & args, const EvalLimits & limits){
+    unsigned workers = std::thread::hardware_concurrency();
+    std::string outDir;
+    std::vector<std::string> files;
+    for(std::size_t i = 1; i < args.size(); ++i){
+        bool hasValue = i + 1 < args.size();
+        if(args[i] == "-j" && hasValue){
+            std::istringstream count(args[++i]);
+            if(!(count >> workers) || workers == 0){
+                error("Invalid worker count " + args[i]);
+                return EXIT_FAILURE;
+            }
+        }
+        else if(args[i] == "--out-dir" && hasValue){
+            outDir = args[++i];
+        }
+        else if(args[i] == "--manifest" && hasValue){
+            if(!readManifest(args[++i], files)){
+                error("Could not open manifest " + args[i]);
+                return EXIT_FAILURE;
+            }
+        }
+        else{
+            files.push_back(args[i]);
+        }
+    }
+    if(files.empty()){
+        error("No scripts to evaluate.");
+        return EXIT_FAILURE;
+    }
+    auto start = std::chrono::steady_clock::now();
+    Interpreter interp;
+    loadStartup(&interp);
+    Environment startup = interp.environment();
+    startup.freeze();
+    std::vector<batchResult> results = runBatch(files, startup, workers, limits, outDir);
+    printBatchSummary(std::cout, results, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    for(auto &r : results){
+        if(!r.ok) return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+// the options that select a mode rather than set a limit
+bool is_mode(const std::string & arg){
+    return arg == "--make-image" || arg == "--daemon" || arg == "--batch" || arg == "--stream";
+}
+
+// with --trace, writes the trace and prints the stage histograms as main returns
+class traceWriter {
+public:
+    void start(const std::string & file) {
+        filename = file;
+        startTracing();
+    }
+    ~traceWriter() {
+        if(filename.empty()) return;
+        if(!saveTrace(filename)) error("Could not write trace " + filename);
+        writeHistograms(std::cerr);
+    }
+private:
+    std::string filename;
+};
+
 int main(int argc, char *argv[]) {
     install_handler();
-    if(argc == 2){
-        return eval_from_file(argv[1]);
+    // the budget options come first and apply to every evaluation
+    EvalLimits limits;
+    traceWriter trace;
+    std::vector<std::string> args(argv + 1, argv + argc);
+    while(args.size() >= 2 && args[0].compare(0, 2, "--") == 0 && !is_mode(args[0])) {
+        if(args[0] == "--trace") {
+            trace.start(args[1]);
+        } else if(!parseLimit(args[0], args[1], limits)) {
+            error("Invalid option " + args[0] + " " + args[1]);
+            return EXIT_FAILURE;
+        }
+        args.erase(args.begin(), args.begin() + 2);
+    }
+    if(!args.empty() && args[0] == "--daemon"){
+        return run_daemon(args, limits);
+    }
+    if(!args.empty() && args[0] == "--batch"){
+        return run_batch(args, limits);
+    }
+    if(args.size() == 1){
+        return eval_from_file(args[0], limits);
+    }
+    else if(args.size() == 2){
+        if(args[0] == "-e"){
+            return eval_from_command(args[1], limits);
+        }
+        else if(args[0] == "--stream"){
+            return eval_streaming(args[1], limits);
+        }
+        else{
+            error("Incorrect number of command line arguments.");
+        }
     }
-    else if(argc == 3){
-        if(std::string(argv[1]) == "-e"){
-            return eval_from_command(argv[2]);
+    else if(args.size() == 3){
+        if(args[0] == "--make-image"){
+            return make_image(args[1], args[2]);
         }
         else{
             error("Incorrect number of command line arguments.");
         }
     }
     else{
-        repl();
+        repl(limits);
     }
     return EXIT_SUCCESS;
 }
@@ -0,0 +1,121 @@
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "interpreter.hpp"
+#include "semantic_error.hpp"
+#include "stats.hpp"
+
+// heap allocations of the process, counted by the replaced operator new
+std::atomic<std::uint64_t> allocations(0);
+std::atomic<std::uint64_t> allocatedBytes(0);
+
+void * operator new(std::size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+    if(size == 0) size = 1;
+    while(true) {
+        if(void * block = std::malloc(size)) return block;
+        std::new_handler handler = std::get_new_handler();
+        if(!handler) throw std::bad_alloc();
+        handler();
+    }
+}
+
+void operator delete(void * block) noexcept {
+    std::free(block);
+}
+
+void error(const std::string & err_str){
+    std::cerr << "Error: " << err_str << std::endl;
+}
+
+// the result of evaluating one script
+struct benchResult {
+    double seconds = 0;
+    std::uint64_t allocations = 0;
+    std::uint64_t allocatedBytes = 0;
+    StatsSnapshot stats;
+};
+
+// parse and evaluate program in a fresh interpreter, as plotscript <script> does
+bool runOnce(const std::string & program, benchResult & result){
+    std::uint64_t startAllocations = allocations;
+    std::uint64_t startBytes = allocatedBytes;
+    StatsSnapshot startStats = Interpreter::stats();
+    auto start = std::chrono::steady_clock::now();
+    {
+        Interpreter interp;
+        std::istringstream stream(program);
+        if(!interp.parseStream(stream)){
+            error("Invalid Program. Could not parse.");
+            return false;
+        }
+        try{
+            interp.evaluate();
+        }
+        catch(const SemanticError & ex){
+            std::cerr << ex.what() << std::endl;
+            return false;
+        }
+    }
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    result.allocations = allocations - startAllocations;
+    result.allocatedBytes = allocatedBytes - startBytes;
+    StatsSnapshot stats = Interpreter::stats();
+    for(int i = 0; i < STAT_COUNTERS; ++i) result.stats.counts[i] = stats.counts[i] - startStats.counts[i];
+    return true;
+}
+
+// plotscript_bench [-n repeats] <script>...
+// prints one JSON object per script: the best time of the repeats, and the
+// heap allocations and interpreter counters of the first run
+int main(int argc, char *argv[]){
+    std::vector<std::string> args(argv + 1, argv + argc);
+    int repeats = 1;
+    if(args.size() >= 2 && args[0] == "-n"){
+        std::istringstream count(args[1]);
+        if(!(count >> repeats) || repeats < 1){
+            error("Invalid repeat count " + args[1]);
+            return EXIT_FAILURE;
+        }
+        args.erase(args.begin(), args.begin() + 2);
+    }
+    if(args.empty()){
+        error("Usage: plotscript_bench [-n repeats] <script>...");
+        return EXIT_FAILURE;
+    }
+    for(auto & script : args){
+        std::ifstream ifs(script);
+        if(!ifs){
+            error("Could not open file for reading.");
+            return EXIT_FAILURE;
+        }
+        std::ostringstream program;
+        program << ifs.rdbuf();
+        benchResult first, run;
+        double best = 0;
+        for(int i = 0; i < repeats; ++i){
+            if(!runOnce(program.str(), i == 0 ? first : run)){
+                return EXIT_FAILURE;
+            }
+            double seconds = (i == 0 ? first : run).seconds;
+            if(i == 0 || seconds < best) best = seconds;
+        }
+        std::cout << "{\"script\": \"" << script << "\", \"seconds\": " << best
+                  << ", \"allocations\": " << first.allocations
+                  << ", \"allocated_bytes\": " << first.allocatedBytes
+                  << ", \"expression_copies\": " << first.stats[ExpressionCopies]
+                  << ", \"environment_copies\": " << first.stats[EnvironmentCopies]
+                  << ", \"symbol_lookups\": " << first.stats[SymbolLookups]
+                  << ", \"lambda_calls\": " << first.stats[LambdaCalls]
+                  << ", \"evaluation_steps\": " << first.stats[EvalSteps]
+                  << ", \"list_elements\": " << first.stats[ListElements] << "}" << std::endl;
+    }
+    return EXIT_SUCCESS;
+}
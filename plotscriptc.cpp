@@ -0,0 +1,36 @@
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+#include "transpile.hpp"
+
+void error(const std::string & err_str){
+    std::cerr << "Error: " << err_str << std::endl;
+}
+
+// plotscriptc <script.pls> <output.cpp>
+int main(int argc, char *argv[]){
+    if(argc != 3){
+        error("Usage: plotscriptc <script> <output.cpp>");
+        return EXIT_FAILURE;
+    }
+    std::ifstream ifs(argv[1]);
+    if(!ifs){
+        error("Could not open file for reading.");
+        return EXIT_FAILURE;
+    }
+    // write only once the whole program translated
+    std::ostringstream source;
+    if(!transpile(ifs, source, argv[1])){
+        error("Invalid Program. Could not parse.");
+        return EXIT_FAILURE;
+    }
+    std::ofstream out(argv[2]);
+    out << source.str();
+    if(!out){
+        error("Could not write output.");
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
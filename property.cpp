@@ -0,0 +1,125 @@
+#include "property.hpp"
+
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+
+#include "semantic_error.hpp"
+
+/***********************************************************************
+Key table
+**********************************************************************/
+
+struct KeyTable {
+  std::mutex lock;
+  std::unordered_map<std::string, PropertyKey> keys;
+  std::deque<std::string> names;
+
+  KeyTable() {
+    // must match the order of the *_KEY constants
+    for(auto name : {"object-name", "size", "thickness", "position", "scale", "rotation"}) {
+      keys.emplace(name, names.size());
+      names.emplace_back(name);
+    }
+  }
+};
+
+static KeyTable & keyTable() {
+  static KeyTable table;
+  return table;
+}
+
+// keys this thread has looked up, valid for good since keys are never removed,
+// so repeated lookups take no lock
+static std::unordered_map<std::string, PropertyKey> & knownKeys() {
+  static thread_local std::unordered_map<std::string, PropertyKey> known;
+  return known;
+}
+
+// the shapes made so far, besides the empty one
+static std::atomic<std::size_t> shapeCount(0);
+
+PropertyKey internKey(const std::string & name) {
+  auto & known = knownKeys();
+  auto cached = known.find(name);
+  if(cached != known.end()) return cached->second;
+  KeyTable & table = keyTable();
+  std::lock_guard<std::mutex> guard(table.lock);
+  auto found = table.keys.find(name);
+  if(found != table.keys.end()) {
+    known.emplace(name, found->second);
+    return found->second;
+  }
+  if(table.names.size() >= MAX_PROPERTY_KEYS) {
+    throw SemanticError("Error: too many distinct property names");
+  }
+  PropertyKey key = table.names.size();
+  table.keys.emplace(name, key);
+  table.names.push_back(name);
+  known.emplace(name, key);
+  return key;
+}
+
+bool findKey(const std::string & name, PropertyKey & key) {
+  auto & known = knownKeys();
+  auto cached = known.find(name);
+  if(cached != known.end()) {
+    key = cached->second;
+    return true;
+  }
+  KeyTable & table = keyTable();
+  std::lock_guard<std::mutex> guard(table.lock);
+  auto found = table.keys.find(name);
+  if(found == table.keys.end()) return false;
+  key = found->second;
+  known.emplace(name, key);
+  return true;
+}
+
+std::string keyName(PropertyKey key) {
+  KeyTable & table = keyTable();
+  std::lock_guard<std::mutex> guard(table.lock);
+  return key < table.names.size() ? table.names[key] : std::string();
+}
+
+/***********************************************************************
+PropertyShape
+**********************************************************************/
+
+const PropertyShape * PropertyShape::empty() {
+  static const PropertyShape * root = new PropertyShape();
+  return root;
+}
+
+const PropertyShape * PropertyShape::child(PropertyKey key) const noexcept {
+  for(const Transition * t = m_transitions.load(std::memory_order_acquire); t; t = t->next) {
+    if(t->key == key) return t->child;
+  }
+  return nullptr;
+}
+
+const PropertyShape * PropertyShape::with(PropertyKey key) const {
+  if(const PropertyShape * found = child(key)) return found;
+  std::lock_guard<std::mutex> guard(m_adding);
+  // another thread may have added it while we waited
+  if(const PropertyShape * found = child(key)) return found;
+  if(shapeCount.fetch_add(1) >= MAX_PROPERTY_SHAPES) {
+    shapeCount.fetch_sub(1);
+    throw SemanticError("Error: too many distinct sets of properties");
+  }
+  PropertyShape * added = new PropertyShape();
+  added->m_keys = m_keys;
+  added->m_keys.push_back(key);
+  // published whole, readers following the list see a finished shape
+  m_transitions.store(new Transition{key, added, m_transitions.load(std::memory_order_relaxed)},
+                      std::memory_order_release);
+  return added;
+}
+
+int PropertyShape::indexOf(PropertyKey key) const noexcept {
+  // shapes hold a handful of keys, a linear scan beats any index
+  for(std::size_t i = 0; i < m_keys.size(); ++i) {
+    if(m_keys[i] == key) return static_cast<int>(i);
+  }
+  return -1;
+}
@@ -0,0 +1,113 @@
+/*! \file property.hpp
+Defines interned property keys and the property shapes shared between
+expressions.
+
+Property names are interned once into small integer keys. The set of keys
+an expression carries, in insertion order, is its shape. Shapes are
+immutable and shared: every expression that was given the same keys in the
+same order points at the same shape and stores only an array of values.
+ */
+#ifndef PROPERTY_HPP
+#define PROPERTY_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/*! \typedef PropertyKey
+\brief An interned property name.
+*/
+typedef std::uint32_t PropertyKey;
+
+/// the most property names that can be interned, names are never freed
+const std::size_t MAX_PROPERTY_KEYS = 1 << 16;
+
+/// the most property shapes that can exist, shapes are never freed
+const std::size_t MAX_PROPERTY_SHAPES = 1 << 20;
+
+// keys used by the graphics primitives, interned before any others
+const PropertyKey OBJECT_NAME_KEY = 0;
+const PropertyKey SIZE_KEY = 1;
+const PropertyKey THICKNESS_KEY = 2;
+const PropertyKey POSITION_KEY = 3;
+const PropertyKey SCALE_KEY = 4;
+const PropertyKey ROTATION_KEY = 5;
+
+/*! Intern a property name.
+  \param name the property name (without quotes)
+  \return the key for name, the same key for every call with the same name
+  \throws SemanticError if name is new and MAX_PROPERTY_KEYS names are interned
+ */
+PropertyKey internKey(const std::string & name);
+
+/*! Look up a property name without interning it.
+  \param name the property name (without quotes)
+  \param key set to the key for name if it has been interned
+  \return true if name has been interned
+ */
+bool findKey(const std::string & name, PropertyKey & key);
+
+/*! The name a key was interned from.
+  \param key a key returned by internKey
+  \return the property name
+ */
+std::string keyName(PropertyKey key);
+
+/*! \class PropertyShape
+\brief An immutable ordered set of property keys.
+
+Shapes form a transition tree rooted at the empty shape; adding a key to a
+shape always yields the same child shape. Shapes are never destroyed, so
+their number is capped at MAX_PROPERTY_SHAPES. Following an existing
+transition takes no lock, only adding one locks the shape it starts from.
+ */
+class PropertyShape {
+public:
+
+  /// the shape with no keys
+  static const PropertyShape * empty();
+
+  /*! The shape with key appended.
+    \param key the key to add, must not already be in this shape
+    \return the shared shape
+    \throws SemanticError if the shape is new and MAX_PROPERTY_SHAPES exist
+   */
+  const PropertyShape * with(PropertyKey key) const;
+
+  /// index of the value for key, or -1 if key is not in this shape
+  int indexOf(PropertyKey key) const noexcept;
+
+  /// number of keys in the shape
+  std::size_t size() const noexcept {return m_keys.size();}
+
+  /// the key stored at index
+  PropertyKey keyAt(std::size_t index) const noexcept {return m_keys[index];}
+
+private:
+  PropertyShape() {}
+  PropertyShape(const PropertyShape &) = delete;
+  PropertyShape & operator=(const PropertyShape &) = delete;
+
+  // an added key and its child shape, immutable once published
+  struct Transition {
+    PropertyKey key;
+    const PropertyShape * child;
+    const Transition * next;
+  };
+
+  // the child shape for key, nullptr if there is none yet
+  const PropertyShape * child(PropertyKey key) const noexcept;
+
+  // the keys in insertion order
+  std::vector<PropertyKey> m_keys;
+
+  // child shapes, newest first, read without locking
+  mutable std::atomic<const Transition *> m_transitions{nullptr};
+
+  // serializes adding transitions to this shape
+  mutable std::mutex m_adding;
+};
+
+#endif
@@ -0,0 +1,73 @@
+#include "catch.hpp"
+
+#include <thread>
+#include <vector>
+
+#include "property.hpp"
+#include "expression.hpp"
+
+TEST_CASE( "Test property key interning", "[property]" ) {
+
+  REQUIRE(internKey("object-name") == OBJECT_NAME_KEY);
+  REQUIRE(internKey("size") == SIZE_KEY);
+  REQUIRE(internKey("rotation") == ROTATION_KEY);
+
+  PropertyKey a = internKey("property_tests-key");
+  REQUIRE(internKey("property_tests-key") == a);
+  REQUIRE(keyName(a) == "property_tests-key");
+
+  PropertyKey found;
+  REQUIRE(findKey("property_tests-key", found));
+  REQUIRE(found == a);
+  REQUIRE(!findKey("property_tests-never-interned", found));
+}
+
+TEST_CASE( "Test shared property shapes", "[property]" ) {
+
+  const PropertyShape * empty = PropertyShape::empty();
+  REQUIRE(empty->size() == 0);
+  REQUIRE(empty->indexOf(SIZE_KEY) == -1);
+
+  const PropertyShape * point = empty->with(OBJECT_NAME_KEY)->with(SIZE_KEY);
+  REQUIRE(point == empty->with(OBJECT_NAME_KEY)->with(SIZE_KEY));
+  REQUIRE(point != empty->with(SIZE_KEY)->with(OBJECT_NAME_KEY));
+  REQUIRE(point->size() == 2);
+  REQUIRE(point->indexOf(OBJECT_NAME_KEY) == 0);
+  REQUIRE(point->indexOf(SIZE_KEY) == 1);
+  REQUIRE(point->keyAt(1) == SIZE_KEY);
+
+  INFO("threads adding the same keys at once share one shape")
+  PropertyKey key = internKey("property_tests-concurrent");
+  std::vector<const PropertyShape *> shapes(4);
+  std::vector<std::thread> threads;
+  for(std::size_t t = 0; t < shapes.size(); ++t) {
+    threads.emplace_back([&shapes, point, key, t]() {
+      for(int i = 0; i < 1000; ++i) shapes[t] = point->with(ROTATION_KEY)->with(key);
+    });
+  }
+  for(auto & thread : threads) thread.join();
+  for(auto shape : shapes) REQUIRE(shape == shapes[0]);
+  REQUIRE(shapes[0]->indexOf(key) == 3);
+}
+
+TEST_CASE( "Test expression properties", "[property]" ) {
+
+  Expression exp(Atom(1.0));
+  REQUIRE(exp.propSize() == 0);
+  REQUIRE(exp.find_prop(SIZE_KEY) == nullptr);
+
+  exp.set_prop(SIZE_KEY, Expression(2.0));
+  exp.set_prop(Expression(Atom("thickness\"")), Expression(3.0));
+  REQUIRE(exp.propSize() == 2);
+  REQUIRE(*exp.find_prop(SIZE_KEY) == Expression(2.0));
+  REQUIRE(exp.get_prop(Expression(Atom("thickness\"")), exp) == Expression(3.0));
+
+  INFO("overwriting keeps the shape")
+  exp.set_prop(SIZE_KEY, Expression(4.0));
+  REQUIRE(exp.propSize() == 2);
+  REQUIRE(*exp.find_prop(SIZE_KEY) == Expression(4.0));
+
+  INFO("copies carry their properties")
+  Expression copy = exp;
+  REQUIRE(*copy.find_prop(THICKNESS_KEY) == Expression(3.0));
+}
@@ -0,0 +1,162 @@
+#include "reduce.hpp"
+
+#include <complex>
+
+#include "eval_context.hpp"
+#include "expression.hpp"
+#include "lazy_range.hpp"
+#include "semantic_error.hpp"
+
+namespace {
+
+// thrown by a partial for an element it cannot reduce
+struct NotANumber {};
+
+// a compensated sum, complex once any element is
+struct SumPartial {
+  NeumaierSum real, imag;
+  bool complex = false;
+
+  void add(std::size_t, double x) {real.add(x);}
+
+  void add(std::size_t i, const Expression & e) {
+    if(e.isHeadNumber()) {
+      add(i, e.head().asNumber());
+    } else if(e.isHeadComplex()) {
+      complex = true;
+      real.add(e.head().asComplex().real());
+      imag.add(e.head().asComplex().imag());
+    } else {
+      throw NotANumber();
+    }
+  }
+
+  void merge(const SumPartial & other) {
+    real.add(other.real);
+    imag.add(other.imag);
+    complex = complex || other.complex;
+  }
+};
+
+// a product, complex once any element is
+struct ProductPartial {
+  std::complex<double> value = 1;
+  bool complex = false;
+
+  void add(std::size_t, double x) {value *= x;}
+
+  void add(std::size_t i, const Expression & e) {
+    if(e.isHeadNumber()) {
+      add(i, e.head().asNumber());
+    } else if(e.isHeadComplex()) {
+      complex = true;
+      value *= e.head().asComplex();
+    } else {
+      throw NotANumber();
+    }
+  }
+
+  void merge(const ProductPartial & other) {
+    // real products stay clear of the inf * 0 of a complex multiply
+    if(!complex && !other.complex) {
+      value = value.real() * other.value.real();
+    } else {
+      value *= other.value;
+      complex = true;
+    }
+  }
+};
+
+// the least or greatest element seen and its index, the earliest of equals
+template<bool Greatest>
+struct ExtremumPartial {
+  double value = 0;
+  std::size_t index = 0;
+  bool any = false;
+
+  void add(std::size_t i, double x) {
+    if(!any || (Greatest ? x > value : x < value)) {
+      value = x;
+      index = i;
+      any = true;
+    }
+  }
+
+  void add(std::size_t i, const Expression & e) {
+    if(!e.isHeadNumber()) throw NotANumber();
+    add(i, e.head().asNumber());
+  }
+
+  // other holds elements after those of this partial
+  void merge(const ExtremumPartial & other) {
+    if(other.any && (!any || (Greatest ? other.value > value : other.value < value))) *this = other;
+  }
+};
+
+// Reduce the elements of a list. A range is generated in one pass, since
+// each of its elements is accumulated from the previous one, stored lists
+// go through treeReduce.
+template<typename Partial>
+Partial reduceList(const Expression & list) {
+  if(const LazyRange * range = list.lazyRange()) {
+    Partial partial;
+    std::size_t i = 0;
+    range->forEach([&partial, &i](double x) {
+      if(i % 4096 == 0) safepoint();
+      partial.add(i, x);
+      ++i;
+    });
+    return partial;
+  }
+  const PersistentList<Expression> & elements = list.list();
+  return treeReduce<Partial>(elements.size(),
+    [&elements](std::size_t begin, std::size_t end) {
+      safepoint();
+      Partial partial;
+      auto e = elements.iteratorAt(begin);
+      for(std::size_t i = begin; i < end; ++i, ++e) partial.add(i, *e);
+      return partial;
+    },
+    [](Partial left, const Partial & right) {
+      left.merge(right);
+      return left;
+    });
+}
+
+template<bool Greatest>
+Expression extremum(const Expression & list, bool index) {
+  ExtremumPartial<Greatest> result = reduceList<ExtremumPartial<Greatest>>(list);
+  return Expression(Atom(index ? double(result.index) : result.value));
+}
+
+}
+
+Expression listSum(const Expression & list) {
+  SumPartial result;
+  try {
+    result = reduceList<SumPartial>(list);
+  } catch(const NotANumber &) {
+    throw SemanticError("Error: Argument to sum is not a list of numbers.");
+  }
+  if(result.complex) return Expression(Atom(result.real.value(), result.imag.value()));
+  return Expression(Atom(result.real.value()));
+}
+
+Expression listProduct(const Expression & list) {
+  ProductPartial result;
+  try {
+    result = reduceList<ProductPartial>(list);
+  } catch(const NotANumber &) {
+    throw SemanticError("Error: Argument to product is not a list of numbers.");
+  }
+  if(result.complex) return Expression(Atom(result.value));
+  return Expression(Atom(result.value.real()));
+}
+
+Expression listExtremum(const Expression & list, bool greatest, bool index, const std::string & name) {
+  try {
+    return greatest ? extremum<true>(list, index) : extremum<false>(list, index);
+  } catch(const NotANumber &) {
+    throw SemanticError("Error: Argument to " + name + " is not a list of real numbers.");
+  }
+}
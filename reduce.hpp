@@ -0,0 +1,151 @@
+/*! \file reduce.hpp
+Defines the numeric reductions behind sum, product, min, max, argmin and argmax.
+ */
+#ifndef REDUCE_HPP
+#define REDUCE_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include "eval_context.hpp"
+#include "parallel_eval.hpp"
+
+class Expression;
+
+/*! \class NeumaierSum
+\brief A compensated running sum.
+
+Keeps the low order bits lost by each addition in a separate compensation
+term (Neumaier's variant of Kahan summation), so the error does not grow
+with the number of terms.
+ */
+class NeumaierSum {
+public:
+
+  /// add x to the sum
+  void add(double x) noexcept {
+    double t = m_sum + x;
+    if(std::abs(m_sum) >= std::abs(x)) {
+      m_compensation += (m_sum - t) + x;
+    } else {
+      m_compensation += (x - t) + m_sum;
+    }
+    m_sum = t;
+  }
+
+  /// add another partial sum to this one
+  void add(const NeumaierSum & other) noexcept {
+    add(other.m_sum);
+    m_compensation += other.m_compensation;
+  }
+
+  /// the compensated sum
+  double value() const noexcept {return m_sum + m_compensation;}
+
+private:
+  double m_sum = 0;
+  double m_compensation = 0;
+};
+
+/// reductions split their input into blocks of this many elements
+const std::size_t REDUCE_BLOCK = 1 << 16;
+
+/*! Reduce the elements [0, size) block by block, then combine the partial
+  results of adjacent blocks pairwise in a fixed tree order. With more than
+  one block, and an evaluation allowed more than one thread, the blocks are
+  shared out between this thread and the threads reserveThreads grants.
+  Each of those polls the token and deadline of the evaluation. The blocks
+  and the tree only depend on size, so the result is the same on any
+  machine and with any number of threads.
+  \param size the number of elements
+  \param reduceBlock called with (begin, end), returns the Partial of the block
+  \param combine called with the Partials of two adjacent ranges, left first
+  \return the Partial of all the elements
+  \throws whatever reduceBlock throws, after every thread is joined
+ */
+template<typename Partial, typename Block, typename Combine>
+Partial treeReduce(std::size_t size, Block reduceBlock, Combine combine) {
+  std::size_t blocks = std::max<std::size_t>(1, (size + REDUCE_BLOCK - 1) / REDUCE_BLOCK);
+  if(blocks == 1) return reduceBlock(0, size);
+
+  std::vector<Partial> partials(blocks);
+  unsigned extra = reserveThreads(static_cast<unsigned>(blocks - 1));
+  std::vector<std::exception_ptr> errors(extra + 1);
+  // blocks after a failure are skipped, the error is all the caller sees
+  std::atomic_bool failed(false);
+  std::atomic<std::size_t> next(0);
+  auto work = [&](std::size_t thread) {
+    try {
+      for(std::size_t b = next++; b < blocks && !failed; b = next++) {
+        partials[b] = reduceBlock(b * REDUCE_BLOCK, std::min(size, (b + 1) * REDUCE_BLOCK));
+      }
+    } catch(...) {
+      errors[thread] = std::current_exception();
+      failed = true;
+    }
+  };
+  EvalContext * context = EvalContext::active();
+  EvalLimits left = extra ? context->left() : EvalLimits();
+  std::vector<std::uint64_t> steps(extra + 1, 0), bytes(extra + 1, 0);
+  std::vector<std::thread> pool;
+  for(unsigned t = 1; t <= extra; ++t) {
+    try {
+      pool.emplace_back([&, t]() {
+        EvalContext part(*context, left);
+        work(t);
+        steps[t] = part.steps();
+        bytes[t] = part.bytes();
+      });
+    } catch(const std::system_error &) {
+      // the others share the blocks
+      break;
+    }
+  }
+  work(0);
+  for(auto & t : pool) t.join();
+  releaseThreads(extra);
+  for(unsigned t = 1; t <= extra; ++t) context->absorb(steps[t], bytes[t]);
+  for(auto & e : errors) {
+    if(e) std::rethrow_exception(e);
+  }
+
+  while(partials.size() > 1) {
+    std::vector<Partial> next;
+    for(std::size_t i = 0; i + 1 < partials.size(); i += 2) {
+      next.push_back(combine(partials[i], partials[i + 1]));
+    }
+    if(partials.size() % 2 == 1) next.push_back(partials.back());
+    partials.swap(next);
+  }
+  return partials.front();
+}
+
+/*! The compensated sum of a list of numbers, complex if any element is.
+  \throws SemanticError if an element is not a number
+ */
+Expression listSum(const Expression & list);
+
+/*! The product of a list of numbers, complex if any element is.
+  \throws SemanticError if an element is not a number
+ */
+Expression listProduct(const Expression & list);
+
+/*! The least or greatest element of a list of real numbers, or its index.
+  The first of equal elements is the one chosen.
+  \param list a non-empty list
+  \param greatest true for the greatest element, false for the least
+  \param index true for the (zero based) index of the element instead
+  \param name the procedure, for error messages
+  \throws SemanticError if an element is not a real number
+ */
+Expression listExtremum(const Expression & list, bool greatest, bool index, const std::string & name);
+
+#endif
@@ -0,0 +1,147 @@
+#include "catch.hpp"
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "reduce.hpp"
+#include "expression.hpp"
+#include "interpreter.hpp"
+#include "semantic_error.hpp"
+
+Expression evalReduce(Interpreter & interp, const std::string & program){
+  std::istringstream iss(program);
+  REQUIRE(interp.parseStream(iss));
+  return interp.evaluate();
+}
+
+TEST_CASE( "Test compensated summation", "[reduce]" ) {
+
+  NeumaierSum sum;
+  sum.add(1e16);
+  sum.add(1);
+  sum.add(-1e16);
+  REQUIRE(sum.value() == 1);
+
+  NeumaierSum left, right;
+  left.add(1e16);
+  right.add(1);
+  right.add(-1e16);
+  left.add(right);
+  REQUIRE(left.value() == 1);
+}
+
+TEST_CASE( "Test tree reduction over blocks", "[reduce]" ) {
+
+  std::size_t size = 3 * REDUCE_BLOCK + 17;
+  double total = treeReduce<double>(size,
+    [](std::size_t begin, std::size_t end) {
+      double partial = 0;
+      for(std::size_t i = begin; i < end; ++i) partial += i;
+      return partial;
+    },
+    [](double left, double right) { return left + right; });
+  REQUIRE(total == double(size) * (size - 1) / 2);
+
+  INFO("the partials are combined left to right")
+  std::vector<std::size_t> order = treeReduce<std::vector<std::size_t>>(size,
+    [](std::size_t begin, std::size_t) { return std::vector<std::size_t>(1, begin); },
+    [](std::vector<std::size_t> left, const std::vector<std::size_t> & right) {
+      left.insert(left.end(), right.begin(), right.end());
+      return left;
+    });
+  REQUIRE(order == std::vector<std::size_t>({0, REDUCE_BLOCK, 2 * REDUCE_BLOCK, 3 * REDUCE_BLOCK}));
+
+  INFO("an error in any block reaches the caller")
+  REQUIRE_THROWS_AS(treeReduce<double>(size,
+    [](std::size_t begin, std::size_t) -> double {
+      if(begin == 2 * REDUCE_BLOCK) throw SemanticError("Error: block");
+      return 0;
+    },
+    [](double left, double right) { return left + right; }), SemanticError);
+
+  INFO("with threads allowed the result is the same, and every thread polls the evaluation")
+  CancellationToken token;
+  EvalLimits limits;
+  limits.parallel = 4;
+  {
+    EvalContext context(token, limits);
+    double parallel = treeReduce<double>(size,
+      [](std::size_t begin, std::size_t end) {
+        double partial = 0;
+        for(std::size_t i = begin; i < end; ++i) partial += i;
+        return partial;
+      },
+      [](double left, double right) { return left + right; });
+    REQUIRE(parallel == total);
+    REQUIRE(reserveThreads(3) == 3);
+    releaseThreads(3);
+
+    token.cancel();
+    REQUIRE_THROWS_AS(treeReduce<double>(size,
+      [](std::size_t, std::size_t) { safepoint(); return 0.; },
+      [](double left, double right) { return left + right; }), InterruptError);
+  }
+}
+
+TEST_CASE( "Test numeric reductions", "[reduce]" ) {
+
+  Interpreter interp;
+
+  REQUIRE(evalReduce(interp, "(sum (list 1 2 3 4))") == Expression(10.));
+  REQUIRE(evalReduce(interp, "(sum (list))") == Expression(0.));
+  REQUIRE(evalReduce(interp, "(sum (list 1e16 1 -1e16))") == Expression(1.));
+  REQUIRE(evalReduce(interp, "(sum (list 1 I))") == Expression(Atom(1, 1)));
+  REQUIRE(evalReduce(interp, "(product (list 1 2 3 4))") == Expression(24.));
+  REQUIRE(evalReduce(interp, "(product (list))") == Expression(1.));
+  REQUIRE(evalReduce(interp, "(product (list 2 I))") == Expression(Atom(0, 2)));
+
+  REQUIRE(evalReduce(interp, "(min (list 3 -1 4 -1 5))") == Expression(-1.));
+  REQUIRE(evalReduce(interp, "(max (list 3 -1 5 4 5))") == Expression(5.));
+  INFO("the first of equal elements is chosen")
+  REQUIRE(evalReduce(interp, "(argmin (list 3 -1 4 -1 5))") == Expression(1.));
+  REQUIRE(evalReduce(interp, "(argmax (list 3 -1 5 4 5))") == Expression(2.));
+
+  INFO("ranges are reduced without building them")
+  REQUIRE(evalReduce(interp, "(sum (range 1 100 1))") == Expression(5050.));
+  REQUIRE(evalReduce(interp, "(argmax (range -5 5 0.5))") == Expression(20.));
+
+  INFO("large lists are reduced in blocks")
+  evalReduce(interp, "(define big (append (range 1 200000 1) 0))");
+  REQUIRE(evalReduce(interp, "(sum big)") == Expression(200000. * 200001. / 2));
+  REQUIRE(evalReduce(interp, "(min big)") == Expression(0.));
+  REQUIRE(evalReduce(interp, "(argmin big)") == Expression(200000.));
+  REQUIRE(evalReduce(interp, "(argmax big)") == Expression(199999.));
+
+  REQUIRE_THROWS_AS(evalReduce(interp, "(sum 1)"), SemanticError);
+  REQUIRE_THROWS_AS(evalReduce(interp, "(sum (list 1 \"a\"))"), SemanticError);
+  REQUIRE_THROWS_AS(evalReduce(interp, "(min (list))"), SemanticError);
+  REQUIRE_THROWS_AS(evalReduce(interp, "(max (list 1 I))"), SemanticError);
+  REQUIRE_THROWS_AS(evalReduce(interp, "(argmin (list 1) (list 2))"), SemanticError);
+}
+
+TEST_CASE( "Test fold and reduce", "[reduce]" ) {
+
+  Interpreter interp;
+
+  REQUIRE(evalReduce(interp, "(fold + 0 (list 1 2 3))") == Expression(6.));
+  REQUIRE(evalReduce(interp, "(fold - 0 (list 1 2 3))") == Expression(-6.));
+  REQUIRE(evalReduce(interp, "(fold + 5 (list))") == Expression(5.));
+  REQUIRE(evalReduce(interp, "(reduce * (range 1 5 1))") == Expression(120.));
+  REQUIRE(evalReduce(interp, "(reduce - (list 7))") == Expression(7.));
+
+  INFO("lambdas get the accumulator then the element")
+  evalReduce(interp, "(define push (lambda (acc x) (append acc x)))");
+  Expression pushed = evalReduce(interp, "(fold push (list) (list 1 2 3))");
+  REQUIRE(pushed.listSize() == 3);
+  REQUIRE(pushed.list()[0] == Expression(1.));
+  REQUIRE(pushed.list()[2] == Expression(3.));
+  evalReduce(interp, "(define f (lambda (a b) (- (* 10 a) b)))");
+  REQUIRE(evalReduce(interp, "(reduce f (list 1 2 3))") == Expression(77.));
+
+  REQUIRE_THROWS_AS(evalReduce(interp, "(fold + 0)"), SemanticError);
+  REQUIRE_THROWS_AS(evalReduce(interp, "(fold 1 0 (list 1))"), SemanticError);
+  REQUIRE_THROWS_AS(evalReduce(interp, "(fold + 0 1)"), SemanticError);
+  REQUIRE_THROWS_AS(evalReduce(interp, "(reduce + (list))"), SemanticError);
+  REQUIRE_THROWS_AS(evalReduce(interp, "(reduce undefined (list 1))"), SemanticError);
+}
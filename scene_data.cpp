@@ -0,0 +1,170 @@
+#include "scene_data.hpp"
+#include <QtMath>
+#include <sstream>
+
+#include "plot_buffer.hpp"
+#include "plot_item.hpp"
+
+// plots with more primitives than this are drawn by a single PlotItem
+const std::size_t BATCH_THRESHOLD = 1000;
+
+SceneData::SceneData(const Expression & result) {
+    build(result);
+}
+
+SceneData::~SceneData() {
+    clear();
+}
+
+PlotItem * SceneData::takeBatch(SceneItem & item) {
+    PlotItem * batch = item.batch;
+    item.batch = nullptr;
+    return batch;
+}
+
+void SceneData::clear() {
+    for(auto & item : items)
+        delete item.batch;
+    items.clear();
+}
+
+void SceneData::fail(const QString & error) {
+    //an invalid primitive replaces everything before it with the error
+    clear();
+    addPlain(error);
+}
+
+void SceneData::build(const Expression & exp) {
+    if(exp.isHeadPlot()) {
+        addPlot(*exp.plot());
+        return;
+    }
+    const Expression * prop = exp.find_prop(OBJECT_NAME_KEY);
+    std::string objname = prop ? prop->head().asString() : std::string();
+    if(objname == "point") {
+        addPoint(exp);
+    } else if(objname == "line") {
+        addLine(exp);
+    } else if(objname == "text") {
+        addText(exp);
+    } else if(exp.head().asSymbol() == "lambda") {
+        //definitions draw nothing
+        return;
+    } else if(exp.isHeadList()) {
+        for(auto e = exp.listConstBegin(); e != exp.listConstEnd(); ++e)
+            build(*e);
+    } else if(exp.isHeadNumber() || exp.isHeadComplex() || exp.isHeadString() || exp.isHeadNone() || exp.isHeadSymbol()) {
+        std::ostringstream out;
+        out << exp;
+        addPlain(QString::fromStdString(out.str()));
+    }
+}
+
+void SceneData::addPoint(const Expression & exp) {
+    const Expression * sizeExp = exp.find_prop(SIZE_KEY);
+    double size = 0;
+    if(sizeExp && !sizeExp->isHeadNone()) {
+        size = sizeExp->head().asNumber();
+        if(size < 0) {
+            fail("Error: size is invalid number.");
+            return;
+        }
+    }
+    SceneItem item;
+    item.kind = SceneItem::Point;
+    item.rect = QRectF(QPointF(), QSizeF(size, size));
+    item.rect.moveCenter(makePoint(exp));
+    items.push_back(item);
+}
+
+void SceneData::addLine(const Expression & exp) {
+    SceneItem item;
+    item.kind = SceneItem::Line;
+    item.line = QLineF(makePoint(*exp.listConstBegin()), makePoint(*std::next(exp.listConstBegin())));
+    const Expression * thickExp = exp.find_prop(THICKNESS_KEY);
+    if(thickExp && !thickExp->isHeadNone()) {
+        item.thickness = thickExp->head().asNumber();
+        if(item.thickness < 0) {
+            fail("Error: thickness is invalid number.");
+            return;
+        }
+    }
+    items.push_back(item);
+}
+
+void SceneData::addText(const Expression & exp) {
+    SceneItem item;
+    item.kind = SceneItem::Text;
+    std::ostringstream out;
+    out << exp.head();
+    item.text = QString::fromStdString(out.str());
+    const Expression * posExp = exp.find_prop(POSITION_KEY);
+    if(posExp && !posExp->isHeadNone()) {
+        const Expression * posName = posExp->find_prop(OBJECT_NAME_KEY);
+        if(!posName || posName->head().asString() != "point") {
+            fail("Error: positon is not a point.");
+            return;
+        }
+        item.pos = makePoint(*posExp);
+    }
+    const Expression * scaleExp = exp.find_prop(SCALE_KEY);
+    if(scaleExp && !scaleExp->isHeadNone()) {
+        item.scale = scaleExp->head().asNumber();
+        if(item.scale < 0) {
+            fail("Error: scale is invalid");
+            return;
+        }
+    }
+    const Expression * rotExp = exp.find_prop(ROTATION_KEY);
+    if(rotExp && !rotExp->isHeadNone()) {
+        item.centered = true;
+        item.rotation = (rotExp->head().asNumber() * 180) / M_PI;
+    }
+    items.push_back(item);
+}
+
+void SceneData::addPlot(const PlotBuffer & plot) {
+    if(plot.size() > BATCH_THRESHOLD) {
+        SceneItem item;
+        item.kind = SceneItem::Batch;
+        item.batch = new PlotItem(plot);
+        items.push_back(item);
+        return;
+    }
+    for(std::size_t i = 0; i < plot.lineCount(); ++i) {
+        SceneItem item;
+        item.kind = SceneItem::Line;
+        item.line = QLineF(plot.lineX1[i], plot.lineY1[i], plot.lineX2[i], plot.lineY2[i]);
+        item.thickness = plot.lineThickness[i];
+        items.push_back(item);
+    }
+    for(std::size_t i = 0; i < plot.pointCount(); ++i) {
+        SceneItem item;
+        item.kind = SceneItem::Point;
+        double size = plot.pointSize[i];
+        item.rect = QRectF(QPointF(), QSizeF(size, size));
+        item.rect.moveCenter(QPointF(plot.pointX[i], plot.pointY[i]));
+        items.push_back(item);
+    }
+    for(std::size_t i = 0; i < plot.textCount(); ++i) {
+        SceneItem item;
+        item.kind = SceneItem::Text;
+        item.text = QString::fromStdString(plot.text[i]);
+        item.pos = QPointF(plot.textX[i], plot.textY[i]);
+        item.scale = plot.textScale[i];
+        item.rotation = (plot.textRotation[i] * 180) / M_PI;
+        item.centered = true;
+        items.push_back(item);
+    }
+}
+
+void SceneData::addPlain(const QString & text) {
+    SceneItem item;
+    item.kind = SceneItem::Plain;
+    item.text = text;
+    items.push_back(item);
+}
+
+QPointF SceneData::makePoint(const Expression & exp) {
+    return QPointF(exp.listConstBegin()->head().asNumber(), std::next(exp.listConstBegin())->head().asNumber());
+}
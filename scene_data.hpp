@@ -0,0 +1,53 @@
+#ifndef SCENE_DATA_HPP
+#define SCENE_DATA_HPP
+
+#include <QLineF>
+#include <QRectF>
+#include <QPointF>
+#include <QString>
+#include <vector>
+#include "expression.hpp"
+
+class PlotItem;
+
+// one graphics item of a result, in the order it is added to the scene
+struct SceneItem {
+    enum Kind {Line, Point, Text, Plain, Batch};
+    Kind kind;
+    QLineF line;
+    int thickness = 1;
+    QRectF rect;
+    QString text;
+    QPointF pos;
+    int scale = 1;
+    qreal rotation = 0;
+    // rotation and scale are about the center of the text
+    bool centered = false;
+    PlotItem * batch = nullptr;
+};
+
+// the render-ready geometry of a result, built off the GUI thread so that
+// the output widget only has to create the items
+class SceneData {
+public:
+    SceneData() {}
+    SceneData(const Expression & result);
+    ~SceneData();
+    std::vector<SceneItem> items;
+    // hand the batched plot items to the caller, who takes ownership
+    PlotItem * takeBatch(SceneItem & item);
+private:
+    SceneData(const SceneData &) = delete;
+    SceneData & operator=(const SceneData &) = delete;
+    void build(const Expression & exp);
+    void addPoint(const Expression & exp);
+    void addLine(const Expression & exp);
+    void addText(const Expression & exp);
+    void addPlot(const PlotBuffer & plot);
+    void addPlain(const QString & text);
+    void fail(const QString & error);
+    void clear();
+    QPointF makePoint(const Expression & exp);
+};
+
+#endif
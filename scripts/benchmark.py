@@ -0,0 +1,138 @@
+"""Run the workload corpus and compare it with a stored baseline.
+
+Each script in the corpus is run through the plotscript executable, which
+gives the wall time and peak resident set size of the whole program, and
+through plotscript_bench, which runs it in-process against the interpreter
+library and counts heap allocations and interpreter activity. A workload
+regresses when a measure exceeds its baseline by more than the tolerance.
+
+    python3 scripts/benchmark.py --build build
+    python3 scripts/benchmark.py --build build --update
+"""
+
+import argparse
+import glob
+import json
+import os
+import subprocess
+import sys
+import time
+
+# measures that vary from run to run, compared with --tolerance
+NOISY = ['seconds', 'max_rss_kb']
+
+# measures that only change with the code, compared with --count-tolerance
+COUNTS = ['allocations', 'allocated_bytes', 'expression_copies',
+          'environment_copies', 'symbol_lookups', 'lambda_calls',
+          'evaluation_steps', 'list_elements']
+
+
+def run_binary(plotscript, script, repeat):
+    """The best wall time and largest peak RSS of running plotscript script."""
+    best = None
+    rss = 0
+    for _ in range(repeat):
+        start = time.monotonic()
+        proc = subprocess.Popen([plotscript, script], stdout=subprocess.DEVNULL)
+        _, status, usage = os.wait4(proc.pid, 0)
+        elapsed = time.monotonic() - start
+        # reaped by wait4, so Popen must not wait for it again
+        proc.returncode = status
+        if status != 0:
+            sys.exit('error: {} failed on {}'.format(plotscript, script))
+        best = elapsed if best is None else min(best, elapsed)
+        rss = max(rss, usage.ru_maxrss)
+    return {'seconds': best, 'max_rss_kb': rss}
+
+
+def run_library(bench, script, repeat):
+    """The allocation and interpreter counts of running script in-process."""
+    output = subprocess.run([bench, '-n', str(repeat), script],
+                            stdout=subprocess.PIPE, universal_newlines=True)
+    if output.returncode != 0:
+        sys.exit('error: {} failed on {}'.format(bench, script))
+    result = json.loads(output.stdout)
+    return {name: result[name] for name in COUNTS}
+
+
+def measure(build, corpus, repeat):
+    plotscript = os.path.join(build, 'plotscript')
+    bench = os.path.join(build, 'plotscript_bench')
+    results = {}
+    for script in sorted(glob.glob(os.path.join(corpus, '*.pls'))):
+        name = os.path.splitext(os.path.basename(script))[0]
+        results[name] = run_binary(plotscript, script, repeat)
+        results[name].update(run_library(bench, script, 1))
+    return results
+
+
+def compare(results, baseline, tolerance, count_tolerance):
+    """Print each measure against its baseline, return the regressions."""
+    regressions = []
+    print('{:<18} {:<20} {:>14} {:>14} {:>8}'.format(
+        'workload', 'measure', 'baseline', 'current', 'change'))
+    for name in sorted(set(results) | set(baseline)):
+        if name not in results:
+            regressions.append('{} is in the baseline but not the corpus'.format(name))
+            continue
+        if name not in baseline:
+            regressions.append('{} has no baseline, run with --update'.format(name))
+            continue
+        for measure in NOISY + COUNTS:
+            allowed = tolerance if measure in NOISY else count_tolerance
+            old = baseline[name][measure]
+            new = results[name][measure]
+            change = (new - old) / old if old else (1.0 if new else 0.0)
+            flag = ''
+            if change > allowed:
+                flag = '  REGRESSED'
+                regressions.append('{} {} rose {:+.1%}'.format(name, measure, change))
+            print('{:<18} {:<20} {:>14.6g} {:>14.6g} {:>+7.1%}{}'.format(
+                name, measure, old, new, change, flag))
+    return regressions
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('--build', default='build',
+                        help='directory holding plotscript and plotscript_bench')
+    parser.add_argument('--corpus', default=os.path.join('tests', 'bench'),
+                        help='directory of .pls workloads')
+    parser.add_argument('--baseline', default=None,
+                        help='baseline file, baseline.json in the corpus by default')
+    parser.add_argument('--repeat', type=int, default=3,
+                        help='runs of each workload, the best time is kept')
+    parser.add_argument('--tolerance', type=float, default=0.10,
+                        help='allowed rise in time and peak RSS')
+    parser.add_argument('--count-tolerance', type=float, default=0.01,
+                        help='allowed rise in allocation and interpreter counts')
+    parser.add_argument('--update', action='store_true',
+                        help='write the results as the new baseline')
+    args = parser.parse_args()
+    baseline_file = args.baseline or os.path.join(args.corpus, 'baseline.json')
+
+    results = measure(args.build, args.corpus, args.repeat)
+    if not results:
+        sys.exit('error: no workloads in {}'.format(args.corpus))
+
+    if args.update:
+        with open(baseline_file, 'w') as out:
+            json.dump(results, out, indent=2, sort_keys=True)
+            out.write('\n')
+        print('wrote {} workloads to {}'.format(len(results), baseline_file))
+        return
+
+    with open(baseline_file) as f:
+        baseline = json.load(f)
+    regressions = compare(results, baseline, args.tolerance, args.count_tolerance)
+    if regressions:
+        print()
+        for regression in regressions:
+            print('regression: ' + regression)
+        sys.exit(1)
+    print()
+    print('no regressions in {} workloads'.format(len(results)))
+
+
+if __name__ == '__main__':
+    main()
@@ -17,4 +17,22 @@ public:
   SemanticError(const std::string& message): std::runtime_error(message){};
 };
 
+/*! \class InterruptError
+\brief Exception thrown when an evaluation is cancelled at a safepoint
+ */
+class InterruptError: public SemanticError {
+public:
+  /// Construct the interrupt exception
+  InterruptError(): SemanticError("Error: interpreter kernel interrupted"){};
+};
+
+/*! \class LimitError
+\brief Exception thrown when an evaluation exhausts its time, step or memory budget
+ */
+class LimitError: public SemanticError {
+public:
+  /// Construct an exeption with a given message
+  LimitError(const std::string& message): SemanticError(message){};
+};
+
 #endif
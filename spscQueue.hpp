@@ -0,0 +1,141 @@
+#ifndef SPSCQUEUE_HPP
+#define SPSCQUEUE_HPP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+// A bounded single-producer/single-consumer ring buffer.
+//
+// One thread pushes and one thread pops. Values are moved in and out of
+// preallocated slots. push and pop only touch two atomic indices unless
+// the queue is full or empty, in which case the caller sleeps on a
+// condition variable until the other side makes progress. A full queue
+// blocks the producer, which is the backpressure on the pipeline.
+template<typename T>
+class spscQueue {
+public:
+    // capacity is rounded up to a power of two
+    explicit spscQueue(std::size_t capacity = 64) {
+        std::size_t size = 1;
+        while(size < capacity) size <<= 1;
+        m_slots.resize(size);
+        m_mask = size - 1;
+    }
+
+    spscQueue(const spscQueue &) = delete;
+    spscQueue & operator=(const spscQueue &) = delete;
+
+    std::size_t capacity() const {
+        return m_slots.size();
+    }
+
+    // the number of queued values, exact only on the producer or consumer thread
+    std::size_t size() const {
+        // the head first, the tail read after it is never behind it
+        std::size_t head = m_head.load(std::memory_order_acquire);
+        return m_tail.load(std::memory_order_acquire) - head;
+    }
+
+    // sequentially consistent, as the wait for a value relies on it
+    bool empty() const {
+        return m_head.load(std::memory_order_seq_cst) == m_tail.load(std::memory_order_seq_cst);
+    }
+
+    // producer: push unless full
+    bool try_push(T && value) {
+        std::size_t tail = m_tail.load(std::memory_order_relaxed);
+        if(tail - m_head.load(std::memory_order_acquire) == m_slots.size()) {
+            return false;
+        }
+        m_slots[tail & m_mask] = std::move(value);
+        m_tail.store(tail + 1, std::memory_order_seq_cst);
+        wake(m_consumerWaiting, m_notEmpty);
+        return true;
+    }
+
+    // producer: push, waiting while the queue is full
+    void push(T && value) {
+        while(!try_push(std::move(value))) {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_producerWaiting.store(true, std::memory_order_seq_cst);
+            m_notFull.wait(lock, [this]{ return !full(); });
+            m_producerWaiting.store(false, std::memory_order_relaxed);
+        }
+    }
+
+    // consumer: pop unless empty
+    bool try_pop(T & value) {
+        std::size_t head = m_head.load(std::memory_order_relaxed);
+        if(head == m_tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+        value = std::move(m_slots[head & m_mask]);
+        m_head.store(head + 1, std::memory_order_seq_cst);
+        wake(m_producerWaiting, m_notFull);
+        return true;
+    }
+
+    // consumer: pop, waiting while the queue is empty
+    void wait_and_pop(T & value) {
+        while(!try_pop(value)) {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_consumerWaiting.store(true, std::memory_order_seq_cst);
+            m_notEmpty.wait(lock, [this]{ return !empty(); });
+            m_consumerWaiting.store(false, std::memory_order_relaxed);
+        }
+    }
+
+    // consumer: wait at most timeout for a value, false if none arrived
+    template<typename Rep, typename Period>
+    bool wait_for_pop(T & value, const std::chrono::duration<Rep, Period> & timeout) {
+        if(try_pop(value)) return true;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_consumerWaiting.store(true, std::memory_order_seq_cst);
+            m_notEmpty.wait_for(lock, timeout, [this]{ return !empty(); });
+            m_consumerWaiting.store(false, std::memory_order_relaxed);
+        }
+        return try_pop(value);
+    }
+
+    // consumer: drop everything queued
+    void clear() {
+        T temp;
+        while(try_pop(temp)) {}
+    }
+
+private:
+    bool full() const {
+        return m_tail.load(std::memory_order_seq_cst) - m_head.load(std::memory_order_seq_cst) == m_slots.size();
+    }
+
+    // The waker stores an index then loads the waiting flag, the waiter
+    // stores the flag then loads the indices in empty() or full(). All four
+    // are sequentially consistent, so they cannot be reordered and either
+    // the waiter sees the new index or we see its flag.
+    void wake(std::atomic_bool & waiting, std::condition_variable & cv) {
+        if(waiting.load(std::memory_order_seq_cst)) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            cv.notify_one();
+        }
+    }
+
+    std::vector<T> m_slots;
+    std::size_t m_mask;
+    // next slot to pop, written only by the consumer
+    std::atomic<std::size_t> m_head{0};
+    // next slot to push, written only by the producer
+    std::atomic<std::size_t> m_tail{0};
+    std::mutex m_mutex;
+    std::condition_variable m_notEmpty;
+    std::condition_variable m_notFull;
+    std::atomic_bool m_consumerWaiting{false};
+    std::atomic_bool m_producerWaiting{false};
+};
+
+#endif
@@ -0,0 +1,77 @@
+#include "stats.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <mutex>
+#include <vector>
+
+#include "eval_context.hpp"
+
+// the blocks of running threads and the counts of exited ones
+struct StatRegistry {
+  std::mutex mutex;
+  std::vector<StatBlock *> blocks;
+  std::uint64_t retired[STAT_COUNTERS] = {};
+};
+
+StatRegistry & statRegistry() {
+  // never destroyed, threads may exit after static destruction starts
+  static StatRegistry * registry = new StatRegistry;
+  return *registry;
+}
+
+const char * const STAT_NAMES[STAT_COUNTERS] = {
+  "expression copies", "environment copies", "symbol lookups",
+  "lambda calls", "evaluation steps", "list elements"
+};
+
+// owns the block of a thread, registered while the thread runs
+class ThreadStats {
+public:
+  ThreadStats() {
+    for(auto & count : block.counts) count.store(0, std::memory_order_relaxed);
+    StatRegistry & registry = statRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    registry.blocks.push_back(&block);
+  }
+
+  // keep the counts once the thread exits
+  ~ThreadStats() {
+    StatRegistry & registry = statRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    for(int i = 0; i < STAT_COUNTERS; ++i) {
+      registry.retired[i] += block.counts[i].load(std::memory_order_relaxed);
+    }
+    registry.blocks.erase(std::find(registry.blocks.begin(), registry.blocks.end(), &block));
+  }
+
+  StatBlock block;
+};
+
+StatBlock * threadStats() {
+  static thread_local ThreadStats stats;
+  return &stats.block;
+}
+
+std::uint64_t StatsSnapshot::listBytes() const noexcept {
+  return counts[ListElements] * EvalContext::ELEMENT_BYTES;
+}
+
+StatsSnapshot readStats() {
+  StatsSnapshot stats;
+  StatRegistry & registry = statRegistry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  for(int i = 0; i < STAT_COUNTERS; ++i) {
+    stats.counts[i] = registry.retired[i];
+    for(auto block : registry.blocks) stats.counts[i] += block->counts[i].load(std::memory_order_relaxed);
+  }
+  return stats;
+}
+
+std::ostream & operator<<(std::ostream & out, const StatsSnapshot & stats) {
+  for(int i = 0; i < STAT_COUNTERS; ++i) {
+    out << std::left << std::setw(20) << STAT_NAMES[i] << stats.counts[i] << "\n";
+  }
+  out << std::left << std::setw(20) << "list bytes" << stats.listBytes() << "\n";
+  return out;
+}
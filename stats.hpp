@@ -0,0 +1,69 @@
+/*! \file stats.hpp
+Defines the always-on counters of interpreter activity.
+
+The counters are process wide and read while evaluations are running, to
+see what a slow session is spending its time on. Each thread counts into a
+block of its own, so counting is an unshared relaxed store; reading sums
+the blocks of the running threads and what exited threads counted.
+ */
+#ifndef STATS_HPP
+#define STATS_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+
+/// The events counted
+enum StatCounter {
+  ExpressionCopies,   ///< Expressions copy constructed or copy assigned
+  EnvironmentCopies,  ///< Environments copied, as for every lambda call
+  SymbolLookups,      ///< symbols looked up in an Environment
+  LambdaCalls,        ///< lambdas called by the tree walking evaluator
+  EvalSteps,          ///< Expression::eval calls
+  ListElements,       ///< list elements created, as charged to the memory limit
+  STAT_COUNTERS
+};
+
+/*! \struct StatsSnapshot
+\brief The counters at one point in time.
+ */
+struct StatsSnapshot {
+  /// the count of each StatCounter
+  std::uint64_t counts[STAT_COUNTERS] = {};
+
+  /// the count of counter
+  std::uint64_t operator[](StatCounter counter) const noexcept {return counts[counter];}
+
+  /// bytes of list storage created, as charged to the memory limit
+  std::uint64_t listBytes() const noexcept;
+};
+
+/*! \struct StatBlock
+\brief The counters of one thread, only written by that thread.
+ */
+struct StatBlock {
+  /// the counts, atomic only so other threads can read them
+  std::atomic<std::uint64_t> counts[STAT_COUNTERS];
+};
+
+/*! The block of this thread, registered for readStats until the thread
+  exits. Called once per thread.
+ */
+StatBlock * threadStats();
+
+/// Count count events of counter on this thread.
+inline void countStat(StatCounter counter, std::uint64_t count = 1) {
+  // a plain pointer, so the common path has no thread local guard to check
+  static thread_local StatBlock * block = nullptr;
+  if(!block) block = threadStats();
+  std::atomic<std::uint64_t> & value = block->counts[counter];
+  value.store(value.load(std::memory_order_relaxed) + count, std::memory_order_relaxed);
+}
+
+/// The sum of the counters of every thread since the process started.
+StatsSnapshot readStats();
+
+/// Write one counter per line, its name and its count.
+std::ostream & operator<<(std::ostream & out, const StatsSnapshot & stats);
+
+#endif
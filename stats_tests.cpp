@@ -0,0 +1,44 @@
+#include "catch.hpp"
+
+#include <string>
+#include <sstream>
+#include <thread>
+
+#include "interpreter.hpp"
+#include "stats.hpp"
+
+Expression evalCounted(Interpreter & interp, const std::string & program){
+  std::istringstream iss(program);
+  REQUIRE(interp.parseStream(iss));
+  return interp.evaluate();
+}
+
+TEST_CASE( "Test counting interpreter activity", "[stats]" ) {
+
+  Interpreter interp;
+  evalCounted(interp, "(define f (lambda (x) (+ x 1)))");
+
+  StatsSnapshot before = Interpreter::stats();
+  REQUIRE(evalCounted(interp, "(f (length (list 1 2 3)))") == Expression(4.));
+  StatsSnapshot after = Interpreter::stats();
+
+  REQUIRE(after[LambdaCalls] == before[LambdaCalls] + 1);
+  REQUIRE(after[ListElements] == before[ListElements] + 3);
+  REQUIRE(after.listBytes() - before.listBytes() == 3 * EvalContext::ELEMENT_BYTES);
+  REQUIRE(after[EvalSteps] > before[EvalSteps]);
+  REQUIRE(after[SymbolLookups] > before[SymbolLookups]);
+  REQUIRE(after[EnvironmentCopies] > before[EnvironmentCopies]);
+  REQUIRE(after[ExpressionCopies] > before[ExpressionCopies]);
+
+  INFO("the counts of exited threads are kept")
+  std::thread worker([]() {
+    countStat(LambdaCalls, 5);
+  });
+  worker.join();
+  REQUIRE(Interpreter::stats()[LambdaCalls] == after[LambdaCalls] + 5);
+
+  std::ostringstream out;
+  out << after;
+  REQUIRE(out.str().find("lambda calls") != std::string::npos);
+  REQUIRE(out.str().find("list bytes") != std::string::npos);
+}
@@ -1,8 +1,16 @@
 #include "token.hpp"
 
 // system includes
-#include <cctype>
+#include <cstdint>
+#include <cstring>
 #include <iostream>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 // define constants for special characters
 const char OPENCHAR = '(';
@@ -41,45 +49,277 @@ void store_ifnot_empty(std::string & token, TokenSequenceType & seq){
   }
 }
 
-TokenSequenceType tokenize(std::istream & seq){
-  TokenSequenceType tokens;
-  std::string token;
-  bool iQ = false;
-  while(true){
-    char c = seq.get();
-    if(seq.eof()) break;
-    if(c == COMMENTCHAR){
-      // chomp until the end of the line
-      while((!seq.eof()) && (c != '\n')){
-          c = seq.get();
-      }
-      if(seq.eof()) break;
+// the characters of one block, bit i for character i
+struct BlockMasks {
+  std::uint64_t open = 0;
+  std::uint64_t close = 0;
+  std::uint64_t quote = 0;
+  std::uint64_t comment = 0;
+  std::uint64_t newline = 0;
+  std::uint64_t space = 0;
+};
+
+const std::size_t BLOCK = 64;
+
+#if defined(__AVX2__)
+
+std::uint64_t matches(__m256i low, __m256i high, __m256i c){
+  std::uint32_t lo = static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(low, c)));
+  std::uint32_t hi = static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(high, c)));
+  return lo | (static_cast<std::uint64_t>(hi) << 32);
+}
+
+// isspace in the C locale: ' ' and '\t' to '\r'
+std::uint32_t spaces(__m256i v){
+  __m256i control = _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8('\t' - 1)),
+                                     _mm256_cmpgt_epi8(_mm256_set1_epi8('\r' + 1), v));
+  __m256i space = _mm256_or_si256(control, _mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')));
+  return static_cast<std::uint32_t>(_mm256_movemask_epi8(space));
+}
+
+BlockMasks classify(const char * block){
+  __m256i low = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(block));
+  __m256i high = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(block + 32));
+  BlockMasks masks;
+  masks.open = matches(low, high, _mm256_set1_epi8(OPENCHAR));
+  masks.close = matches(low, high, _mm256_set1_epi8(CLOSECHAR));
+  masks.quote = matches(low, high, _mm256_set1_epi8(QUOTECHAR));
+  masks.comment = matches(low, high, _mm256_set1_epi8(COMMENTCHAR));
+  masks.newline = matches(low, high, _mm256_set1_epi8('\n'));
+  masks.space = spaces(low) | (static_cast<std::uint64_t>(spaces(high)) << 32);
+  return masks;
+}
+
+#elif defined(__SSE2__)
+
+std::uint64_t matches(const __m128i * parts, __m128i c){
+  std::uint64_t mask = 0;
+  for(unsigned i = 0; i < 4; ++i){
+    std::uint64_t part = static_cast<std::uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(parts[i], c)));
+    mask |= part << (16 * i);
+  }
+  return mask;
+}
+
+// isspace in the C locale: ' ' and '\t' to '\r'
+std::uint64_t spaces(const __m128i * parts){
+  std::uint64_t mask = 0;
+  for(unsigned i = 0; i < 4; ++i){
+    __m128i control = _mm_and_si128(_mm_cmpgt_epi8(parts[i], _mm_set1_epi8('\t' - 1)),
+                                    _mm_cmplt_epi8(parts[i], _mm_set1_epi8('\r' + 1)));
+    __m128i space = _mm_or_si128(control, _mm_cmpeq_epi8(parts[i], _mm_set1_epi8(' ')));
+    std::uint64_t part = static_cast<std::uint16_t>(_mm_movemask_epi8(space));
+    mask |= part << (16 * i);
+  }
+  return mask;
+}
+
+BlockMasks classify(const char * block){
+  __m128i parts[4];
+  for(unsigned i = 0; i < 4; ++i){
+    parts[i] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(block + 16 * i));
+  }
+  BlockMasks masks;
+  masks.open = matches(parts, _mm_set1_epi8(OPENCHAR));
+  masks.close = matches(parts, _mm_set1_epi8(CLOSECHAR));
+  masks.quote = matches(parts, _mm_set1_epi8(QUOTECHAR));
+  masks.comment = matches(parts, _mm_set1_epi8(COMMENTCHAR));
+  masks.newline = matches(parts, _mm_set1_epi8('\n'));
+  masks.space = spaces(parts);
+  return masks;
+}
+
+#else
+
+BlockMasks classify(const char * block){
+  BlockMasks masks;
+  for(std::size_t i = 0; i < BLOCK; ++i){
+    std::uint64_t bit = std::uint64_t(1) << i;
+    char c = block[i];
+    if(c == OPENCHAR) masks.open |= bit;
+    else if(c == CLOSECHAR) masks.close |= bit;
+    else if(c == QUOTECHAR) masks.quote |= bit;
+    else if(c == COMMENTCHAR) masks.comment |= bit;
+    else if(c == ' ' || (c >= '\t' && c <= '\r')) {
+      masks.space |= bit;
+      if(c == '\n') masks.newline |= bit;
     }
-    else if(c == OPENCHAR){
-      store_ifnot_empty(token, tokens);
-      tokens.push_back(Token::TokenType::OPEN);
+  }
+  return masks;
+}
+
+#endif
+
+unsigned lowestBit(std::uint64_t mask){
+#if defined(__GNUC__)
+  return static_cast<unsigned>(__builtin_ctzll(mask));
+#else
+  unsigned i = 0;
+  while(!(mask & 1)) {
+    mask >>= 1;
+    ++i;
+  }
+  return i;
+#endif
+}
+
+// bit i set when an odd number of the bits up to and including i are set
+std::uint64_t prefixXor(std::uint64_t mask){
+  mask ^= mask << 1;
+  mask ^= mask << 2;
+  mask ^= mask << 4;
+  mask ^= mask << 8;
+  mask ^= mask << 16;
+  mask ^= mask << 32;
+  return mask;
+}
+
+// the bits from each ';' through the next newline, which are skipped
+std::uint64_t commentSpans(std::uint64_t starts, std::uint64_t newlines, bool & inComment){
+  std::uint64_t spans = 0;
+  std::uint64_t from = ~std::uint64_t(0);
+  if(!inComment){
+    if(!starts) return 0;
+    from = starts & (~starts + 1);
+    from = ~(from - 1);
+  }
+  while(true){
+    std::uint64_t ends = newlines & from;
+    if(!ends){
+      inComment = true;
+      return spans | from;
     }
-    else if(c == CLOSECHAR){
-      store_ifnot_empty(token, tokens);
-      tokens.push_back(Token::TokenType::CLOSE);
+    std::uint64_t end = ends & (~ends + 1);
+    std::uint64_t through = end | (end - 1);
+    spans |= through & from;
+    starts &= ~through;
+    if(!starts){
+      inComment = false;
+      return spans;
     }
-    else if(c == QUOTECHAR) {
-        if(iQ) {
-            iQ = false;
-            token.push_back('"');
-        } else iQ = true;
+    from = starts & (~starts + 1);
+    from = ~(from - 1);
+  }
+}
+
+TokenScanner::TokenScanner(): inComment(false), inQuote(false) {}
+
+void TokenScanner::scan(const char * data, std::size_t size, TokenSequenceType & tokens){
+  std::size_t whole = size - size % BLOCK;
+  for(std::size_t i = 0; i < whole; i += BLOCK){
+    scanBlock(data + i, BLOCK, tokens);
+  }
+  if(whole < size){
+    // the masks are always taken over a whole block, so pad the rest
+    char padded[BLOCK] = {};
+    std::memcpy(padded, data + whole, size - whole);
+    scanBlock(padded, size - whole, tokens);
+  }
+}
+
+void TokenScanner::finish(TokenSequenceType & tokens){
+  store_ifnot_empty(token, tokens);
+}
+
+void TokenScanner::scanBlock(const char * block, std::size_t size, TokenSequenceType & tokens){
+  BlockMasks masks = classify(block);
+  std::uint64_t valid = (size == BLOCK) ? ~std::uint64_t(0) : (std::uint64_t(1) << size) - 1;
+
+  // comments run to the end of their line, even from inside a string literal
+  std::uint64_t comment = commentSpans(masks.comment & valid, masks.newline & valid, inComment);
+  // quotes open and close string literals, whose spaces are kept
+  std::uint64_t quotes = masks.quote & ~comment & valid;
+  std::uint64_t inside = prefixXor(quotes) ^ (inQuote ? ~std::uint64_t(0) : 0);
+  inQuote = (inside >> 63) != 0;
+  // the opening quote is dropped, the closing one ends the token text
+  std::uint64_t dropped = comment | (quotes & inside);
+  std::uint64_t parens = (masks.open | masks.close) & ~comment;
+  std::uint64_t spaces = masks.space & ~comment & ~inside;
+  std::uint64_t text = valid & ~(dropped | parens | spaces);
+
+  // a token is the text between parentheses and spaces, skipping dropped characters
+  std::uint64_t events = parens | (spaces & ~(spaces << 1)) | (text & ~(text << 1));
+  events &= valid;
+  while(events){
+    unsigned i = lowestBit(events);
+    std::uint64_t bit = std::uint64_t(1) << i;
+    events &= events - 1;
+    if(text & bit){
+      std::uint64_t after = ~text & ~(bit - 1);
+      unsigned end = after ? lowestBit(after) : BLOCK;
+      token.append(block + i, end - i);
     }
-    else if(isspace(c)){
-        if(!iQ) {
-            store_ifnot_empty(token, tokens);
-        } else token.push_back(c);
-        
+    else if(parens & bit){
+      store_ifnot_empty(token, tokens);
+      tokens.push_back((masks.open & bit) ? Token::OPEN : Token::CLOSE);
     }
     else{
-      token.push_back(c);
+      store_ifnot_empty(token, tokens);
     }
   }
-  store_ifnot_empty(token, tokens);
+}
+
+TokenSequenceType tokenize(std::istream & seq){
+  TokenSequenceType tokens;
+  TokenScanner scanner;
+  std::vector<char> buffer(1 << 16);
+  while(seq){
+    seq.read(buffer.data(), buffer.size());
+    scanner.scan(buffer.data(), static_cast<std::size_t>(seq.gcount()), tokens);
+  }
+  scanner.finish(tokens);
 
   return tokens;
 }
+
+FormReader::FormReader(std::istream & seq, const std::atomic_bool * stop): seq(seq), stop(stop) {}
+
+bool FormReader::read(){
+  // only what is already buffered, reading more could block an interactive stream
+  char buffer[4096];
+  std::streamsize count = seq.readsome(buffer, sizeof(buffer));
+  if(count <= 0){
+    // nothing buffered, as always on std::cin while it is synced with stdio,
+    // so read to the end of the line, an interactive stream sends no less
+    seq.getline(buffer, sizeof(buffer));
+    count = seq.gcount();
+    if(count == 0) return false;
+    if(!seq.fail() && !seq.eof()){
+      // getline drops the newline, which still separates tokens
+      buffer[count - 1] = '\n';
+    }
+    else if(!seq.eof()){
+      // the line is longer than the buffer, the rest is read next time
+      seq.clear(seq.rdstate() & ~std::ios::failbit);
+    }
+  }
+  scanner.scan(buffer, static_cast<std::size_t>(count), pending);
+  return true;
+}
+
+bool FormReader::next(TokenSequenceType & form){
+  form.clear();
+  int depth = 0;
+  while(true){
+    while(!pending.empty()){
+      Token t = pending.front();
+      pending.pop_front();
+      form.push_back(t);
+      if(t.type() == Token::OPEN){
+        ++depth;
+      }
+      else if(t.type() == Token::CLOSE){
+        // a stray close is a form of its own, and fails to parse
+        if(--depth <= 0) return true;
+      }
+      else if(depth == 0){
+        return true;
+      }
+    }
+    if(stop && *stop) return false;
+    if(!read()){
+      scanner.finish(pending);
+      if(pending.empty()) return !form.empty();
+    }
+  }
+}
@@ -4,8 +4,11 @@ Defines the Token and TokenSequence types, and associated functions.
 #ifndef TOKEN_HPP
 #define TOKEN_HPP
 
+#include <atomic>
+#include <cstddef>
 #include <deque>
 #include <istream>
+#include <string>
 
 /*! \class Token
   \brief Value class representing a token.
@@ -47,6 +50,44 @@ sequential access should do.
  */
 typedef std::deque<Token> TokenSequenceType;
 
+/*! \class TokenScanner
+\brief Splits characters into tokens 64 bytes at a time.
+
+Each block is classified into bitmasks of parentheses, quotes, comment
+spans and whitespace, with SIMD compares where the target has them and
+a plain loop otherwise. Token boundaries are then read off the masks, so
+the cost is per token rather than per character. Input may be split
+anywhere: comments, string literals and tokens carry over between calls.
+ */
+class TokenScanner {
+public:
+
+  /// Construct a scanner at the start of the input
+  TokenScanner();
+
+  /*! Split the next characters of the input.
+    \param data the characters
+    \param size the number of characters
+    \param tokens where the tokens completed by them are appended
+   */
+  void scan(const char * data, std::size_t size, TokenSequenceType & tokens);
+
+  /*! End the input, appending the token being read if any.
+    \param tokens where the token is appended
+   */
+  void finish(TokenSequenceType & tokens);
+
+private:
+  // split the first size of the 64 characters at block
+  void scanBlock(const char * block, std::size_t size, TokenSequenceType & tokens);
+
+  // the token being read
+  std::string token;
+  // whether the input is inside a comment or a string literal
+  bool inComment;
+  bool inQuote;
+};
+
 /*! \fn TokenSequenceType tokenize(std::istream & seq)
 \brief Split a stream into a sequnce of tokens
 
@@ -60,4 +101,38 @@ Ignores any whitespace and comments (from any ";" to end-of-line).
 */
 TokenSequenceType tokenize(std::istream & seq);
 
+/*! \class FormReader
+\brief Splits a stream into the tokens of one top-level form at a time.
+
+A form is either a balanced parenthesized expression or a single atom.
+The stream is only read as far as needed to complete the next form, so
+arbitrarily long streams are tokenized in bounded memory. Tokens are split
+exactly as tokenize() splits them.
+ */
+class FormReader {
+public:
+
+  /*! Construct a reader of seq, which must outlive it
+    \param seq the stream to read
+    \param stop if given, no further reads are started once it is set
+   */
+  explicit FormReader(std::istream & seq, const std::atomic_bool * stop = nullptr);
+
+  /*! Read the tokens of the next form.
+    \param form the tokens, an unbalanced form when the stream ends inside one
+    \return false when the stream holds no further tokens, or stop is set
+   */
+  bool next(TokenSequenceType & form);
+
+private:
+  std::istream & seq;
+  const std::atomic_bool * stop;
+  // read what the stream has buffered, or else the rest of a line
+  bool read();
+
+  // tokens read past the end of the last form
+  TokenSequenceType pending;
+  TokenScanner scanner;
+};
+
 #endif
@@ -1,5 +1,11 @@
 #include "catch.hpp"
 
+#include <algorithm>
+#include <cctype>
+#include <sstream>
+#include <string>
+#include <vector>
+
 #include "token.hpp"
 
 TEST_CASE( "Test Token creation", "[token]" ) {
@@ -78,3 +84,146 @@ TEST_CASE( "Test tokenize", "[token]" ) {
   REQUIRE(tokens.empty());
 }
 
+
+TEST_CASE( "Test reading one form at a time", "[token]" ) {
+  std::string input = R"(
+(define a (+ 1 2)) ; a comment
+pi"a b"(list
+ "x y" a) )
+)";
+
+  std::istringstream iss(input);
+  FormReader reader(iss);
+  TokenSequenceType form;
+
+  REQUIRE(reader.next(form));
+  REQUIRE(form.size() == 9);
+  REQUIRE(form.front().type() == Token::OPEN);
+  REQUIRE(form.back().type() == Token::CLOSE);
+
+  INFO("an atom is a form, ended by the next token")
+  REQUIRE(reader.next(form));
+  REQUIRE(form.size() == 1);
+  REQUIRE(form.front().asString() == "pia b\"");
+
+  REQUIRE(reader.next(form));
+  REQUIRE(form.size() == 5);
+  REQUIRE(form[2].asString() == "x y\"");
+
+  INFO("a stray close is a form of its own")
+  REQUIRE(reader.next(form));
+  REQUIRE(form.size() == 1);
+  REQUIRE(form.front().type() == Token::CLOSE);
+
+  REQUIRE(!reader.next(form));
+
+  std::istringstream unbalanced("(+ 1 (- 2");
+  FormReader partial(unbalanced);
+  REQUIRE(partial.next(form));
+  REQUIRE(form.size() == 6);
+  REQUIRE(!partial.next(form));
+}
+
+// the tokens of input split one character at a time, as the scanner must split them
+TokenSequenceType referenceTokens(const std::string & input){
+  TokenSequenceType tokens;
+  std::string token;
+  bool inQuote = false;
+  auto store = [&]() {
+    if(!token.empty()) tokens.emplace_back(token);
+    token.clear();
+  };
+  for(std::size_t i = 0; i < input.size(); ++i){
+    char c = input[i];
+    if(c == ';'){
+      while(i < input.size() && input[i] != '\n') ++i;
+    }
+    else if(c == '(' || c == ')'){
+      store();
+      tokens.push_back(c == '(' ? Token::OPEN : Token::CLOSE);
+    }
+    else if(c == '"'){
+      if(inQuote) token.push_back('"');
+      inQuote = !inQuote;
+    }
+    else if(isspace(c) && !inQuote) store();
+    else token.push_back(c);
+  }
+  store();
+  return tokens;
+}
+
+std::string tokenText(const TokenSequenceType & tokens){
+  std::string text;
+  for(auto & t : tokens) text += "[" + t.asString() + "]";
+  return text;
+}
+
+TEST_CASE( "Test scanning blocks of characters", "[token]" ) {
+
+  std::vector<std::string> inputs = {
+    "", "a", "(+ 1 2)", "\"a b\" c", "ab;x\ncd", "\"a;b\nc\" d", "a\"b(c d\"e", "x ;no newline",
+    std::string(63, ' ') + "\"quoted across ( blocks\"" + std::string(70, 'z'),
+    std::string(60, 'a') + "; a comment running past the end of the block\n)" + std::string(200, '\t'),
+  };
+  // random text made mostly of the structural characters
+  const char alphabet[] = "();\"\n\t a1\xe9";
+  unsigned seed = 7;
+  for(unsigned n = 0; n < 200; ++n){
+    std::string input;
+    for(unsigned i = 0; i < n * 3; ++i){
+      seed = seed * 1103515245 + 12345;
+      input.push_back(alphabet[(seed >> 16) % (sizeof(alphabet) - 1)]);
+    }
+    inputs.push_back(input);
+  }
+
+  for(auto & input : inputs){
+    INFO(input);
+    std::string expected = tokenText(referenceTokens(input));
+    std::istringstream iss(input);
+    REQUIRE(tokenText(tokenize(iss)) == expected);
+
+    INFO("the input may be split anywhere")
+    for(std::size_t piece : {1, 5, 63, 64, 65}){
+      TokenScanner scanner;
+      TokenSequenceType tokens;
+      for(std::size_t i = 0; i < input.size(); i += piece){
+        scanner.scan(input.data() + i, std::min(piece, input.size() - i), tokens);
+      }
+      scanner.finish(tokens);
+      REQUIRE(tokenText(tokens) == expected);
+    }
+  }
+}
+
+// a stream with nothing buffered for readsome, as std::cin synced with stdio
+class UnbufferedText: public std::streambuf {
+public:
+  explicit UnbufferedText(const std::string & text): text(text) {}
+protected:
+  int_type underflow() override {
+    if(next == text.size()) return traits_type::eof();
+    return traits_type::to_int_type(text[next]);
+  }
+  int_type uflow() override {
+    if(next == text.size()) return traits_type::eof();
+    return traits_type::to_int_type(text[next++]);
+  }
+private:
+  std::string text;
+  std::size_t next = 0;
+};
+
+TEST_CASE( "Test reading forms from an unbuffered stream", "[token]" ) {
+
+  std::string input = "(define a 1) ; a comment\n(+ a\n 2) pi\n" + std::string(5000, 'x') + " (list \"a b\n c\")";
+  UnbufferedText text(input);
+  std::istream stream(&text);
+  FormReader reader(stream);
+  TokenSequenceType tokens, form;
+  while(reader.next(form)) tokens.insert(tokens.end(), form.begin(), form.end());
+
+  INFO("lines, including one longer than the read buffer, are split as tokenize splits them")
+  REQUIRE(tokenText(tokens) == tokenText(referenceTokens(input)));
+}
@@ -0,0 +1,150 @@
+#include "trace.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <mutex>
+#include <vector>
+
+std::atomic_bool traceEnabled(false);
+
+// a finished span, in microseconds from the start of tracing
+struct TraceEvent {
+  TraceStage stage;
+  unsigned thread;
+  std::uint64_t request;
+  std::int64_t begin;
+  std::int64_t duration;
+};
+
+// durations of up to 2^(TRACE_BUCKETS - 1) microseconds have a bucket each
+const int TRACE_BUCKETS = 32;
+
+struct StageHistogram {
+  std::uint64_t count = 0;
+  std::int64_t total = 0;
+  std::int64_t max = 0;
+  std::uint64_t buckets[TRACE_BUCKETS] = {};
+};
+
+struct TraceLog {
+  std::mutex mutex;
+  TraceClock::time_point start;
+  std::vector<TraceEvent> events;
+  std::uint64_t dropped = 0;
+  StageHistogram histograms[TRACE_STAGES];
+  std::map<unsigned, std::string> threadNames;
+};
+
+TraceLog & traceLog() {
+  // never destroyed, threads may trace after static destruction starts
+  static TraceLog * log = new TraceLog;
+  return *log;
+}
+
+const char * const STAGE_NAMES[TRACE_STAGES] = {
+  "queue wait", "tokenize", "parse", "evaluate", "result handoff", "render"
+};
+
+// small thread numbers, in the order threads first trace
+unsigned traceThread() {
+  static std::atomic<unsigned> next(0);
+  static thread_local unsigned thread = ++next;
+  return thread;
+}
+
+// the bucket of a duration, the number of bits it takes
+int traceBucket(std::int64_t micros) {
+  int bucket = 0;
+  while(micros > 0 && bucket < TRACE_BUCKETS - 1) {
+    micros >>= 1;
+    ++bucket;
+  }
+  return bucket;
+}
+
+void startTracing() {
+  TraceLog & log = traceLog();
+  std::lock_guard<std::mutex> lock(log.mutex);
+  log.start = TraceClock::now();
+  traceEnabled = true;
+}
+
+void traceThreadName(const std::string & name) {
+  TraceLog & log = traceLog();
+  unsigned thread = traceThread();
+  std::lock_guard<std::mutex> lock(log.mutex);
+  log.threadNames[thread] = name;
+}
+
+void traceSpan(TraceStage stage, TraceClock::time_point begin, TraceClock::time_point end, std::uint64_t request) {
+  if(!tracing()) return;
+  using std::chrono::duration_cast;
+  using std::chrono::microseconds;
+  TraceLog & log = traceLog();
+  unsigned thread = traceThread();
+  std::lock_guard<std::mutex> lock(log.mutex);
+  // a span that began before tracing started is cut at the start
+  if(begin < log.start) begin = log.start;
+  if(end < begin) end = begin;
+  std::int64_t duration = duration_cast<microseconds>(end - begin).count();
+  StageHistogram & histogram = log.histograms[stage];
+  histogram.count += 1;
+  histogram.total += duration;
+  histogram.max = std::max(histogram.max, duration);
+  histogram.buckets[traceBucket(duration)] += 1;
+  if(log.events.size() == TRACE_EVENTS) {
+    log.dropped += 1;
+    return;
+  }
+  log.events.push_back(TraceEvent{stage, thread, request,
+                                  duration_cast<microseconds>(begin - log.start).count(), duration});
+}
+
+void writeTrace(std::ostream & out) {
+  TraceLog & log = traceLog();
+  std::lock_guard<std::mutex> lock(log.mutex);
+  out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+  bool first = true;
+  for(auto & name : log.threadNames) {
+    out << (first ? "\n" : ",\n");
+    first = false;
+    // names are chosen by the program, never user input, so need no escaping
+    out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << name.first
+        << ",\"args\":{\"name\":\"" << name.second << "\"}}";
+  }
+  for(auto & event : log.events) {
+    out << (first ? "\n" : ",\n");
+    first = false;
+    out << "{\"name\":\"" << STAGE_NAMES[event.stage] << "\",\"cat\":\"pipeline\",\"ph\":\"X\",\"pid\":1"
+        << ",\"tid\":" << event.thread << ",\"ts\":" << event.begin << ",\"dur\":" << event.duration;
+    if(event.request) out << ",\"args\":{\"request\":" << event.request << "}";
+    out << "}";
+  }
+  out << "\n]}\n";
+}
+
+bool saveTrace(const std::string & filename) {
+  std::ofstream out(filename, std::ios::trunc);
+  if(!out) return false;
+  writeTrace(out);
+  return static_cast<bool>(out);
+}
+
+void writeHistograms(std::ostream & out) {
+  TraceLog & log = traceLog();
+  std::lock_guard<std::mutex> lock(log.mutex);
+  for(int stage = 0; stage < TRACE_STAGES; ++stage) {
+    const StageHistogram & histogram = log.histograms[stage];
+    if(histogram.count == 0) continue;
+    out << STAGE_NAMES[stage] << ": " << histogram.count << " spans, mean "
+        << histogram.total / static_cast<std::int64_t>(histogram.count) << " us, max " << histogram.max << " us\n";
+    for(int bucket = 0; bucket < TRACE_BUCKETS; ++bucket) {
+      if(histogram.buckets[bucket] == 0) continue;
+      std::int64_t upper = std::int64_t(1) << bucket;
+      out << "  < " << std::setw(10) << upper << " us " << std::setw(8) << histogram.buckets[bucket] << "\n";
+    }
+  }
+  if(log.dropped) out << log.dropped << " spans were left out of the trace\n";
+}
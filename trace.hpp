@@ -0,0 +1,97 @@
+/*! \file trace.hpp
+Defines opt-in tracing of the stages of the REPL and notebook pipelines.
+
+A request hops from the thread reading it, through a queue, to the kernel
+thread that tokenizes, parses and evaluates it, and back through another
+queue to the thread showing the result. Once startTracing() is called,
+each stage records a span: its start, duration and thread. The spans are
+written in the Chrome trace event format, which chrome://tracing and
+ui.perfetto.dev open, and summed into a latency histogram per stage.
+Without tracing, a span is a check of one flag.
+ */
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+/// the clock spans are measured with
+typedef std::chrono::steady_clock TraceClock;
+
+/// The stages of a request
+enum TraceStage {
+  QueueWait,      ///< waiting in the queue to the kernel
+  Tokenize,       ///< splitting the program into tokens
+  Parse,          ///< building the expression from the tokens
+  Evaluate,       ///< evaluating the expression
+  ResultHandoff,  ///< from the kernel finishing to the result being picked up
+  Render,         ///< showing the result
+  TRACE_STAGES
+};
+
+/// the most spans kept for the trace, the histograms count every span
+const std::size_t TRACE_EVENTS = 1 << 20;
+
+extern std::atomic_bool traceEnabled;
+
+/// true once tracing has started
+inline bool tracing() noexcept {return traceEnabled.load(std::memory_order_relaxed);}
+
+/// Start recording spans, measured from now.
+void startTracing();
+
+/*! Name the calling thread in the trace.
+  \param name the name shown for the thread, such as kernel
+ */
+void traceThreadName(const std::string & name);
+
+/*! Record a span if tracing.
+  \param stage the stage the span measures
+  \param begin when it started
+  \param end when it ended
+  \param request the request it belongs to, or 0
+ */
+void traceSpan(TraceStage stage, TraceClock::time_point begin, TraceClock::time_point end, std::uint64_t request = 0);
+
+/*! \class TraceSpan
+\brief Records a span from its construction to its destruction.
+ */
+class TraceSpan {
+public:
+  /// start a span of stage, for request if not 0
+  explicit TraceSpan(TraceStage stage, std::uint64_t request = 0):
+    m_stage(stage), m_request(request), m_active(tracing()) {
+    if(m_active) m_begin = TraceClock::now();
+  }
+
+  /// end the span
+  ~TraceSpan() {
+    if(m_active) traceSpan(m_stage, m_begin, TraceClock::now(), m_request);
+  }
+
+private:
+  TraceSpan(const TraceSpan &) = delete;
+  TraceSpan & operator=(const TraceSpan &) = delete;
+
+  TraceStage m_stage;
+  std::uint64_t m_request;
+  bool m_active;
+  TraceClock::time_point m_begin;
+};
+
+/// Write the spans recorded so far as Chrome trace event JSON.
+void writeTrace(std::ostream & out);
+
+/*! Write the spans recorded so far to a trace file.
+  \param filename the file to (over)write
+  \return true if the whole trace was written
+ */
+bool saveTrace(const std::string & filename);
+
+/// Write the count, mean, maximum and power of two histogram of each stage.
+void writeHistograms(std::ostream & out);
+
+#endif
@@ -0,0 +1,42 @@
+#include "catch.hpp"
+
+#include <string>
+#include <sstream>
+
+#include "interpreter.hpp"
+#include "trace.hpp"
+
+TEST_CASE( "Test tracing pipeline stages", "[trace]" ) {
+
+  INFO("nothing is recorded before tracing starts")
+  std::ostringstream before;
+  traceSpan(Evaluate, TraceClock::now(), TraceClock::now(), 1);
+  writeHistograms(before);
+  REQUIRE(before.str().empty());
+
+  startTracing();
+  traceThreadName("tests");
+  Interpreter interp;
+  std::istringstream program("(+ 1 2)");
+  REQUIRE(interp.parseStream(program));
+  REQUIRE(interp.evaluate() == Expression(3.));
+  TraceClock::time_point queued = TraceClock::now();
+  traceSpan(QueueWait, queued, queued + std::chrono::microseconds(40), 7);
+
+  std::ostringstream trace;
+  writeTrace(trace);
+  std::string json = trace.str();
+  REQUIRE(json.find("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[") == 0);
+  REQUIRE(json.find("\"name\":\"tokenize\"") != std::string::npos);
+  REQUIRE(json.find("\"name\":\"parse\"") != std::string::npos);
+  REQUIRE(json.find("\"name\":\"evaluate\"") != std::string::npos);
+  REQUIRE(json.find("\"name\":\"queue wait\",\"cat\":\"pipeline\",\"ph\":\"X\"") != std::string::npos);
+  REQUIRE(json.find("\"dur\":40,\"args\":{\"request\":7}") != std::string::npos);
+  REQUIRE(json.find("\"args\":{\"name\":\"tests\"}") != std::string::npos);
+  REQUIRE(json.substr(json.size() - 4) == "\n]}\n");
+
+  std::ostringstream histograms;
+  writeHistograms(histograms);
+  REQUIRE(histograms.str().find("queue wait: 1 spans, mean 40 us, max 40 us\n  <         64 us        1\n") != std::string::npos);
+  REQUIRE(histograms.str().find("evaluate: ") != std::string::npos);
+}
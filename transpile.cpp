@@ -0,0 +1,177 @@
+#include "transpile.hpp"
+
+#include <cstdio>
+#include <iomanip>
+#include <iterator>
+#include <sstream>
+#include <vector>
+
+#include "expression.hpp"
+#include "parse.hpp"
+#include "token.hpp"
+
+namespace {
+
+// a C++ string literal holding text
+std::string cppString(const std::string & text) {
+  std::ostringstream out;
+  out << '"';
+  for(unsigned char c : text) {
+    if(c == '"' || c == '\\') {
+      out << '\\' << c;
+    } else if(c >= 0x20 && c < 0x7f) {
+      out << c;
+    } else {
+      char octal[5];
+      std::snprintf(octal, sizeof(octal), "\\%03o", c);
+      out << octal;
+    }
+  }
+  out << '"';
+  return out.str();
+}
+
+// a C++ expression constructing atom, as parse would from its token
+std::string cppAtom(const Atom & atom) {
+  std::ostringstream out;
+  if(atom.isNumber()) {
+    std::ostringstream number;
+    number << std::setprecision(17) << atom.asNumber();
+    std::string digits = number.str();
+    // a double literal, so that -0 keeps its sign
+    if(digits.find_first_of(".e") == std::string::npos) digits += ".0";
+    out << "Atom(" << digits << ")";
+  } else if(atom.isString()) {
+    // the constructor drops the closing quote kept by the token
+    out << "Atom(std::string(" << cppString(atom.asString() + "\"") << "))";
+  } else {
+    out << "Atom(std::string(" << cppString(atom.asSymbol()) << "))";
+  }
+  return out.str();
+}
+
+bool isSpecialForm(const std::string & name) {
+  static const char * forms[] = {"begin", "define", "list", "lambda", "apply", "map", "fold", "reduce",
+                                 "set-property", "get-property", "discrete-plot", "continuous-plot", "future", "force"};
+  for(auto form : forms) {
+    if(name == form) return true;
+  }
+  return false;
+}
+
+// writes one C++ function per expression, callees before callers
+class Translator {
+public:
+  explicit Translator(std::ostream & out): m_out(out) {}
+
+  // the index of the function evaluating exp
+  std::size_t translate(const Expression & exp) {
+    const Atom & head = exp.head();
+    std::vector<std::size_t> parts;
+    std::ostringstream body;
+    bool usesEnv = true;
+    if(exp.tailConstBegin() == exp.tailConstEnd()) {
+      if(head.isSymbol()) {
+        body << "  static Expression exp(" << cppAtom(head) << ");\n"
+             << "  return exp.eval(env);\n";
+      } else {
+        body << "  static const Expression value(" << cppAtom(head) << ");\n"
+             << "  return value;\n";
+        usesEnv = false;
+      }
+    } else if(!head.isSymbol() || !isSpecialForm(head.asSymbol())) {
+      for(auto e = exp.tailConstBegin(); e != exp.tailConstEnd(); ++e) parts.push_back(translate(*e));
+      body << "  static const Atom op(" << cppAtom(head) << ");\n"
+           << "  std::vector<Expression> args;\n"
+           << "  args.reserve(" << parts.size() << ");\n";
+      for(auto part : parts) body << "  args.push_back(node" << part << "(env));\n";
+      body << "  return Expression::invoke(op, args, env);\n";
+    } else if(head.asSymbol() == "begin") {
+      for(auto e = exp.tailConstBegin(); e != exp.tailConstEnd(); ++e) parts.push_back(translate(*e));
+      for(std::size_t i = 0; i + 1 < parts.size(); ++i) body << "  node" << parts[i] << "(env);\n";
+      body << "  return node" << parts.back() << "(env);\n";
+    } else if(head.asSymbol() == "define" && isDefinition(exp)) {
+      const Atom & symbol = exp.tailConstBegin()->head();
+      std::size_t value = translate(*std::next(exp.tailConstBegin()));
+      body << "  Expression value = node" << value << "(env);\n"
+           << "  env.add_exp(" << cppAtom(symbol) << ", value);\n"
+           << "  return value;\n";
+    } else {
+      // the interpreter evaluates the rest, and reports malformed forms
+      body << "  static Expression form = []() {\n"
+           << "    Expression exp(" << cppAtom(head) << ");\n";
+      build(exp, "exp", body);
+      body << "    return exp;\n"
+           << "  }();\n"
+           << "  return form.eval(env);\n";
+    }
+    std::size_t index = m_count++;
+    m_out << "Expression node" << index << "(Environment &" << (usesEnv ? " env" : "") << ") {\n"
+          << body.str() << "}\n\n";
+    return index;
+  }
+
+private:
+  // a define the interpreter would accept, the symbol is not evaluated
+  static bool isDefinition(const Expression & exp) {
+    std::vector<Expression> tail(exp.tailConstBegin(), exp.tailConstEnd());
+    if(tail.size() != 2 || !tail[0].isHeadSymbol()) return false;
+    std::string name = tail[0].head().asSymbol();
+    return name != "define" && name != "begin";
+  }
+
+  // statements appending the tail of exp to the expression named var
+  void build(const Expression & exp, const std::string & var, std::ostream & body) {
+    for(auto e = exp.tailConstBegin(); e != exp.tailConstEnd(); ++e) {
+      body << "    " << var << ".append(" << cppAtom(e->head()) << ");\n";
+      if(e->tailConstBegin() != e->tailConstEnd()) {
+        std::string child = "e" + std::to_string(m_temporaries++);
+        body << "    Expression & " << child << " = *" << var << ".tail();\n";
+        build(*e, child, body);
+      }
+    }
+  }
+
+  std::ostream & m_out;
+  std::size_t m_count = 0;
+  std::size_t m_temporaries = 0;
+};
+
+}
+
+bool transpile(std::istream & program, std::ostream & out, const std::string & name) {
+  Expression ast = parse(tokenize(program));
+  if(ast == Expression()) return false;
+
+  std::string comment = name;
+  for(auto & c : comment) {
+    if(c == '\n' || c == '\r') c = ' ';
+  }
+  std::ostringstream functions;
+  Translator translator(functions);
+  std::size_t root = translator.translate(ast);
+
+  out << "// Generated by plotscriptc from " << comment << ", do not edit.\n"
+      << "#include <cstdlib>\n"
+      << "#include <iostream>\n"
+      << "#include <string>\n"
+      << "#include <vector>\n\n"
+      << "#include \"environment.hpp\"\n"
+      << "#include \"expression.hpp\"\n"
+      << "#include \"semantic_error.hpp\"\n\n"
+      << "namespace {\n\n"
+      << functions.str()
+      << "}\n\n"
+      << "int main() {\n"
+      << "  Environment env;\n"
+      << "  try {\n"
+      << "    Expression result = node" << root << "(env);\n"
+      << "    std::cout << result << std::endl;\n"
+      << "  } catch(const SemanticError & ex) {\n"
+      << "    std::cerr << ex.what() << std::endl;\n"
+      << "    return EXIT_FAILURE;\n"
+      << "  }\n"
+      << "  return EXIT_SUCCESS;\n"
+      << "}\n";
+  return true;
+}
@@ -0,0 +1,29 @@
+/*! \file transpile.hpp
+Defines the translation of plotscript programs to C++ source.
+ */
+#ifndef TRANSPILE_HPP
+#define TRANSPILE_HPP
+
+#include <istream>
+#include <ostream>
+#include <string>
+
+/*! Translate a program to the C++ source of an executable that evaluates
+  it and prints the result or error as plotscript <file> would.
+
+  The program is read with the tokenize and parse of the interpreter.
+  Each expression becomes a C++ function: literals are constants, begin
+  and define run their parts in sequence, and procedure and lambda calls
+  evaluate their arguments and go straight to Expression::invoke. The
+  other special forms are left to Expression::eval on their subtree, which
+  is built once when first used. The generated source links against the
+  interpreter library.
+
+  \param program the source of the program
+  \param out where the C++ source is written
+  \param name the name of the program, for the header comment
+  \return false if the program could not be parsed, nothing is written then
+ */
+bool transpile(std::istream & program, std::ostream & out, const std::string & name);
+
+#endif
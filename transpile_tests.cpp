@@ -0,0 +1,45 @@
+#include "catch.hpp"
+
+#include <sstream>
+#include <string>
+
+#include "transpile.hpp"
+
+std::string transpileText(const std::string & program){
+  std::istringstream iss(program);
+  std::ostringstream out;
+  REQUIRE(transpile(iss, out, "test.pls"));
+  return out.str();
+}
+
+bool contains(const std::string & text, const std::string & part){
+  return text.find(part) != std::string::npos;
+}
+
+TEST_CASE( "Test translating programs to C++", "[transpile]" ) {
+
+  std::istringstream bad("(+ 1 2))");
+  std::ostringstream nothing;
+  REQUIRE_FALSE(transpile(bad, nothing, "bad.pls"));
+  REQUIRE(nothing.str().empty());
+
+  std::string source = transpileText("(begin (define a (+ 1 -0)) (f a \"x \\\\y\"))");
+  REQUIRE(contains(source, "// Generated by plotscriptc from test.pls"));
+  REQUIRE(contains(source, "int main() {"));
+
+  INFO("calls and definitions are translated")
+  REQUIRE(contains(source, "static const Atom op(Atom(std::string(\"+\")));"));
+  REQUIRE(contains(source, "return Expression::invoke(op, args, env);"));
+  REQUIRE(contains(source, "env.add_exp(Atom(std::string(\"a\")), value);"));
+
+  INFO("literals are rebuilt exactly")
+  REQUIRE(contains(source, "Atom(1.0)"));
+  REQUIRE(contains(source, "Atom(-0.0)"));
+  REQUIRE(contains(source, "Atom(std::string(\"x \\\\\\\\y\\\"\"))"));
+
+  INFO("other special forms are left to the interpreter")
+  std::string lambda = transpileText("(map (lambda (x) (+ x 1)) (list 1))");
+  REQUIRE(contains(lambda, "Expression exp(Atom(std::string(\"map\")));"));
+  REQUIRE(contains(lambda, "return form.eval(env);"));
+  REQUIRE_FALSE(contains(lambda, "Expression::invoke"));
+}
@@ -0,0 +1,98 @@
+/*! \file typed_procedure.hpp
+Defines the registration of built-in procedures from typed C++ functions.
+ */
+#ifndef TYPED_PROCEDURE_HPP
+#define TYPED_PROCEDURE_HPP
+
+#include <cstddef>
+#include <initializer_list>
+#include <vector>
+
+#include "environment.hpp"
+#include "expression.hpp"
+
+/*! \class ArgType
+\brief How an argument of C++ type T is checked and unboxed from an Expression.
+ */
+template<typename T> struct ArgType;
+
+/*! A real number argument */
+template<> struct ArgType<double> {
+  static bool is(const Expression & arg) noexcept {return arg.isHeadNumber();}
+  static double get(const Expression & arg) noexcept {return arg.head().asNumber();}
+};
+
+/*! Box the result of a typed function back into an Expression */
+inline Expression boxResult(double value) {return Expression(value);}
+
+namespace detail {
+
+// the argument type of a fixed-arity entry point, for each C++ parameter
+template<typename T> struct AsArgument {typedef const Expression & type;};
+
+template<std::size_t... I> struct Indices {};
+template<std::size_t N, std::size_t... I> struct MakeIndices : MakeIndices<N - 1, N - 1, I...> {};
+template<std::size_t... I> struct MakeIndices<0, I...> {typedef Indices<I...> type;};
+
+inline bool allOf(std::initializer_list<bool> checks) {
+  for(bool check : checks) {
+    if(!check) return false;
+  }
+  return true;
+}
+
+}
+
+/*! \class Typed
+\brief Generates the entry points of a built-in procedure from a typed C++
+       function F, with General handling every other call.
+
+  The arity and argument types are deduced from the signature of F. When
+  a call has that many arguments and each one has its type, the arguments
+  are unboxed, F is called, and its result boxed; otherwise the call goes
+  to General unchanged, which keeps the behavior and error messages of
+  the procedure for complex numbers, other arities and invalid arguments.
+
+  Typed<Signature, F, General>::call is a Procedure, and fixed takes the
+  arguments directly: for one or two parameters it is a UnaryProcedure or
+  BinaryProcedure the evaluator calls without an argument vector.
+
+  Usage:
+  \code
+  double addReals(double a, double b) {return a + b;}
+  typedef double (*RealBinary)(double, double);
+  EnvResult(ProcedureType, add, nullptr, Typed<RealBinary, addReals, add>::fixed);
+  \endcode
+ */
+template<typename Signature, Signature F, Procedure General> struct Typed;
+
+template<typename R, typename... A, R (*F)(A...), Procedure General>
+struct Typed<R (*)(A...), F, General> {
+
+  /*! The number of arguments F takes */
+  static const std::size_t arity = sizeof...(A);
+
+  /*! Call with an argument vector, a Procedure */
+  static Expression call(const std::vector<Expression> & args) {
+    if(args.size() != arity) return General(args);
+    return unpack(args, typename detail::MakeIndices<sizeof...(A)>::type());
+  }
+
+  /*! Call with exactly arity arguments */
+  static Expression fixed(typename detail::AsArgument<A>::type... args) {
+    if(detail::allOf({ArgType<A>::is(args)...})) return boxResult(F(ArgType<A>::get(args)...));
+    return General(std::vector<Expression>{args...});
+  }
+
+private:
+  template<std::size_t... I>
+  static Expression unpack(const std::vector<Expression> & args, detail::Indices<I...>) {
+    if(detail::allOf({ArgType<A>::is(args[I])...})) return boxResult(F(ArgType<A>::get(args[I])...));
+    return General(args);
+  }
+};
+
+template<typename R, typename... A, R (*F)(A...), Procedure General>
+const std::size_t Typed<R (*)(A...), F, General>::arity;
+
+#endif
@@ -0,0 +1,96 @@
+#include "catch.hpp"
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "typed_procedure.hpp"
+#include "environment.hpp"
+#include "expression.hpp"
+#include "interpreter.hpp"
+#include "semantic_error.hpp"
+
+namespace {
+
+double half(double x) {return x / 2;}
+double hypotenuseSquared(double a, double b) {return a * a + b * b;}
+
+// marks the calls the typed function did not take
+Expression general(const std::vector<Expression> & args) {
+  return Expression(Atom("general:" + std::to_string(args.size()) + "\""));
+}
+
+typedef double (*RealUnary)(double);
+typedef double (*RealBinary)(double, double);
+
+Expression evalTyped(Interpreter & interp, const std::string & program){
+  std::istringstream iss(program);
+  REQUIRE(interp.parseStream(iss));
+  return interp.evaluate();
+}
+
+}
+
+TEST_CASE( "Test procedures generated from typed functions", "[typed_procedure]" ) {
+
+  typedef Typed<RealUnary, half, general> Half;
+  typedef Typed<RealBinary, hypotenuseSquared, general> Squares;
+  REQUIRE(Half::arity == 1);
+  REQUIRE(Squares::arity == 2);
+
+  Expression three(3.), four(4.), text(Atom("a\"")), complex(Atom(0, 1));
+  REQUIRE(Half::fixed(three) == Expression(1.5));
+  REQUIRE(Half::call({three}) == Expression(1.5));
+  REQUIRE(Squares::fixed(three, four) == Expression(25.));
+  REQUIRE(Squares::call({three, four}) == Expression(25.));
+
+  INFO("other argument types and arities go to the general procedure")
+  Expression once(Atom("general:1\"")), twice(Atom("general:2\""));
+  REQUIRE(Half::fixed(complex) == once);
+  REQUIRE(Half::call({three, four}) == twice);
+  REQUIRE(Squares::fixed(three, text) == twice);
+  REQUIRE(Squares::call({three}) == once);
+  REQUIRE(Squares::call({complex, four}) == twice);
+}
+
+TEST_CASE( "Test the fixed-arity entries of the built-ins", "[typed_procedure]" ) {
+
+  Environment env;
+  for(auto name : {"+", "-", "*", "/", "sin", "cos", "tan"}) {
+    REQUIRE(env.get_unary(Atom(name)) != nullptr);
+  }
+  for(auto name : {"+", "-", "*", "/", "^"}) {
+    REQUIRE(env.get_binary(Atom(name)) != nullptr);
+  }
+  REQUIRE(env.get_unary(Atom("^")) == nullptr);
+  REQUIRE(env.get_binary(Atom("list")) == nullptr);
+  REQUIRE(env.get_binary(Atom("pi")) == nullptr);
+  REQUIRE(env.get_binary(Atom(1)) == nullptr);
+
+  INFO("the entries give the results of the general procedures")
+  Interpreter interp;
+  const char * calls[][2] = {
+    {"(+ 1 2)", "(+ 1 2 0)"}, {"(+ -0)", "(+ -0 -0 -0)"}, {"(* -0)", "(* -0 1 1)"},
+    {"(- 5 7)", "(apply - (list 5 7))"}, {"(- 4)", "(apply - (list 4))"},
+    {"(/ 1 3)", "(apply / (list 1 3))"}, {"(/ 4)", "(apply / (list 4))"},
+    {"(^ 2 0.5)", "(apply ^ (list 2 0.5))"}, {"(sin 1)", "(apply sin (list 1))"},
+    {"(+ 1 I)", "(+ 1 I 0)"}, {"(- I 2)", "(apply - (list I 2))"}, {"(^ I 2)", "(apply ^ (list I 2))"},
+  };
+  for(auto & call : calls) {
+    INFO(call[0]);
+    REQUIRE(evalTyped(interp, call[0]) == evalTyped(interp, call[1]));
+  }
+  REQUIRE(evalTyped(interp, "(+ 1 I)") == Expression(Atom(1, 1)));
+
+  INFO("errors are those of the general procedures")
+  for(auto program : {"(+ 1 \"a\")", "(sin I)", "(- (list 1))", "(^ 2 (list 1))"}) {
+    INFO(program);
+    REQUIRE_THROWS_AS(evalTyped(interp, program), SemanticError);
+  }
+  try {
+    evalTyped(interp, "(sin \"a\")");
+    FAIL("expected an error");
+  } catch(const SemanticError & ex) {
+    REQUIRE(std::string(ex.what()) == "Error in call to Sine: invalid argument.");
+  }
+}
@@ -12,10 +12,16 @@
 #include <fstream>
 #include <iostream>
 #include <thread>
+#include <atomic>
+#include <memory>
 
 #include "startup_config.hpp"
 #include "semantic_error.hpp"
 #include "tsQueue.hpp"
+#include "spscQueue.hpp"
+#include "workerPool.hpp"
+#include "batchRunner.hpp"
+#include "kernelDaemon.hpp"
 
 TEST_CASE("Message Queue Test","[Message Queue]") {
     {
@@ -29,3 +35,166 @@ TEST_CASE("Message Queue Test","[Message Queue]") {
         REQUIRE(value == "test");
     }
 }
+
+TEST_CASE("Ring Buffer Queue Test","[Message Queue]") {
+    {
+        spscQueue<std::unique_ptr<int>> queue(3);
+        REQUIRE(queue.capacity() == 4);
+        REQUIRE(queue.empty());
+        for(int i = 0; i < 4; ++i)
+            REQUIRE(queue.try_push(std::unique_ptr<int>(new int(i))));
+        INFO("a full queue refuses more")
+        REQUIRE(!queue.try_push(std::unique_ptr<int>(new int(4))));
+        std::unique_ptr<int> value;
+        for(int i = 0; i < 4; ++i) {
+            REQUIRE(queue.try_pop(value));
+            REQUIRE(*value == i);
+        }
+        REQUIRE(!queue.try_pop(value));
+        REQUIRE(!queue.wait_for_pop(value, std::chrono::milliseconds(1)));
+    }
+    {
+        INFO("a small queue between two threads blocks both sides in turn")
+        const int count = 100000;
+        spscQueue<int> queue(8);
+        std::thread producer([&queue]() {
+            for(int i = 0; i < count; ++i)
+                queue.push(int(i));
+        });
+        bool ordered = true;
+        for(int i = 0; i < count; ++i) {
+            int value;
+            queue.wait_and_pop(value);
+            ordered = ordered && (value == i);
+        }
+        producer.join();
+        REQUIRE(ordered);
+        REQUIRE(queue.empty());
+    }
+}
+
+TEST_CASE("Worker Pool Test","[Worker Pool]") {
+    std::atomic<int> total(0);
+    {
+        workerPool pool(4);
+        REQUIRE(pool.size() == 4);
+        for(int i = 1; i <= 1000; ++i)
+            pool.submit([&total, i]() { total += i; });
+        INFO("destroying the pool runs everything submitted")
+    }
+    REQUIRE(total == 500500);
+    {
+        workerPool pool(0);
+        REQUIRE(pool.size() == 1);
+    }
+}
+
+TEST_CASE("Batch Evaluation Test","[Batch]") {
+    REQUIRE(batchOutputPath("plots/a.pls", "") == "plots/a.pls.out");
+    REQUIRE(batchOutputPath("plots/a.pls", "out") == "out/a.out");
+    {
+        INFO("scripts that would share an output file are told apart")
+        std::vector<std::string> paths = batchOutputPaths({"a/x.pls", "b/x.pls", "c/y.pls", "x.1.pls"}, "out");
+        REQUIRE(paths[0] == "out/x.0.out");
+        REQUIRE(paths[1] == "out/x.1.1.out");
+        REQUIRE(paths[2] == "out/y.out");
+        REQUIRE(paths[3] == "out/x.1.out");
+        paths = batchOutputPaths({"a.pls", "a.pls"}, "");
+        REQUIRE(paths[0] != paths[1]);
+    }
+
+    Environment startup;
+    startup.add_exp(Atom("base"), Expression(10.));
+    startup.freeze();
+    std::vector<std::string> files;
+    for(int i = 0; i < 8; ++i) {
+        std::string name = "batch_test_" + std::to_string(i) + ".pls";
+        std::ofstream script(name);
+        script << "(begin (define a " << i << ") (+ a base))";
+        files.push_back(name);
+    }
+    files.push_back("batch_test_missing.pls");
+    std::vector<batchResult> results = runBatch(files, startup, 3, EvalLimits(), "");
+    REQUIRE(results.size() == files.size());
+    for(int i = 0; i < 8; ++i) {
+        INFO("every script starts from the startup environment alone")
+        REQUIRE(results[i].ok);
+        REQUIRE(results[i].output == "(" + std::to_string(10 + i) + ")");
+        std::ifstream out(files[i] + ".out");
+        std::string line;
+        std::getline(out, line);
+        REQUIRE(line == results[i].output);
+    }
+    REQUIRE(!results[8].ok);
+    REQUIRE(results[8].output == "Error: Could not open file for reading.");
+    for(auto &file : files) {
+        std::remove(file.c_str());
+        std::remove((file + ".out").c_str());
+    }
+}
+
+#if defined(__APPLE__) || defined(__linux) || defined(__unix) || defined(__posix)
+#include <pthread.h>
+// connect to the daemon on path, retrying while it starts
+int connectDaemon(const std::string & path) {
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    std::strcpy(address.sun_path, path.c_str());
+    for(int attempt = 0; attempt < 200; ++attempt) {
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if(connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) == 0) return fd;
+        close(fd);
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return -1;
+}
+
+// read from fd until a newline or the end, or nothing arrives for timeout
+std::string readDaemon(int fd, int timeout, bool wholeReply = true) {
+    std::string data;
+    char buffer[4096];
+    pollfd p{fd, POLLIN, 0};
+    while(poll(&p, 1, timeout) > 0) {
+        ssize_t count = read(fd, buffer, sizeof(buffer));
+        if(count <= 0) break;
+        data.append(buffer, count);
+        if(wholeReply && data.back() == '\n') break;
+    }
+    return data;
+}
+
+TEST_CASE("Daemon Slow Reader Test","[Daemon]") {
+    const std::string path = "daemon_test.sock";
+    // one worker, so a worker waiting on a client would stall everyone
+    kernelDaemon server(path, 1, EvalLimits());
+    std::thread daemon([&server]() { server.run(); });
+
+    int stalled = connectDaemon(path);
+    REQUIRE(stalled >= 0);
+    // about 600 KB per reply, more than the socket holds and the backlog allows
+    std::string big = "(range 0 100000 1)\n";
+    for(int i = 0; i < 12; ++i) {
+        REQUIRE(write(stalled, big.data(), big.size()) == static_cast<ssize_t>(big.size()));
+    }
+
+    int other = connectDaemon(path);
+    REQUIRE(other >= 0);
+    std::string line = "(+ 1 2)\n";
+    REQUIRE(write(other, line.data(), line.size()) == static_cast<ssize_t>(line.size()));
+    INFO("a client that is not reading does not hold up another session")
+    REQUIRE(readDaemon(other, 10000) == "(3)\n");
+
+    INFO("the client that is not reading is dropped once its backlog is too large")
+    std::string replies = readDaemon(stalled, 10000, false);
+    REQUIRE(replies.size() < 12 * 500000);
+
+    close(stalled);
+    close(other);
+    // stopped as by cntrl-c, the handler runs on the daemon's own thread
+    install_handler();
+    pthread_kill(daemon.native_handle(), SIGINT);
+    daemon.join();
+    global_status_flag = 0;
+}
+#endif
@@ -0,0 +1,71 @@
+#ifndef WORKERPOOL_HPP
+#define WORKERPOOL_HPP
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+// A fixed set of threads running submitted tasks in submission order.
+// Destroying the pool finishes the queued tasks and joins the threads.
+class workerPool {
+public:
+    explicit workerPool(unsigned count) {
+        if(count == 0) count = 1;
+        for(unsigned i = 0; i < count; ++i) {
+            pool.emplace_back(std::thread(&workerPool::work, this));
+        }
+    }
+
+    workerPool(const workerPool &) = delete;
+    workerPool & operator=(const workerPool &) = delete;
+
+    ~workerPool() {
+        {
+            std::lock_guard<std::mutex> lock(the_mutex);
+            stopping = true;
+        }
+        the_condition_variable.notify_all();
+        for(auto &t : pool) {
+            if(t.joinable())
+                t.join();
+        }
+    }
+
+    void submit(std::function<void()> task) {
+        {
+            std::lock_guard<std::mutex> lock(the_mutex);
+            tasks.push(std::move(task));
+        }
+        the_condition_variable.notify_one();
+    }
+
+    int size() {
+        return pool.size();
+    }
+
+private:
+    void work() {
+        while(1) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(the_mutex);
+                the_condition_variable.wait(lock, [this]{ return stopping || !tasks.empty(); });
+                if(tasks.empty()) return;
+                task = std::move(tasks.front());
+                tasks.pop();
+            }
+            task();
+        }
+    }
+
+    std::vector<std::thread> pool;
+    std::queue<std::function<void()>> tasks;
+    std::mutex the_mutex;
+    std::condition_variable the_condition_variable;
+    bool stopping = false;
+};
+
+#endif